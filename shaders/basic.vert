@@ -2,21 +2,33 @@
 #extension GL_ARB_separate_shader_objects : enable
 
 layout(binding = 0) uniform UniformBufferObject {
-  mat4 model;
   mat4 view;
   mat4 proj;
 }
 ubo;
 
+// one model matrix per object, every indirect draw command names its object in firstInstance
+layout(std430, binding = 2) readonly buffer Objects {
+  mat4 model[];
+}
+objects;
+
+// PACKED_VERTICES: 16 bit UNORM positions within the mesh bounds, the model matrices map them back to model space
 layout(location = 0) in vec3 inPosition;
+#ifndef PACKED_VERTICES
 layout(location = 1) in vec3 inColor;
+#endif
 layout(location = 2) in vec2 inTexCoord;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 
 void main() {
-  gl_Position  = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
-  fragColor    = inColor;
+  gl_Position = ubo.proj * ubo.view * objects.model[gl_InstanceIndex] * vec4(inPosition, 1.0);
+#ifdef PACKED_VERTICES
+  fragColor = vec3(1.0);
+#else
+  fragColor = inColor;
+#endif
   fragTexCoord = inTexCoord;
 }
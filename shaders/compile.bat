@@ -1,3 +1,4 @@
 glslc.exe basic.vert -o basic.vert.spv
+glslc.exe -DPACKED_VERTICES basic.vert -o basic_packed.vert.spv
 glslc.exe basic.frag -o basic.frag.spv
 pause
\ No newline at end of file
@@ -0,0 +1,1223 @@
+#include "./benchmark.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+#include "./blockcompression.h"
+#include "./commandrecorder.h"
+#include "./framestats.h"
+#include "./gpuallocator.h"
+#include "./hellotriangleapp.h"
+#include "./jpegdecoder.h"
+#include "./mappedfile.h"
+#include "./meshlet.h"
+#include "./meshoptimizer.h"
+#include "./meshsimplifier.h"
+#include "./mipmap.h"
+#include "./objparser.h"
+#include "./parallel.h"
+#include "./profiler.h"
+#include "./stb_image.h"
+#include "./taskgraph.h"
+#include "./tiny_obj_loader.h"
+#include "./vertexdedup.h"
+#include "./vertexpacking.h"
+
+namespace {
+
+template <typename Fn>
+float measureMilliseconds(Fn&& fn) {
+  auto startTime = std::chrono::high_resolution_clock::now();
+  fn();
+  auto currentTime = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<float, std::chrono::milliseconds::period>(currentTime - startTime).count();
+}
+
+size_t countIndices(const std::vector<tinyobj::shape_t>& shapes) {
+  size_t count = 0;
+  for (const auto& shape : shapes) {
+    count += shape.mesh.indices.size();
+  }
+  return count;
+}
+
+// same shape boundaries and the same position/normal/texcoord index of every corner
+bool sameFaces(const std::vector<tinyobj::shape_t>& shapes, const std::vector<tinyobj::shape_t>& reference) {
+  if (shapes.size() != reference.size()) {
+    return false;
+  }
+  for (size_t s = 0; s < shapes.size(); s++) {
+    const auto& indices          = shapes[s].mesh.indices;
+    const auto& referenceIndices = reference[s].mesh.indices;
+    if (indices.size() != referenceIndices.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < indices.size(); i++) {
+      if (indices[i].vertex_index != referenceIndices[i].vertex_index ||
+          indices[i].normal_index != referenceIndices[i].normal_index ||
+          indices[i].texcoord_index != referenceIndices[i].texcoord_index) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// the model every mesh benchmark starts from, parsed the way loadModel parses it
+void loadBenchmarkObj(tinyobj::attrib_t& attrib, std::vector<tinyobj::shape_t>& shapes) {
+  std::string warn, err;
+  if (!loadObjParallel(&attrib, &shapes, &warn, &err, HelloTriangleApp::MODEL_PATH)) {
+    throw std::runtime_error(warn + err);
+  }
+}
+
+// deduplicated like loadModel, optionally also reordered by optimizeMesh
+void loadBenchmarkMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool optimize) {
+  tinyobj::attrib_t             attrib;
+  std::vector<tinyobj::shape_t> shapes;
+  loadBenchmarkObj(attrib, shapes);
+
+  deduplicateVertices(attrib, shapes, vertices, indices);
+  if (optimize) {
+    optimizeMesh(vertices, indices);
+  }
+}
+
+int benchmarkObjLoading() {
+  const std::string& path = HelloTriangleApp::MODEL_PATH;
+
+  tinyobj::attrib_t                referenceAttrib;
+  std::vector<tinyobj::shape_t>    referenceShapes;
+  std::vector<tinyobj::material_t> materials;
+  std::string                      warn, err;
+
+  float referenceTime = measureMilliseconds([&] {
+    if (!tinyobj::LoadObj(&referenceAttrib, &referenceShapes, &materials, &warn, &err, path.c_str())) {
+      throw std::runtime_error(warn + err);
+    }
+  });
+
+  std::cout << "tinyobj::LoadObj: " << referenceTime << " ms (" << referenceAttrib.vertices.size() / 3 << " vertices, "
+            << countIndices(referenceShapes) << " indices)" << std::endl;
+
+  bool identical = true;
+  for (unsigned int threads = 1;; threads *= 2) {
+    threads = std::min(threads, workerThreadCount());
+
+    tinyobj::attrib_t             attrib;
+    std::vector<tinyobj::shape_t> shapes;
+
+    float time = measureMilliseconds([&] {
+      if (!loadObjParallel(&attrib, &shapes, &warn, &err, path, threads)) {
+        throw std::runtime_error(warn + err);
+      }
+    });
+
+    std::cout << "loadObjParallel " << std::setw(2) << threads << " threads: " << time << " ms (x"
+              << referenceTime / time << ")" << std::endl;
+
+    identical &= attrib.vertices == referenceAttrib.vertices && attrib.texcoords == referenceAttrib.texcoords &&
+                 attrib.normals == referenceAttrib.normals && sameFaces(shapes, referenceShapes);
+
+    if (threads == workerThreadCount()) break;
+  }
+
+  if (!identical) {
+    std::cerr << "loadObjParallel output differs from tinyobj::LoadObj!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int benchmarkVertexDedup() {
+  tinyobj::attrib_t             attrib;
+  std::vector<tinyobj::shape_t> shapes;
+  loadBenchmarkObj(attrib, shapes);
+
+  size_t indexCount = countIndices(shapes);
+  auto   report     = [&](const char* name, float time, size_t vertexCount) {
+    std::cout << std::left << std::setw(28) << name << std::right << time << " ms, "
+              << time * 1e6f / static_cast<float>(indexCount) << " ns/index (" << vertexCount << " vertices)";
+  };
+
+  // the std::unordered_map loop loadModel used before
+  std::vector<Vertex>   referenceVertices;
+  std::vector<uint32_t> referenceIndices;
+
+  float referenceTime = measureMilliseconds([&] {
+    std::unordered_map<Vertex, uint32_t> uniqueVertices = {};
+
+    for (const auto& shape : shapes) {
+      for (const auto& index : shape.mesh.indices) {
+        Vertex vertex = {};
+
+        vertex.pos = {
+            attrib.vertices[3 * index.vertex_index + 0],
+            attrib.vertices[3 * index.vertex_index + 1],
+            attrib.vertices[3 * index.vertex_index + 2]};
+
+        vertex.texCoord = {
+            attrib.texcoords[2 * index.texcoord_index + 0],
+            1.0f - attrib.texcoords[2 * index.texcoord_index + 1]};
+
+        vertex.color = {1.0f, 1.0f, 1.0f};
+
+        if (uniqueVertices.count(vertex) == 0) {
+          uniqueVertices[vertex] = static_cast<uint32_t>(referenceVertices.size());
+          referenceVertices.push_back(vertex);
+        }
+
+        referenceIndices.push_back(uniqueVertices[vertex]);
+      }
+    }
+  });
+
+  report("std::unordered_map:", referenceTime, referenceVertices.size());
+  std::cout << std::endl;
+
+  bool identical = true;
+  for (DedupMode mode : {DedupMode::HashTable, DedupMode::ParallelSort}) {
+    std::vector<Vertex>   vertices;
+    std::vector<uint32_t> indices;
+    DedupStats            stats;
+
+    float time = measureMilliseconds([&] { deduplicateVertices(attrib, shapes, vertices, indices, mode, &stats); });
+
+    report(mode == DedupMode::HashTable ? "deduplicateVertices hash:" : "deduplicateVertices sort:", time,
+           vertices.size());
+    if (stats.tableCapacity > 0) {
+      std::cout << ", load factor " << stats.loadFactor << " of " << stats.tableCapacity << " slots";
+    }
+    std::cout << " (x" << referenceTime / time << ")" << std::endl;
+
+    identical &= vertices == referenceVertices && indices == referenceIndices;
+  }
+
+  if (!identical) {
+    std::cerr << "deduplicateVertices output differs from std::unordered_map!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int benchmarkMeshOptimizer() {
+  std::vector<Vertex>   vertices;
+  std::vector<uint32_t> indices;
+  loadBenchmarkMesh(vertices, indices, false);
+
+  auto report = [&](const char* name, float time) {
+    VertexCacheStats stats = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+    std::cout << std::left << std::setw(20) << name << std::right << "ACMR " << std::setw(8) << stats.acmr
+              << " ATVR " << std::setw(8) << stats.atvr;
+    if (time > 0.0f) {
+      std::cout << " (" << time << " ms)";
+    }
+    std::cout << std::endl;
+    return stats;
+  };
+
+  std::cout << vertices.size() << " vertices, " << indices.size() / 3 << " triangles, FIFO cache of "
+            << VERTEX_CACHE_SIZE << " vertices" << std::endl;
+
+  VertexCacheStats original = report("original:", 0.0f);
+
+  std::vector<uint32_t> clusters;
+  report("vertex cache:", measureMilliseconds([&] { optimizeVertexCache(indices, vertices.size(), &clusters); }));
+  report("overdraw:", measureMilliseconds([&] { optimizeOverdraw(indices, vertices, clusters); }));
+  VertexCacheStats optimized = report("vertex fetch:", measureMilliseconds([&] { optimizeVertexFetch(vertices, indices); }));
+
+  std::cout << clusters.size() << " dead-end clusters before overdraw splitting" << std::endl;
+
+  if (optimized.acmr > original.acmr) {
+    std::cerr << "mesh optimization increased the ACMR!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int benchmarkVertexPacking() {
+  std::vector<Vertex>   vertices;
+  std::vector<uint32_t> indices;
+  loadBenchmarkMesh(vertices, indices, false);
+
+  VertexQuantization        quantization;
+  std::vector<PackedVertex> packed(vertices.size());
+
+  float time = measureMilliseconds([&] {
+    quantization = computeQuantization(vertices.data(), vertices.size());
+    packVertices(vertices.data(), vertices.size(), quantization, packed.data());
+  });
+
+  QuantizationError error = measureQuantizationError(vertices.data(), packed.data(), vertices.size(), quantization);
+
+  float originalSize = static_cast<float>(sizeof(Vertex) * vertices.size()) / (1 << 20);
+  float packedSize   = static_cast<float>(sizeof(PackedVertex) * packed.size()) / (1 << 20);
+
+  std::cout << vertices.size() << " vertices packed in " << time << " ms: " << originalSize << " MB -> " << packedSize
+            << " MB (" << 100.0f * packedSize / originalSize << "%)" << std::endl;
+  std::cout << "bounds " << quantization.scale.x << " x " << quantization.scale.y << " x " << quantization.scale.z
+            << std::endl;
+  std::cout << "position error: max " << error.maxPosition << ", average " << error.averagePosition << " ("
+            << error.maxRelative * 100.0f << "% of the bounding box diagonal)" << std::endl;
+  std::cout << "texcoord error: max " << error.maxTexCoord << std::endl;
+
+  // half a quantization step along every axis is the expected worst case
+  float expectedMaxError = 0.5f * glm::length(quantization.scale) / 65535.0f;
+  if (error.maxPosition > expectedMaxError * 1.01f) {
+    std::cerr << "position error exceeds half a quantization step!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// brute force reference for isMeshletVisible: a culled meshlet must be back facing or outside one plane entirely
+bool meshletMayBeCulled(const Meshlet& meshlet, const std::vector<Vertex>& vertices,
+                        const std::vector<uint32_t>& indices, const CullingView& view) {
+  const float epsilon = 1e-4f;
+
+  for (const auto& plane : view.planes) {
+    bool outside = true;
+    for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount && outside; i++) {
+      outside = glm::dot(glm::vec3(plane), vertices[indices[i]].pos) + plane.w < epsilon;
+    }
+    if (outside) return true;
+  }
+
+  for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i += 3) {
+    const glm::vec3& p0     = vertices[indices[i + 0]].pos;
+    glm::vec3        normal = glm::cross(vertices[indices[i + 1]].pos - p0, vertices[indices[i + 2]].pos - p0);
+    if (glm::dot(normal, view.eye - p0) > epsilon * glm::length(normal)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int benchmarkMeshlets() {
+  std::vector<Vertex>   vertices;
+  std::vector<uint32_t> indices;
+  loadBenchmarkMesh(vertices, indices, true);
+
+  std::vector<Meshlet> meshlets;
+  float                buildTime = measureMilliseconds([&] {
+    meshlets = buildMeshlets(vertices.data(), vertices.size(), indices.data(), indices.size());
+  });
+
+  std::cout << meshlets.size() << " meshlets built in " << buildTime << " ms, "
+            << static_cast<float>(indices.size() / 3) / meshlets.size() << " triangles per meshlet" << std::endl;
+
+  // bounds: every vertex inside the sphere, every triangle normal inside the cone, limits respected
+  size_t boundsErrors  = 0;
+  size_t coveredIndices = 0;
+  for (const auto& meshlet : meshlets) {
+    std::vector<uint32_t> unique(indices.begin() + meshlet.firstIndex,
+                                 indices.begin() + meshlet.firstIndex + meshlet.indexCount);
+    std::sort(unique.begin(), unique.end());
+    unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+
+    bool valid = meshlet.firstIndex == coveredIndices && unique.size() <= MESHLET_MAX_VERTICES &&
+                 meshlet.indexCount / 3 <= MESHLET_MAX_TRIANGLES;
+    coveredIndices += meshlet.indexCount;
+
+    for (uint32_t index : unique) {
+      valid &= glm::length(vertices[index].pos - meshlet.center) <= meshlet.radius * 1.0001f + 1e-6f;
+    }
+    for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount && meshlet.coneCutoff < 1.0f; i += 3) {
+      const glm::vec3& p0     = vertices[indices[i + 0]].pos;
+      glm::vec3        normal = glm::cross(vertices[indices[i + 1]].pos - p0, vertices[indices[i + 2]].pos - p0);
+      float            length = glm::length(normal);
+      if (length > 0.0f) {
+        float cosine = glm::dot(normal / length, meshlet.coneAxis);
+        valid &= cosine > 0.0f && std::sqrt(std::max(0.0f, 1.0f - cosine * cosine)) <= meshlet.coneCutoff + 1e-4f;
+      }
+    }
+
+    if (!valid) boundsErrors++;
+  }
+  if (coveredIndices != indices.size()) boundsErrors++;
+
+  std::cout << "bounds check: " << boundsErrors << " invalid meshlets" << std::endl;
+
+  // culling: orbit the camera like the app does and verify every culled meshlet against the triangles
+  std::mt19937                          random(42);
+  std::uniform_real_distribution<float> angle(0.0f, 2.0f * 3.14159265f);
+  std::uniform_real_distribution<float> distance(5.0f, 150.0f);
+  std::uniform_real_distribution<float> height(-20.0f, 60.0f);
+
+  std::vector<VkDrawIndexedIndirectCommand> commands(meshlets.size());
+  glm::mat4                                 proj = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+  proj[1][1] *= -1;
+
+  const int views       = 64;
+  size_t    cullErrors  = 0;
+  size_t    culled      = 0;
+  size_t    drawCount   = 0;
+  float     cullTime    = 0.0f;
+  for (int v = 0; v < views; v++) {
+    float     a     = angle(random);
+    float     r     = distance(random);
+    glm::mat4 view  = glm::lookAt(glm::vec3(r * std::cos(a), r * std::sin(a), height(random)), glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    glm::mat4 model = glm::rotate(glm::mat4(1.0f), angle(random), glm::vec3(0.0f, 0.0f, 1.0f));
+
+    CullingView cullingView = makeCullingView(model, view, proj);
+    cullTime += measureMilliseconds([&] { drawCount += cullMeshlets(meshlets.data(), meshlets.size(), cullingView, commands.data()); });
+
+    for (const auto& meshlet : meshlets) {
+      if (isMeshletVisible(meshlet, cullingView)) continue;
+      culled++;
+      if (!meshletMayBeCulled(meshlet, vertices, indices, cullingView)) cullErrors++;
+    }
+  }
+
+  std::cout << "culling: " << 100.0f * culled / (meshlets.size() * views) << "% of the meshlets culled, "
+            << static_cast<float>(drawCount) / views << " draws and " << cullTime / views << " ms per view, "
+            << cullErrors << " visible meshlets culled" << std::endl;
+
+  if (boundsErrors > 0 || cullErrors > 0) {
+    std::cerr << "meshlet bounds or culling are wrong!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int benchmarkLods() {
+  std::vector<Vertex>   vertices;
+  std::vector<uint32_t> indices;
+  loadBenchmarkMesh(vertices, indices, true);
+
+  std::vector<MeshLod> lods;
+  float                time = measureMilliseconds([&] { buildLodChain(vertices.data(), vertices.size(), indices, lods); });
+
+  std::cout << lods.size() << " LODs built in " << time << " ms" << std::endl;
+
+  // levels are contiguous, shrink, get coarser and only reference existing vertices
+  size_t errors = 0;
+  for (size_t l = 0; l < lods.size(); l++) {
+    const MeshLod& lod = lods[l];
+    std::cout << "LOD " << l << ": " << std::setw(8) << lod.indexCount / 3 << " triangles ("
+              << 100.0f * lod.indexCount / lods[0].indexCount << "%), error " << lod.error << std::endl;
+
+    bool valid = lod.indexCount % 3 == 0 && lod.firstIndex + lod.indexCount <= indices.size();
+    if (l > 0) {
+      valid &= lod.firstIndex == lods[l - 1].firstIndex + lods[l - 1].indexCount &&
+               lod.indexCount < lods[l - 1].indexCount && lod.error >= lods[l - 1].error;
+    }
+    for (uint32_t i = lod.firstIndex; i < lod.firstIndex + lod.indexCount && valid; i++) {
+      valid = indices[i] < vertices.size();
+    }
+
+    if (!valid) errors++;
+  }
+
+  // selection: the level must never get finer while the camera moves away
+  glm::mat4 proj     = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+  size_t    previous = 0;
+  for (float distance = 1.0f; distance < 1000.0f; distance *= 1.25f) {
+    size_t lod = selectLod(lods.data(), lods.size(), distance, 0.5f * 1080.0f * proj[1][1], 1.0f);
+    if (lod < previous) errors++;
+    previous = lod;
+  }
+
+  if (lods.size() < 2 || errors > 0) {
+    std::cerr << "LOD chain is invalid!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// the GPU blit path needs a device, the app prints its time next to the CPU one at startup
+int benchmarkMipmaps() {
+  const uint32_t size = 8192;
+
+  std::vector<MipLevel> levels = computeMipLayout(size, size, static_cast<uint32_t>(std::log2(size)) + 1);
+  std::vector<uint8_t>  source(mipChainSize(levels));
+
+  // smooth gradients with noise on top so neither the LUTs nor the clamps are trivially hit
+  std::mt19937 rng(42);
+  for (uint32_t y = 0; y < size; y++) {
+    for (uint32_t x = 0; x < size; x++) {
+      uint8_t* pixel = source.data() + (static_cast<size_t>(y) * size + x) * 4;
+      pixel[0]       = static_cast<uint8_t>((x >> 5) + (rng() & 15));
+      pixel[1]       = static_cast<uint8_t>((y >> 5) + (rng() & 15));
+      pixel[2]       = static_cast<uint8_t>(((x ^ y) & 64) ? 230 : 20);
+      pixel[3]       = static_cast<uint8_t>(255 - (rng() & 31));
+    }
+  }
+
+  size_t errors = 0;
+  for (MipFilter filter : {MipFilter::Box, MipFilter::Kaiser}) {
+    const char* filterName = filter == MipFilter::Box ? "box" : "kaiser";
+
+    std::vector<uint8_t> scalarChain = source;
+    float                scalarTime  = measureMilliseconds(
+        [&] { generateMipChain(scalarChain.data(), levels, filter, false); });
+    std::cout << std::setw(6) << filterName << " scalar:      " << scalarTime << " ms" << std::endl;
+
+    std::vector<uint8_t> simdChain;
+    for (unsigned int threads = 1; threads <= workerThreadCount(); threads *= 2) {
+      simdChain  = source;
+      float time = measureMilliseconds([&] { generateMipChain(simdChain.data(), levels, filter, true, threads); });
+      std::cout << std::setw(6) << filterName << " simd " << std::setw(2) << threads << " threads: " << time << " ms"
+                << std::endl;
+    }
+
+    // both paths round the same way, they only differ in the order floats are summed
+    for (size_t i = 0; i < simdChain.size(); i++) {
+      if (std::abs(simdChain[i] - scalarChain[i]) > 1) errors++;
+    }
+  }
+
+  if (errors > 0) {
+    std::cerr << errors << " bytes differ between the scalar and simd mip chains!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int benchmarkJpegDecode() {
+  const std::string& path = HelloTriangleApp::TEXTURE_PATH;
+
+  MappedFile file;
+  if (!file.open(path)) {
+    throw std::runtime_error("failed to open " + path);
+  }
+  const uint8_t* data      = reinterpret_cast<const uint8_t*>(file.data());
+  float          megabytes = file.size() / (1024.0f * 1024.0f);
+
+  int      width, height, channels;
+  stbi_uc* reference     = nullptr;
+  float    referenceTime = measureMilliseconds([&] {
+    reference = stbi_load_from_memory(data, static_cast<int>(file.size()), &width, &height, &channels, STBI_rgb_alpha);
+  });
+  if (!reference) {
+    throw std::runtime_error("failed to decode " + path);
+  }
+  std::cout << "stbi_load: " << referenceTime << " ms (" << megabytes * 1000.0f / referenceTime << " MB/s, " << width
+            << "x" << height << ")" << std::endl;
+
+  uint32_t jpegWidth, jpegHeight;
+  if (!readJpegInfo(data, file.size(), jpegWidth, jpegHeight)) {
+    std::cout << "not a baseline JPEG, the texture is decoded by stb_image" << std::endl;
+    stbi_image_free(reference);
+    return EXIT_SUCCESS;
+  }
+
+  // both decoders use libjpeg's integer IDCT and fancy upsampling, they only differ in rounding
+  std::vector<uint8_t> pixels(static_cast<size_t>(jpegWidth) * jpegHeight * 4);
+  uint64_t             difference = 0;
+  bool                 decoded    = true;
+  for (unsigned int threads = 1;; threads *= 2) {
+    threads = std::min(threads, workerThreadCount());
+
+    float time = measureMilliseconds([&] { decoded &= decodeJpeg(data, file.size(), pixels.data(), threads); });
+    std::cout << "decodeJpeg " << std::setw(2) << threads << " threads: " << time << " ms ("
+              << megabytes * 1000.0f / time << " MB/s, x" << referenceTime / time << ")" << std::endl;
+
+    if (threads == workerThreadCount()) break;
+  }
+
+  for (size_t i = 0; i < pixels.size(); i++) {
+    difference += std::abs(pixels[i] - reference[i]);
+  }
+  stbi_image_free(reference);
+
+  float meanDifference = static_cast<float>(difference) / pixels.size();
+  std::cout << "mean difference to stbi_load: " << meanDifference << std::endl;
+  if (!decoded || meanDifference > 1.0f) {
+    std::cerr << "decodeJpeg output differs from stbi_load!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// PSNR over the color channels of a crop of the texture, encoders with broken bit packing land far below the floor
+int benchmarkBlockCompression() {
+  const std::string& path    = HelloTriangleApp::TEXTURE_PATH;
+  const uint32_t     maxSize = 2048;
+  const double       minPsnr = 25.0;
+
+  int      textureWidth, textureHeight, channels;
+  stbi_uc* texture = stbi_load(path.c_str(), &textureWidth, &textureHeight, &channels, STBI_rgb_alpha);
+  if (!texture) {
+    throw std::runtime_error("failed to decode " + path);
+  }
+
+  uint32_t             width  = std::min(static_cast<uint32_t>(textureWidth), maxSize);
+  uint32_t             height = std::min(static_cast<uint32_t>(textureHeight), maxSize);
+  std::vector<uint8_t> source(static_cast<size_t>(width) * height * 4);
+  for (uint32_t y = 0; y < height; y++) {
+    memcpy(source.data() + static_cast<size_t>(y) * width * 4, texture + static_cast<size_t>(y) * textureWidth * 4,
+           width * 4);
+  }
+  stbi_image_free(texture);
+
+  float megapixels = width * height / 1e6f;
+  std::cout << "compressing a " << width << "x" << height << " crop of " << path << std::endl;
+
+  bool failed = false;
+  for (BlockFormat format : {BlockFormat::BC1, BlockFormat::BC7}) {
+    const char* formatName = format == BlockFormat::BC1 ? "BC1" : "BC7";
+
+    std::vector<uint8_t> scalarBlocks(compressedSize(width, height, format));
+    float                scalarTime = measureMilliseconds(
+        [&] { compressBlocks(source.data(), width, height, format, scalarBlocks.data(), false, 1); });
+    std::cout << formatName << " scalar:      " << scalarTime << " ms (" << megapixels * 1000.0f / scalarTime
+              << " MPixels/s)" << std::endl;
+
+    std::vector<uint8_t> simdBlocks(scalarBlocks.size());
+    for (unsigned int threads = 1; threads <= workerThreadCount(); threads *= 2) {
+      float time = measureMilliseconds(
+          [&] { compressBlocks(source.data(), width, height, format, simdBlocks.data(), true, threads); });
+      std::cout << formatName << " simd " << std::setw(2) << threads << " threads: " << time << " ms ("
+                << megapixels * 1000.0f / time << " MPixels/s)" << std::endl;
+    }
+
+    std::vector<uint8_t> decoded(source.size());
+    decompressBlocks(simdBlocks.data(), width, height, format, decoded.data());
+
+    double squaredError = 0.0;
+    for (size_t i = 0; i < source.size(); i++) {
+      if ((i & 3) != 3) {
+        double delta = static_cast<double>(source[i]) - decoded[i];
+        squaredError += delta * delta;
+      }
+    }
+    double meanSquaredError = squaredError / (static_cast<double>(width) * height * 3);
+    double psnr = meanSquaredError > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / meanSquaredError) : INFINITY;
+    std::cout << formatName << " PSNR: " << psnr << " dB, " << source.size() / simdBlocks.size() << ":1" << std::endl;
+
+    // the SSE2 search computes the same integer errors as the scalar one, the blocks have to match exactly
+    if (simdBlocks != scalarBlocks) {
+      std::cerr << formatName << " scalar and simd blocks differ!" << std::endl;
+      failed = true;
+    }
+    if (psnr < minPsnr) {
+      std::cerr << formatName << " PSNR is below " << minPsnr << " dB!" << std::endl;
+      failed = true;
+    }
+  }
+
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// GpuAllocator driven against a made up memory type table: a 256 MB device local heap, a 64 MB host heap and a 32 MB
+// host visible device local heap, the types ordered as the spec demands; heaps refuse allocations past their size
+class MockGpuAllocator : public GpuAllocator {
+ public:
+  VkPhysicalDeviceMemoryProperties properties  = {};
+  uint32_t                         allocations = 0;      // vkAllocateMemory calls that succeeded, never decremented
+  bool                             failMaps    = false;  // vkMapMemory fails while set
+
+  MockGpuAllocator() {
+    const VkMemoryPropertyFlags hostCoherent =
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    properties.memoryHeapCount = 3;
+    properties.memoryHeaps[0]  = {VkDeviceSize(256) << 20, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT};
+    properties.memoryHeaps[1]  = {VkDeviceSize(64) << 20, 0};
+    properties.memoryHeaps[2]  = {VkDeviceSize(32) << 20, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT};
+    properties.memoryTypeCount = 4;
+    properties.memoryTypes[0]  = {VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0};
+    properties.memoryTypes[1]  = {hostCoherent, 1};
+    properties.memoryTypes[2]  = {hostCoherent | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, 1};
+    properties.memoryTypes[3]  = {VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | hostCoherent, 2};
+
+    _heapUsed.assign(properties.memoryHeapCount, 0);
+    init(properties, 1024);
+  }
+
+  VkDeviceSize memorySize(VkDeviceMemory memory) const {
+    return _memories.at(memory).size;
+  }
+
+  uint8_t* hostPointer(VkDeviceMemory memory) {
+    return _memories.at(memory).host.data();
+  }
+
+  // device memory the mock has handed out and not got back
+  size_t liveMemoryCount() const {
+    return _memories.size();
+  }
+
+ protected:
+  VkResult allocateMemory(uint32_t memoryType, VkDeviceSize size, VkDeviceMemory& memory) override {
+    uint32_t heap = properties.memoryTypes[memoryType].heapIndex;
+    if (_heapUsed[heap] + size > properties.memoryHeaps[heap].size) {
+      return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    }
+    _heapUsed[heap] += size;
+    allocations++;
+
+    // handles are never reused, a stale allocation can not alias a new block
+    memory            = reinterpret_cast<VkDeviceMemory>(static_cast<uintptr_t>(++_lastHandle));
+    _memories[memory] = {heap, size, {}};
+    return VK_SUCCESS;
+  }
+
+  void freeMemory(VkDeviceMemory memory) override {
+    _heapUsed[_memories.at(memory).heap] -= _memories.at(memory).size;
+    _memories.erase(memory);
+  }
+
+  void* mapMemory(VkDeviceMemory memory, VkDeviceSize size) override {
+    if (failMaps) {
+      throw std::runtime_error("failed to map device memory!");
+    }
+    _memories.at(memory).host.resize(static_cast<size_t>(size));
+    return _memories.at(memory).host.data();
+  }
+
+ private:
+  struct Memory {
+    uint32_t             heap;
+    VkDeviceSize         size;
+    std::vector<uint8_t> host;
+  };
+
+  std::unordered_map<VkDeviceMemory, Memory> _memories;
+  std::vector<VkDeviceSize>                  _heapUsed;
+  uint64_t                                   _lastHandle = 0;
+};
+
+int benchmarkAllocator() {
+  const size_t                operations   = 200000;
+  const size_t                minLive      = 256;
+  const size_t                maxLive      = 2048;
+  const VkMemoryPropertyFlags hostCoherent = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+  struct Live {
+    GpuAllocation         allocation;
+    VkMemoryPropertyFlags properties;
+    bool                  image;
+  };
+
+  MockGpuAllocator  allocator;
+  std::vector<Live> live;
+  std::mt19937      random(42);
+  std::string       error;
+
+  // every live range of a memory object by offset, plus whether the memory holds buffers or optimal images
+  std::map<VkDeviceMemory, std::map<VkDeviceSize, VkDeviceSize>> ranges;
+  std::map<VkDeviceMemory, bool>                                 imageMemory;
+
+  auto check = [&](const Live& entry, VkDeviceSize alignment) {
+    const GpuAllocation& allocation = entry.allocation;
+    VkMemoryPropertyFlags flags     = allocator.properties.memoryTypes[allocation.memoryType].propertyFlags;
+    if ((flags & entry.properties) != entry.properties) {
+      error = "memory type lacks the requested properties";
+    } else if (allocation.offset % alignment != 0) {
+      error = "offset is not aligned";
+    } else if (allocation.offset + allocation.size > allocator.memorySize(allocation.memory)) {
+      error = "range ends past its memory";
+    } else if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+               allocation.mapped != allocator.hostPointer(allocation.memory) + allocation.offset) {
+      error = "mapped pointer does not match the offset";
+    } else if (imageMemory.count(allocation.memory) && imageMemory[allocation.memory] != entry.image) {
+      error = "buffers and optimal images share a block";
+    }
+    imageMemory[allocation.memory] = entry.image;
+
+    auto& memoryRanges = ranges[allocation.memory];
+    auto  next         = memoryRanges.lower_bound(allocation.offset);
+    if (next != memoryRanges.end() && next->first < allocation.offset + allocation.size) {
+      error = "ranges overlap";
+    }
+    if (next != memoryRanges.begin() && std::prev(next)->second > allocation.offset) {
+      error = "ranges overlap";
+    }
+    memoryRanges[allocation.offset] = allocation.offset + allocation.size;
+  };
+
+  auto release = [&](Live& entry) {
+    ranges[entry.allocation.memory].erase(entry.allocation.offset);
+    allocator.free(entry.allocation);
+  };
+
+  // a mix of vertex sized buffers, textures, staging buffers and the odd render target big enough to be dedicated
+  auto allocateRandom = [&]() {
+    Live                 entry = {};
+    VkMemoryRequirements requirements;
+    uint32_t             kind = random() % 1000;
+    if (kind < 400) {
+      requirements     = {256u + random() % (128 << 10), 256, 0xf};
+      entry.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    } else if (kind < 700) {
+      requirements     = {(4096u + random() % (256 << 10)) & ~VkDeviceSize(4095), 4096u << (random() % 5), 0x9};
+      entry.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+      entry.image      = true;
+    } else if (kind < 998) {
+      requirements     = {16u + random() % (128 << 10), 64, 0xf};
+      entry.properties = hostCoherent;
+    } else {
+      requirements     = {VkDeviceSize(18) << 20, 65536, 0x9};
+      entry.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+      entry.image      = true;
+    }
+
+    entry.allocation = allocator.allocate(requirements, entry.properties, entry.image);
+    check(entry, requirements.alignment);
+    live.push_back(entry);
+  };
+
+  size_t allocationCount = 0;
+  size_t freeCount       = 0;
+  float  time            = measureMilliseconds([&] {
+    try {
+      for (size_t i = 0; i < operations && error.empty(); i++) {
+        if (live.size() < minLive || (live.size() < maxLive && random() % 2)) {
+          allocateRandom();
+          allocationCount++;
+        } else {
+          size_t index = random() % live.size();
+          release(live[index]);
+          live[index] = live.back();
+          live.pop_back();
+          freeCount++;
+        }
+      }
+    } catch (const std::runtime_error& exception) {
+      error = exception.what();
+    }
+  });
+
+  std::cout << allocationCount << " allocations and " << freeCount << " frees: " << time << " ms ("
+            << (allocationCount + freeCount) / 1000.0f / time << " M operations/s)" << std::endl;
+  std::cout << "vkAllocateMemory calls: " << allocator.allocations << ", " << allocator.deviceAllocationCount()
+            << " live" << std::endl;
+  std::vector<GpuHeapStats> heaps = allocator.heapStats();
+  for (size_t h = 0; h < heaps.size(); h++) {
+    std::cout << "heap " << h << ": " << heaps[h].allocationCount << " allocations, " << heaps[h].usedBytes / 1024
+              << " KB used in " << heaps[h].blockCount << " blocks, " << heaps[h].dedicatedCount << " dedicated, "
+              << heaps[h].freeRangeCount << " free ranges, fragmentation " << heaps[h].fragmentation << std::endl;
+  }
+
+  if (error.empty() && allocator.allocations * 10 > allocationCount) {
+    error = "more than one vkAllocateMemory call per ten allocations";
+  }
+
+  for (Live& entry : live) {
+    release(entry);
+  }
+  live.clear();
+
+  // fill the device local heap with buffers, allocations have to move on to the host visible device local type
+  bool fellBack = false;
+  if (error.empty()) {
+    try {
+      for (;;) {
+        Live entry       = {};
+        entry.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        entry.allocation = allocator.allocate({VkDeviceSize(1) << 20, 256, 0xf}, entry.properties, false);
+        check(entry, 256);
+        live.push_back(entry);
+        fellBack = fellBack || entry.allocation.memoryType != 0;
+      }
+    } catch (const std::runtime_error&) {
+      // both device local heaps are full
+    }
+    std::cout << "device local heaps full after " << live.size() << " MB" << std::endl;
+    if (error.empty() && !fellBack) {
+      error = "allocations did not fall back to the second device local memory type";
+    }
+    for (Live& entry : live) {
+      release(entry);
+    }
+    live.clear();
+  }
+
+  // a failed vkMapMemory must not leak the memory it was called for, dedicated or a new block
+  if (error.empty()) {
+    size_t liveMemories = allocator.liveMemoryCount();
+    allocator.failMaps  = true;
+    for (VkDeviceSize size : {VkDeviceSize(16) << 20, VkDeviceSize(3) << 20}) {
+      try {
+        GpuAllocation allocation = allocator.allocate({size, 256, 0xf}, hostCoherent, false);
+        allocator.free(allocation);  // served by a block that was mapped before
+      } catch (const std::runtime_error&) {
+      }
+    }
+    allocator.failMaps = false;
+    if (allocator.liveMemoryCount() != liveMemories) {
+      error = "a failed vkMapMemory leaked device memory";
+    }
+  }
+
+  for (const GpuHeapStats& heap : allocator.heapStats()) {
+    if (error.empty() && (heap.usedBytes != 0 || heap.allocationCount != 0 || heap.fragmentation != 0.0f)) {
+      error = "heaps are not empty after freeing everything";
+    }
+  }
+  allocator.destroy();
+  if (error.empty() && allocator.deviceAllocationCount() != 0) {
+    error = "destroy left device memory behind";
+  }
+
+  if (!error.empty()) {
+    std::cerr << "GpuAllocator: " << error << "!" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+// startup shaped graph of sleeping tasks: device bring-up, parsing and decoding overlap, the upload waits for all
+int benchmarkTaskGraph() {
+  auto sleep = [](int milliseconds) {
+    return [milliseconds] { std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds)); };
+  };
+
+  TaskGraph         graph;
+  TaskGraph::TaskId instance  = graph.add("instance", {}, sleep(20));
+  TaskGraph::TaskId device    = graph.add("device", {instance}, sleep(30));
+  TaskGraph::TaskId swapChain = graph.add("swap chain", {device}, sleep(10));
+  TaskGraph::TaskId parse     = graph.add("parse", {}, sleep(60));
+  TaskGraph::TaskId decode    = graph.add("decode", {}, sleep(80));
+  TaskGraph::TaskId upload    = graph.add("upload", {device, parse, decode}, sleep(5));
+  TaskGraph::TaskId ready     = graph.add("ready", {swapChain, upload}, sleep(1));
+
+  // the tasks only sleep, enough threads to run the independent ones side by side whatever the core count
+  float time = measureMilliseconds([&] {
+    graph.start(4);
+    graph.wait(ready);
+    graph.finish();
+  });
+
+  float sum = 0.0f;
+  for (TaskGraph::TaskId task = 0; task < graph.taskCount(); task++) {
+    sum += graph.timing(task).duration;
+  }
+  std::cout << graph.taskCount() << " tasks on " << graph.threadCount() << " threads: " << time << " ms, "
+            << sum << " ms in sequence" << std::endl;
+
+  std::string error;
+  std::string path;
+  for (TaskGraph::TaskId task : graph.criticalPath(ready)) {
+    TaskGraph::TaskTiming timing = graph.timing(task);
+    path += (path.empty() ? "" : " -> ") + timing.name;
+    std::cout << "\t" << std::setw(10) << timing.name << ": " << timing.start << " ms + " << timing.duration << " ms"
+              << std::endl;
+  }
+  if (path != "decode -> upload -> ready") {
+    error = "critical path is " + path;
+  } else if (time > 0.6f * sum) {
+    error = "tasks did not overlap";
+  }
+
+  // a failing task skips what depends on it, independent tasks still run and wait rethrows
+  TaskGraph         failing;
+  bool              independentRan = false;
+  bool              dependentRan   = false;
+  TaskGraph::TaskId thrower = failing.add("throw", {}, [] { throw std::runtime_error("task failed"); });
+  TaskGraph::TaskId dependent   = failing.add("dependent", {thrower}, [&] { dependentRan = true; });
+  failing.add("independent", {}, [&] { independentRan = true; });
+
+  failing.start(2);
+  bool rethrown = false;
+  try {
+    failing.wait(dependent);
+  } catch (const std::runtime_error&) {
+    rethrown = true;
+  }
+  try {
+    failing.finish();
+  } catch (const std::runtime_error&) {
+  }
+  if (error.empty() && (!rethrown || dependentRan || !independentRan || failing.timing(dependent).ran)) {
+    error = "failures are not propagated to dependent tasks only";
+  }
+
+  if (!error.empty()) {
+    std::cerr << "TaskGraph: " << error << "!" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int benchmarkProfiler() {
+  const size_t zonesPerThread = 250000;
+  const size_t overflowZones  = 1100000;
+  const char*  tracePath      = "benchmark-trace.json";
+
+  auto record = [](size_t count) {
+    for (size_t i = 0; i < count; i++) {
+      PROFILE_ZONE("zone");
+    }
+  };
+  float time = measureMilliseconds([&] { record(zonesPerThread); });
+
+  // recording threads against a trace written while they run, the last one runs past the per-thread limit
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back(record, zonesPerThread);
+  }
+  writeChromeTrace(tracePath);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  std::thread overflow(record, overflowZones);
+  overflow.join();
+
+  size_t written   = 0;
+  float  writeTime = measureMilliseconds([&] { written = writeChromeTrace(tracePath); });
+  std::remove(tracePath);
+
+  std::cout << "recorded " << zonesPerThread << " zones in " << time << " ms (" << time * 1e6f / zonesPerThread
+            << " ns per zone), wrote " << written << " zones from 6 threads in " << writeTime << " ms" << std::endl;
+
+  size_t expected = 5 * zonesPerThread + 256 * 4096;
+  if (written != expected) {
+    std::cerr << "Profiler: wrote " << written << " zones instead of " << expected << "!" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int benchmarkFrameStats() {
+  // 99 steady frames and one hitch
+  std::vector<float> frameTimes(99, 10.0f);
+  frameTimes.push_back(50.0f);
+  FrameSummary summary = summarizeFrames(frameTimes);
+  if (summary.p50Ms != 10.0f || summary.p99Ms != 10.0f || summary.maxMs != 50.0f || summary.hitchCount != 1) {
+    std::cerr << "FrameStats: wrong summary of a known distribution!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // a render loop far faster than the reporter drains, recording must stay cheap and frames get lost, not waited for
+  const size_t recordCount = 10000000;
+  FrameStats   stats;
+  stats.start();
+  float time = measureMilliseconds([&] {
+    for (size_t i = 0; i < recordCount; i++) {
+      stats.record(static_cast<float>(i % 17));
+    }
+  });
+  stats.stop();
+  std::cout << "recorded " << recordCount << " frame times in " << time << " ms (" << time * 1e6f / recordCount
+            << " ns per frame)" << std::endl;
+
+  const char* csvPath    = "benchmark-frames.csv";
+  const int   frameCount = 1000;
+  FrameStats  csvStats;
+  csvStats.start(csvPath);
+  for (int i = 0; i < frameCount; i++) {
+    csvStats.record(16.0f);
+  }
+  csvStats.stop();
+
+  std::ifstream csv(csvPath);
+  std::string   line;
+  int           lineCount = 0;
+  while (std::getline(csv, line)) {
+    lineCount++;
+  }
+  csv.close();
+  std::remove(csvPath);
+
+  if (lineCount != frameCount + 1) {
+    std::cerr << "FrameStats: CSV has " << lineCount << " lines instead of " << frameCount + 1 << "!" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+// CommandRecorder whose command buffers are plain word streams, one per pool; resetting a pool keeps its capacity
+class MockCommandRecorder : public CommandRecorder {
+ public:
+  ~MockCommandRecorder() override {
+    destroy();
+  }
+
+  static std::vector<uint32_t>& words(VkCommandBuffer commandBuffer) {
+    return *reinterpret_cast<std::vector<uint32_t>*>(commandBuffer);
+  }
+
+ protected:
+  VkCommandPool createCommandPool() override {
+    _streams.push_back(std::make_unique<std::vector<uint32_t>>());
+    return reinterpret_cast<VkCommandPool>(static_cast<uintptr_t>(_streams.size()));
+  }
+
+  void destroyCommandPool(VkCommandPool commandPool) override {
+    stream(commandPool).reset();
+  }
+
+  VkCommandBuffer allocateCommandBuffer(VkCommandPool commandPool) override {
+    return reinterpret_cast<VkCommandBuffer>(stream(commandPool).get());
+  }
+
+  void resetCommandPool(VkCommandPool commandPool) override {
+    stream(commandPool)->clear();
+  }
+
+  void beginCommandBuffer(VkCommandBuffer /*commandBuffer*/,
+                          const VkCommandBufferInheritanceInfo& /*inheritance*/) override {
+  }
+
+  void endCommandBuffer(VkCommandBuffer /*commandBuffer*/) override {
+  }
+
+ private:
+  std::vector<std::unique_ptr<std::vector<uint32_t>>> _streams;
+
+  std::unique_ptr<std::vector<uint32_t>>& stream(VkCommandPool commandPool) {
+    return _streams[reinterpret_cast<uintptr_t>(commandPool) - 1];
+  }
+};
+
+int benchmarkCommandRecorder() {
+  const size_t drawCount   = 50000;
+  const int    frameCount  = 100;
+  const size_t packetWords = 24;  // about what a descriptor set bind, push constants and an indexed draw take
+
+  // a draw packet starts with its draw index, the rest stands in for what a driver encodes
+  auto recordDraws = [&](VkCommandBuffer commandBuffer, size_t firstDraw, size_t count) {
+    std::vector<uint32_t>& words = MockCommandRecorder::words(commandBuffer);
+    for (size_t draw = firstDraw; draw < firstDraw + count; draw++) {
+      uint32_t state = static_cast<uint32_t>(draw) * 2654435761u;
+      words.push_back(static_cast<uint32_t>(draw));
+      for (size_t w = 1; w < packetWords; w++) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        words.push_back(state);
+      }
+    }
+  };
+
+  VkCommandBufferInheritanceInfo inheritance = {};
+  inheritance.sType                          = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+
+  std::string error;
+  float       singleThreadMs = 0.0f;
+  for (unsigned int threadCount : {1u, 2u, 4u, 8u}) {
+    MockCommandRecorder recorder;
+    recorder.init(VK_NULL_HANDLE, 0, 2, threadCount);
+
+    std::vector<VkCommandBuffer> buffers;
+    bool                         inOrder = true;
+    float                        time    = 0.0f;
+    for (int frame = 0; frame < frameCount; frame++) {
+      time += measureMilliseconds([&] { buffers = recorder.record(frame % 2, inheritance, drawCount, recordDraws); });
+
+      // the buffers in the order returned hold every draw once and in order
+      size_t nextDraw = 0;
+      for (VkCommandBuffer buffer : buffers) {
+        const std::vector<uint32_t>& words = MockCommandRecorder::words(buffer);
+        for (size_t w = 0; w < words.size(); w += packetWords) {
+          inOrder = inOrder && words[w] == nextDraw++;
+        }
+      }
+      inOrder = inOrder && nextDraw == drawCount;
+    }
+
+    float frameMs = time / frameCount;
+    if (threadCount == 1) {
+      singleThreadMs = frameMs;
+    }
+    std::cout << drawCount << " draws on " << threadCount << " threads in " << buffers.size() << " partitions: "
+              << frameMs << " ms per frame, " << singleThreadMs / frameMs << "x" << std::endl;
+
+    if (!inOrder && error.empty()) {
+      error = "draws recorded on " + std::to_string(threadCount) + " threads are missing or out of order";
+    }
+  }
+
+  // a short list stays on the calling thread, an empty one records nothing
+  MockCommandRecorder recorder;
+  recorder.init(VK_NULL_HANDLE, 0, 2, 4);
+  size_t shortListBuffers = recorder.record(0, inheritance, CommandRecorder::MIN_DRAWS_PER_PARTITION, recordDraws).size();
+  if (error.empty() && (shortListBuffers != 1 || !recorder.record(1, inheritance, 0, recordDraws).empty() ||
+                         recorder.partitionCount(CommandRecorder::MIN_DRAWS_PER_PARTITION) != 1 ||
+                         recorder.partitionCount(CommandRecorder::MIN_DRAWS_PER_PARTITION + 1) != 2)) {
+    error = "short draw lists are split";
+  }
+
+  // an exception of any partition reaches the caller once all of them have finished, the recorder stays usable
+  bool rethrown = false;
+  try {
+    recorder.record(0, inheritance, drawCount, [&](VkCommandBuffer commandBuffer, size_t firstDraw, size_t count) {
+      if (firstDraw > 0) {
+        throw std::runtime_error("recording failed");
+      }
+      recordDraws(commandBuffer, firstDraw, count);
+    });
+  } catch (const std::runtime_error&) {
+    rethrown = true;
+  }
+  if (error.empty() && (!rethrown || recorder.record(1, inheritance, drawCount, recordDraws).size() != 4)) {
+    error = "a failing partition is not rethrown";
+  }
+
+  if (!error.empty()) {
+    std::cerr << "CommandRecorder: " << error << "!" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+}  // namespace
+
+int runBenchmark(const std::string& name) {
+  if (name == "obj") {
+    return benchmarkObjLoading();
+  }
+  if (name == "dedup") {
+    return benchmarkVertexDedup();
+  }
+  if (name == "meshopt") {
+    return benchmarkMeshOptimizer();
+  }
+  if (name == "quantize") {
+    return benchmarkVertexPacking();
+  }
+  if (name == "meshlets") {
+    return benchmarkMeshlets();
+  }
+  if (name == "lod") {
+    return benchmarkLods();
+  }
+  if (name == "mipmaps") {
+    return benchmarkMipmaps();
+  }
+  if (name == "jpeg") {
+    return benchmarkJpegDecode();
+  }
+  if (name == "bc") {
+    return benchmarkBlockCompression();
+  }
+  if (name == "allocator") {
+    return benchmarkAllocator();
+  }
+  if (name == "taskgraph") {
+    return benchmarkTaskGraph();
+  }
+  if (name == "profiler") {
+    return benchmarkProfiler();
+  }
+  if (name == "framestats") {
+    return benchmarkFrameStats();
+  }
+  if (name == "recorder") {
+    return benchmarkCommandRecorder();
+  }
+
+  throw std::invalid_argument("unknown benchmark: " + name + " (available: obj, dedup, meshopt, quantize, meshlets, lod, mipmaps, jpeg, bc, allocator, taskgraph, profiler, framestats, recorder)");
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <string>
+
+// Standalone CPU benchmarks, started with `vk-hello-triangle --benchmark <name>`.
+// Returns EXIT_SUCCESS or EXIT_FAILURE, unknown names throw.
+int runBenchmark(const std::string& name);
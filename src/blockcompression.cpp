@@ -0,0 +1,518 @@
+#include "./blockcompression.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+#include "./parallel.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const int   BLOCK_PIXELS          = 16;
+const int   BC1_REFINE_ITERATIONS = 2;
+const int   BC7_REFINE_ITERATIONS = 2;
+const int   BC7_MODE6             = 1 << 6;
+const int   BC7_WEIGHTS[16]       = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+const float BC1_WEIGHTS[4]        = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};  // share of color0 per index
+
+// 4x4 pixels as 16 bit RGBA, two pixels per SSE2 register
+struct Block {
+  alignas(16) int16_t pixels[BLOCK_PIXELS][4];
+};
+
+// the colors a block can reproduce, exactly as the decoder interpolates them
+struct Palette {
+  alignas(16) int16_t colors[16][4];
+  int count;
+};
+
+struct Bc1Block {
+  uint16_t color0;
+  uint16_t color1;
+  uint8_t  indices[BLOCK_PIXELS];
+};
+
+struct Bc7Block {
+  uint8_t endpoints[2][4];  // 7 bits per channel
+  uint8_t pbits[2];
+  uint8_t indices[BLOCK_PIXELS];
+};
+
+// packs little endian bit fields the way BC7 lays them out, first field in the lowest bits
+struct BitWriter {
+  uint64_t words[2] = {};
+  int      position = 0;
+
+  void put(uint64_t value, int count) {
+    int word  = position >> 6;
+    int shift = position & 63;
+    words[word] |= value << shift;
+    if (shift + count > 64) {
+      words[word + 1] |= value >> (64 - shift);
+    }
+    position += count;
+  }
+};
+
+struct BitReader {
+  uint64_t words[2];
+  int      position = 0;
+
+  uint32_t get(int count) {
+    int      word  = position >> 6;
+    int      shift = position & 63;
+    uint64_t value = words[word] >> shift;
+    if (shift + count > 64) {
+      value |= words[word + 1] << (64 - shift);
+    }
+    position += count;
+    return static_cast<uint32_t>(value & ((uint64_t(1) << count) - 1));
+  }
+};
+
+void loadBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, bool alpha,
+               Block& block) {
+  for (uint32_t y = 0; y < 4; y++) {
+    const uint8_t* row = rgba + static_cast<size_t>(std::min(blockY * 4 + y, height - 1)) * width * 4;
+    for (uint32_t x = 0; x < 4; x++) {
+      const uint8_t* pixel = row + std::min(blockX * 4 + x, width - 1) * 4;
+      int16_t*       out   = block.pixels[y * 4 + x];
+      out[0]               = pixel[0];
+      out[1]               = pixel[1];
+      out[2]               = pixel[2];
+      out[3]               = alpha ? pixel[3] : 0;
+    }
+  }
+}
+
+// nearest palette entry for every pixel, returns the summed squared error
+uint32_t selectIndices(const Block& block, const Palette& palette, uint8_t* indices, bool simd) {
+  uint32_t total = 0;
+
+#ifdef BLOCK_SSE2
+  if (simd) {
+    alignas(16) int32_t errors[4];
+    alignas(16) int32_t chosen[4];
+    for (int group = 0; group < BLOCK_PIXELS; group += 4) {
+      __m128i pixels01  = _mm_load_si128(reinterpret_cast<const __m128i*>(block.pixels[group]));
+      __m128i pixels23  = _mm_load_si128(reinterpret_cast<const __m128i*>(block.pixels[group + 2]));
+      __m128i best      = _mm_set1_epi32(INT_MAX);
+      __m128i bestIndex = _mm_setzero_si128();
+      for (int i = 0; i < palette.count; i++) {
+        __m128i color = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(palette.colors[i]));
+        color         = _mm_unpacklo_epi64(color, color);
+
+        // pmaddwd leaves r*r + g*g and b*b + a*a per pixel, the shuffles pair them up for four pixels
+        __m128i delta01 = _mm_sub_epi16(pixels01, color);
+        __m128i delta23 = _mm_sub_epi16(pixels23, color);
+        __m128  sums01  = _mm_castsi128_ps(_mm_madd_epi16(delta01, delta01));
+        __m128  sums23  = _mm_castsi128_ps(_mm_madd_epi16(delta23, delta23));
+        __m128i error   = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(sums01, sums23, _MM_SHUFFLE(2, 0, 2, 0))),
+                                        _mm_castps_si128(_mm_shuffle_ps(sums01, sums23, _MM_SHUFFLE(3, 1, 3, 1))));
+
+        __m128i closer = _mm_cmplt_epi32(error, best);
+        best           = _mm_or_si128(_mm_and_si128(closer, error), _mm_andnot_si128(closer, best));
+        bestIndex      = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(i)), _mm_andnot_si128(closer, bestIndex));
+      }
+      _mm_store_si128(reinterpret_cast<__m128i*>(errors), best);
+      _mm_store_si128(reinterpret_cast<__m128i*>(chosen), bestIndex);
+      for (int j = 0; j < 4; j++) {
+        indices[group + j] = static_cast<uint8_t>(chosen[j]);
+        total += static_cast<uint32_t>(errors[j]);
+      }
+    }
+    return total;
+  }
+#endif
+
+  for (int p = 0; p < BLOCK_PIXELS; p++) {
+    const int16_t* pixel = block.pixels[p];
+    int32_t        best  = INT_MAX;
+    for (int i = 0; i < palette.count; i++) {
+      int32_t error = 0;
+      for (int c = 0; c < 4; c++) {
+        int32_t delta = pixel[c] - palette.colors[i][c];
+        error += delta * delta;
+      }
+      if (error < best) {
+        best       = error;
+        indices[p] = static_cast<uint8_t>(i);
+      }
+    }
+    total += static_cast<uint32_t>(best);
+  }
+  return total;
+}
+
+// the extremes of the pixels projected on the principal axis of their covariance, found by power iteration
+void fitEndpoints(const Block& block, int channels, float low[4], float high[4]) {
+  float mean[4] = {};
+  for (int p = 0; p < BLOCK_PIXELS; p++) {
+    for (int c = 0; c < channels; c++) {
+      mean[c] += block.pixels[p][c];
+    }
+  }
+  for (int c = 0; c < channels; c++) {
+    mean[c] /= BLOCK_PIXELS;
+  }
+
+  float covariance[4][4] = {};
+  for (int p = 0; p < BLOCK_PIXELS; p++) {
+    float delta[4] = {};
+    for (int c = 0; c < channels; c++) {
+      delta[c] = block.pixels[p][c] - mean[c];
+    }
+    for (int i = 0; i < channels; i++) {
+      for (int j = 0; j < channels; j++) {
+        covariance[i][j] += delta[i] * delta[j];
+      }
+    }
+  }
+
+  // start from the covariance column of the channel that varies most
+  int widest = 0;
+  for (int c = 1; c < channels; c++) {
+    widest = covariance[c][c] > covariance[widest][widest] ? c : widest;
+  }
+  float axis[4] = {};
+  for (int c = 0; c < channels; c++) {
+    axis[c] = covariance[c][widest];
+  }
+
+  for (int iteration = 0; iteration < 8; iteration++) {
+    float next[4] = {};
+    float largest = 0.0f;
+    for (int i = 0; i < channels; i++) {
+      for (int j = 0; j < channels; j++) {
+        next[i] += covariance[i][j] * axis[j];
+      }
+      largest = std::max(largest, std::abs(next[i]));
+    }
+    if (largest == 0.0f) {
+      break;
+    }
+    for (int c = 0; c < channels; c++) {
+      axis[c] = next[c] / largest;
+    }
+  }
+
+  float length = 0.0f;
+  for (int c = 0; c < channels; c++) {
+    length += axis[c] * axis[c];
+  }
+  length = std::sqrt(length);
+
+  float lowest = 0.0f, highest = 0.0f;
+  if (length > 0.0f) {
+    for (int c = 0; c < channels; c++) {
+      axis[c] /= length;
+    }
+    for (int p = 0; p < BLOCK_PIXELS; p++) {
+      float t = 0.0f;
+      for (int c = 0; c < channels; c++) {
+        t += (block.pixels[p][c] - mean[c]) * axis[c];
+      }
+      lowest  = std::min(lowest, t);
+      highest = std::max(highest, t);
+    }
+  }
+
+  for (int c = 0; c < 4; c++) {
+    low[c]  = c < channels ? std::clamp(mean[c] + axis[c] * lowest, 0.0f, 255.0f) : 0.0f;
+    high[c] = c < channels ? std::clamp(mean[c] + axis[c] * highest, 0.0f, 255.0f) : 0.0f;
+  }
+}
+
+/*
+Least squares endpoints for fixed indices: pixel p is approximated by (1 - w) * low + w * high with w =
+weights[indices[p]]. Returns false when every pixel uses the same weight and the system has no unique solution.
+*/
+bool refineEndpoints(const Block& block, const uint8_t* indices, const float* weights, int channels, float low[4],
+                     float high[4]) {
+  float lowLow = 0.0f, lowHigh = 0.0f, highHigh = 0.0f;
+  float lowSum[4] = {}, highSum[4] = {};
+  for (int p = 0; p < BLOCK_PIXELS; p++) {
+    float w = weights[indices[p]];
+    lowLow += (1.0f - w) * (1.0f - w);
+    lowHigh += (1.0f - w) * w;
+    highHigh += w * w;
+    for (int c = 0; c < channels; c++) {
+      lowSum[c] += (1.0f - w) * block.pixels[p][c];
+      highSum[c] += w * block.pixels[p][c];
+    }
+  }
+
+  float determinant = lowLow * highHigh - lowHigh * lowHigh;
+  if (std::abs(determinant) < 1e-6f) {
+    return false;
+  }
+  for (int c = 0; c < channels; c++) {
+    low[c]  = std::clamp((highHigh * lowSum[c] - lowHigh * highSum[c]) / determinant, 0.0f, 255.0f);
+    high[c] = std::clamp((lowLow * highSum[c] - lowHigh * lowSum[c]) / determinant, 0.0f, 255.0f);
+  }
+  return true;
+}
+
+uint16_t packRgb565(const float color[4]) {
+  uint32_t r = static_cast<uint32_t>(std::lrint(color[0] * (31.0f / 255.0f)));
+  uint32_t g = static_cast<uint32_t>(std::lrint(color[1] * (63.0f / 255.0f)));
+  uint32_t b = static_cast<uint32_t>(std::lrint(color[2] * (31.0f / 255.0f)));
+  return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void unpackRgb565(uint16_t color, int16_t out[4]) {
+  int r  = (color >> 11) & 31;
+  int g  = (color >> 5) & 63;
+  int b  = color & 31;
+  out[0] = static_cast<int16_t>((r << 3) | (r >> 2));
+  out[1] = static_cast<int16_t>((g << 2) | (g >> 4));
+  out[2] = static_cast<int16_t>((b << 3) | (b >> 2));
+  out[3] = 0;
+}
+
+// four colors when color0 > color1, otherwise three and transparent black
+Palette bc1Palette(uint16_t color0, uint16_t color1) {
+  Palette palette = {};
+  unpackRgb565(color0, palette.colors[0]);
+  unpackRgb565(color1, palette.colors[1]);
+  const int16_t* a = palette.colors[0];
+  const int16_t* b = palette.colors[1];
+  for (int c = 0; c < 3; c++) {
+    if (color0 > color1) {
+      palette.colors[2][c] = static_cast<int16_t>((2 * a[c] + b[c]) / 3);
+      palette.colors[3][c] = static_cast<int16_t>((a[c] + 2 * b[c]) / 3);
+    } else {
+      palette.colors[2][c] = static_cast<int16_t>((a[c] + b[c]) / 2);
+    }
+  }
+  palette.count = color0 > color1 ? 4 : 3;
+  return palette;
+}
+
+// quantizes both endpoints, orders them for four color mode and picks the indices
+uint32_t encodeBc1(const Block& block, const float color0[4], const float color1[4], Bc1Block& out, bool simd) {
+  out.color0 = packRgb565(color0);
+  out.color1 = packRgb565(color1);
+  if (out.color0 < out.color1) {
+    std::swap(out.color0, out.color1);
+  }
+  return selectIndices(block, bc1Palette(out.color0, out.color1), out.indices, simd);
+}
+
+void compressBc1Block(const Block& block, uint8_t* destination, bool simd) {
+  float low[4], high[4];
+  fitEndpoints(block, 3, low, high);
+
+  Bc1Block best;
+  uint32_t bestError = encodeBc1(block, high, low, best, simd);
+
+  // refinement treats color0 as the high endpoint, three color blocks only happen when both endpoints are equal
+  for (int iteration = 0; iteration < BC1_REFINE_ITERATIONS && bestError > 0 && best.color0 > best.color1;
+       iteration++) {
+    if (!refineEndpoints(block, best.indices, BC1_WEIGHTS, 3, low, high)) {
+      break;
+    }
+    Bc1Block candidate;
+    uint32_t error = encodeBc1(block, high, low, candidate, simd);
+    if (error >= bestError) {
+      break;
+    }
+    best      = candidate;
+    bestError = error;
+  }
+
+  uint32_t indices = 0;
+  for (int p = 0; p < BLOCK_PIXELS; p++) {
+    indices |= static_cast<uint32_t>(best.indices[p]) << (2 * p);
+  }
+  memcpy(destination, &best.color0, 2);
+  memcpy(destination + 2, &best.color1, 2);
+  memcpy(destination + 4, &indices, 4);
+}
+
+Palette bc7Palette(const uint8_t endpoints[2][4], const uint8_t pbits[2]) {
+  Palette palette = {};
+  palette.count   = 16;
+  for (int c = 0; c < 4; c++) {
+    int low  = (endpoints[0][c] << 1) | pbits[0];
+    int high = (endpoints[1][c] << 1) | pbits[1];
+    for (int i = 0; i < 16; i++) {
+      palette.colors[i][c] = static_cast<int16_t>(((64 - BC7_WEIGHTS[i]) * low + BC7_WEIGHTS[i] * high + 32) >> 6);
+    }
+  }
+  return palette;
+}
+
+// 7 bit endpoint value that expands closest to value given its low bit
+uint8_t quantizeBc7(float value, uint8_t pbit) {
+  return static_cast<uint8_t>(std::clamp(std::lrint((value - pbit) * 0.5f), 0L, 127L));
+}
+
+// quantizes both endpoints with every combination of low bits and keeps the best
+uint32_t encodeBc7(const Block& block, const float low[4], const float high[4], Bc7Block& out, bool simd) {
+  uint32_t bestError = UINT_MAX;
+  for (uint8_t combination = 0; combination < 4; combination++) {
+    Bc7Block candidate;
+    candidate.pbits[0] = combination & 1;
+    candidate.pbits[1] = combination >> 1;
+    for (int c = 0; c < 4; c++) {
+      candidate.endpoints[0][c] = quantizeBc7(low[c], candidate.pbits[0]);
+      candidate.endpoints[1][c] = quantizeBc7(high[c], candidate.pbits[1]);
+    }
+
+    uint32_t error = selectIndices(block, bc7Palette(candidate.endpoints, candidate.pbits), candidate.indices, simd);
+    if (error < bestError) {
+      out       = candidate;
+      bestError = error;
+    }
+  }
+  return bestError;
+}
+
+void compressBc7Block(const Block& block, uint8_t* destination, bool simd) {
+  float low[4], high[4];
+  fitEndpoints(block, 4, low, high);
+
+  Bc7Block best;
+  uint32_t bestError = encodeBc7(block, low, high, best, simd);
+
+  float weights[16];
+  for (int i = 0; i < 16; i++) {
+    weights[i] = BC7_WEIGHTS[i] / 64.0f;
+  }
+  for (int iteration = 0; iteration < BC7_REFINE_ITERATIONS && bestError > 0; iteration++) {
+    if (!refineEndpoints(block, best.indices, weights, 4, low, high)) {
+      break;
+    }
+    Bc7Block candidate;
+    uint32_t error = encodeBc7(block, low, high, candidate, simd);
+    if (error >= bestError) {
+      break;
+    }
+    best      = candidate;
+    bestError = error;
+  }
+
+  // the first index is stored without its top bit, swapping the endpoints mirrors the weights exactly
+  if (best.indices[0] & 8) {
+    for (int c = 0; c < 4; c++) {
+      std::swap(best.endpoints[0][c], best.endpoints[1][c]);
+    }
+    std::swap(best.pbits[0], best.pbits[1]);
+    for (int p = 0; p < BLOCK_PIXELS; p++) {
+      best.indices[p] = static_cast<uint8_t>(15 - best.indices[p]);
+    }
+  }
+
+  BitWriter bits;
+  bits.put(BC7_MODE6, 7);
+  for (int c = 0; c < 4; c++) {
+    bits.put(best.endpoints[0][c], 7);
+    bits.put(best.endpoints[1][c], 7);
+  }
+  bits.put(best.pbits[0], 1);
+  bits.put(best.pbits[1], 1);
+  bits.put(best.indices[0], 3);
+  for (int p = 1; p < BLOCK_PIXELS; p++) {
+    bits.put(best.indices[p], 4);
+  }
+  memcpy(destination, bits.words, 16);
+}
+
+void decompressBc1Block(const uint8_t* source, uint8_t pixels[BLOCK_PIXELS][4]) {
+  uint16_t color0, color1;
+  uint32_t indices;
+  memcpy(&color0, source, 2);
+  memcpy(&color1, source + 2, 2);
+  memcpy(&indices, source + 4, 4);
+
+  Palette palette = bc1Palette(color0, color1);
+  for (int p = 0; p < BLOCK_PIXELS; p++) {
+    uint32_t index = (indices >> (2 * p)) & 3;
+    for (int c = 0; c < 3; c++) {
+      pixels[p][c] = static_cast<uint8_t>(palette.colors[index][c]);
+    }
+    pixels[p][3] = index == 3 && color0 <= color1 ? 0 : 255;
+  }
+}
+
+void decompressBc7Block(const uint8_t* source, uint8_t pixels[BLOCK_PIXELS][4]) {
+  BitReader bits;
+  memcpy(bits.words, source, 16);
+  if (bits.get(7) != BC7_MODE6) {
+    memset(pixels, 0, BLOCK_PIXELS * 4);
+    return;
+  }
+
+  Bc7Block block;
+  for (int c = 0; c < 4; c++) {
+    block.endpoints[0][c] = static_cast<uint8_t>(bits.get(7));
+    block.endpoints[1][c] = static_cast<uint8_t>(bits.get(7));
+  }
+  block.pbits[0] = static_cast<uint8_t>(bits.get(1));
+  block.pbits[1] = static_cast<uint8_t>(bits.get(1));
+
+  Palette palette = bc7Palette(block.endpoints, block.pbits);
+  for (int p = 0; p < BLOCK_PIXELS; p++) {
+    uint32_t index = bits.get(p == 0 ? 3 : 4);
+    for (int c = 0; c < 4; c++) {
+      pixels[p][c] = static_cast<uint8_t>(palette.colors[index][c]);
+    }
+  }
+}
+
+}  // namespace
+
+size_t compressedSize(uint32_t width, uint32_t height, BlockFormat format) {
+  return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+void compressBlocks(const uint8_t* rgba, uint32_t width, uint32_t height, BlockFormat format, uint8_t* blocks,
+                    bool simd, unsigned int threadCount) {
+  uint32_t blocksX = (width + 3) / 4;
+  uint32_t blocksY = (height + 3) / 4;
+  size_t   bytes   = blockBytes(format);
+
+  parallelFor(blocksY, [&](size_t row) {
+    uint32_t blockY      = static_cast<uint32_t>(row);
+    uint8_t* destination = blocks + row * blocksX * bytes;
+    for (uint32_t blockX = 0; blockX < blocksX; blockX++, destination += bytes) {
+      Block block;
+      loadBlock(rgba, width, height, blockX, blockY, format == BlockFormat::BC7, block);
+      if (format == BlockFormat::BC1) {
+        compressBc1Block(block, destination, simd);
+      } else {
+        compressBc7Block(block, destination, simd);
+      }
+    }
+  }, threadCount);
+}
+
+void decompressBlocks(const uint8_t* blocks, uint32_t width, uint32_t height, BlockFormat format, uint8_t* rgba) {
+  uint32_t blocksX = (width + 3) / 4;
+  uint32_t blocksY = (height + 3) / 4;
+  size_t   bytes   = blockBytes(format);
+
+  for (uint32_t blockY = 0; blockY < blocksY; blockY++) {
+    for (uint32_t blockX = 0; blockX < blocksX; blockX++, blocks += bytes) {
+      uint8_t pixels[BLOCK_PIXELS][4];
+      if (format == BlockFormat::BC1) {
+        decompressBc1Block(blocks, pixels);
+      } else {
+        decompressBc7Block(blocks, pixels);
+      }
+
+      for (uint32_t y = blockY * 4; y < std::min(blockY * 4 + 4, height); y++) {
+        for (uint32_t x = blockX * 4; x < std::min(blockX * 4 + 4, width); x++) {
+          memcpy(rgba + (static_cast<size_t>(y) * width + x) * 4, pixels[(y & 3) * 4 + (x & 3)], 4);
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+enum class BlockFormat {
+  // 4 bits per pixel: two RGB565 endpoints and 2 bit indices, alpha is dropped
+  BC1,
+  // 8 bits per pixel, written as mode 6: RGBA7 endpoints with a shared low bit each and 4 bit indices
+  BC7,
+};
+
+inline size_t blockBytes(BlockFormat format) {
+  return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+// bytes of a width x height level, partial blocks at the right and bottom edges take a whole block
+size_t compressedSize(uint32_t width, uint32_t height, BlockFormat format);
+
+/*
+Encodes width x height RGBA8 pixels into 4x4 blocks, row by row of blocks. Pixels past the edges repeat the last row
+or column. Endpoints start from the principal axis of the block's colors and are refined by least squares on the
+chosen indices, BC7 also tries all four combinations of the endpoint low bits. Rows of blocks are spread over
+threadCount threads (0 = all cores); the nearest palette entry search runs SSE2 unless simd is false, both paths
+produce identical blocks.
+*/
+void compressBlocks(const uint8_t* rgba, uint32_t width, uint32_t height, BlockFormat format, uint8_t* blocks,
+                    bool simd = true, unsigned int threadCount = 0);
+
+// Decodes blocks back to RGBA8 to measure the encoding error. BC7 only covers mode 6, the one compressBlocks writes,
+// other modes decode to transparent black.
+void decompressBlocks(const uint8_t* blocks, uint32_t width, uint32_t height, BlockFormat format, uint8_t* rgba);
@@ -0,0 +1,207 @@
+#include "./commandrecorder.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "./parallel.h"
+#include "./profiler.h"
+
+CommandRecorder::~CommandRecorder() {
+  stopWorkers();
+}
+
+void CommandRecorder::init(VkDevice device, uint32_t queueFamily, uint32_t frameCount, unsigned int threadCount) {
+  _device      = device;
+  _queueFamily = queueFamily;
+  _threadCount = threadCount > 0 ? threadCount : workerThreadCount();
+
+  _threads.resize(_threadCount);
+  for (ThreadCommands& thread : _threads) {
+    for (uint32_t frame = 0; frame < frameCount; frame++) {
+      thread.commandPools.push_back(createCommandPool());
+      thread.commandBuffers.push_back(allocateCommandBuffer(thread.commandPools.back()));
+    }
+  }
+
+  _stopping = false;
+  for (unsigned int thread = 1; thread < _threadCount; thread++) {
+    _workers.emplace_back(&CommandRecorder::work, this, thread);
+  }
+}
+
+void CommandRecorder::destroy() {
+  stopWorkers();
+
+  // the command buffers go with their pools
+  for (ThreadCommands& thread : _threads) {
+    for (VkCommandPool commandPool : thread.commandPools) {
+      destroyCommandPool(commandPool);
+    }
+  }
+  _threads.clear();
+  _recorded.clear();
+}
+
+void CommandRecorder::stopWorkers() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _jobReady.notify_all();
+
+  for (std::thread& worker : _workers) {
+    worker.join();
+  }
+  _workers.clear();
+}
+
+size_t CommandRecorder::partitionCount(size_t drawCount) const {
+  size_t partitions = (drawCount + MIN_DRAWS_PER_PARTITION - 1) / MIN_DRAWS_PER_PARTITION;
+  return std::min<size_t>(partitions, _threadCount);
+}
+
+const std::vector<VkCommandBuffer>& CommandRecorder::record(uint32_t frame,
+                                                            const VkCommandBufferInheritanceInfo& inheritance,
+                                                            size_t drawCount, const RecordFunction& recordDraws) {
+  size_t partitionCount = this->partitionCount(drawCount);
+  _recorded.resize(partitionCount);
+  if (partitionCount == 0) {
+    return _recorded;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _frame             = frame;
+    _inheritance       = &inheritance;
+    _recordDraws       = &recordDraws;
+    _drawCount         = drawCount;
+    _partitionCount    = partitionCount;
+    _pendingPartitions = partitionCount - 1;
+    _error             = nullptr;
+    _job++;
+  }
+  if (partitionCount > 1) {
+    _jobReady.notify_all();
+  }
+
+  // the workers use the job until they are done with it, so even a failed first partition waits for them
+  std::exception_ptr error;
+  try {
+    recordPartition(0);
+  } catch (...) {
+    error = std::current_exception();
+  }
+
+  std::unique_lock<std::mutex> lock(_mutex);
+  _jobDone.wait(lock, [&] { return _pendingPartitions == 0; });
+  if (!error) {
+    error = _error;
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  return _recorded;
+}
+
+void CommandRecorder::work(unsigned int thread) {
+  setProfileThreadName("command recorder");
+
+  uint64_t                     lastJob = 0;
+  std::unique_lock<std::mutex> lock(_mutex);
+  for (;;) {
+    _jobReady.wait(lock, [&] { return _stopping || _job != lastJob; });
+    if (_stopping) {
+      return;
+    }
+    lastJob = _job;
+    if (thread >= _partitionCount) {
+      continue;
+    }
+    lock.unlock();
+
+    std::exception_ptr error;
+    try {
+      recordPartition(thread);
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    lock.lock();
+    if (error && !_error) {
+      _error = error;
+    }
+    if (--_pendingPartitions == 0) {
+      _jobDone.notify_one();
+    }
+  }
+}
+
+void CommandRecorder::recordPartition(unsigned int partition) {
+  PROFILE_ZONE("record partition");
+
+  size_t firstDraw = _drawCount * partition / _partitionCount;
+  size_t lastDraw  = _drawCount * (partition + 1) / _partitionCount;
+
+  ThreadCommands& thread        = _threads[partition];
+  VkCommandBuffer commandBuffer = thread.commandBuffers[_frame];
+  resetCommandPool(thread.commandPools[_frame]);
+
+  beginCommandBuffer(commandBuffer, *_inheritance);
+  (*_recordDraws)(commandBuffer, firstDraw, lastDraw - firstDraw);
+  endCommandBuffer(commandBuffer);
+
+  _recorded[partition] = commandBuffer;
+}
+
+VkCommandPool CommandRecorder::createCommandPool() {
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType                   = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.queueFamilyIndex        = _queueFamily;
+  poolInfo.flags                   = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+  VkCommandPool commandPool;
+  if (vkCreateCommandPool(_device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create command pool!");
+  }
+  return commandPool;
+}
+
+void CommandRecorder::destroyCommandPool(VkCommandPool commandPool) {
+  vkDestroyCommandPool(_device, commandPool, nullptr);
+}
+
+VkCommandBuffer CommandRecorder::allocateCommandBuffer(VkCommandPool commandPool) {
+  VkCommandBufferAllocateInfo allocInfo = {};
+  allocInfo.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.commandPool                 = commandPool;
+  allocInfo.level                       = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+  allocInfo.commandBufferCount          = 1;
+
+  VkCommandBuffer commandBuffer;
+  if (vkAllocateCommandBuffers(_device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate command buffers!");
+  }
+  return commandBuffer;
+}
+
+void CommandRecorder::resetCommandPool(VkCommandPool commandPool) {
+  vkResetCommandPool(_device, commandPool, 0);
+}
+
+void CommandRecorder::beginCommandBuffer(VkCommandBuffer                       commandBuffer,
+                                         const VkCommandBufferInheritanceInfo& inheritance) {
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  beginInfo.pInheritanceInfo = &inheritance;
+
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("failed to begin recording command buffer!");
+  }
+}
+
+void CommandRecorder::endCommandBuffer(VkCommandBuffer commandBuffer) {
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record command buffer!");
+  }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+Records a draw list into secondary command buffers on persistent worker threads, for a primary command buffer to run
+with vkCmdExecuteCommands in a render pass begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS. Command pools are
+externally synchronized, so every thread owns a transient pool per frame in flight and resets it itself right before
+recording into it.
+
+The list is cut into contiguous partitions of at least MIN_DRAWS_PER_PARTITION draws, at most one per thread, and the
+thread calling record() records the first one itself. Secondary command buffers inherit nothing but the render pass
+and framebuffer, the record function has to bind the pipeline and set the dynamic state in every partition.
+
+Recording only pays off when each draw is a command of its own. The app draws the model with multi draw indirect, so
+a partition there is one vkCmdDrawIndexedIndirect over a slice of the indirect buffer and nothing runs in parallel;
+until there are per-draw commands to record, the recorder is scaffolding and only its benchmark mock scales.
+*/
+class CommandRecorder {
+ public:
+  static constexpr size_t MIN_DRAWS_PER_PARTITION = 256;
+
+  // records draws [firstDraw, firstDraw + drawCount) into a secondary command buffer that has been begun
+  using RecordFunction = std::function<void(VkCommandBuffer commandBuffer, size_t firstDraw, size_t drawCount)>;
+
+  virtual ~CommandRecorder();
+
+  // threadCount counts the thread calling record(), 0 = all cores
+  void init(VkDevice device, uint32_t queueFamily, uint32_t frameCount, unsigned int threadCount = 0);
+  void destroy();
+
+  // the frame's fence must have signaled; the buffers come in draw order and stay valid until frame is recorded again
+  const std::vector<VkCommandBuffer>& record(uint32_t frame, const VkCommandBufferInheritanceInfo& inheritance,
+                                             size_t drawCount, const RecordFunction& recordDraws);
+
+  unsigned int threadCount() const {
+    return _threadCount;
+  }
+
+  // secondary command buffers record() would return for drawCount draws; with one, recording inline into the primary
+  // saves the vkCmdExecuteCommands and the worker wake-up
+  size_t partitionCount(size_t drawCount) const;
+
+ protected:
+  // the Vulkan calls, overridden to drive the recorder without a device
+  virtual VkCommandPool   createCommandPool();
+  virtual void            destroyCommandPool(VkCommandPool commandPool);
+  virtual VkCommandBuffer allocateCommandBuffer(VkCommandPool commandPool);
+  virtual void            resetCommandPool(VkCommandPool commandPool);
+  virtual void            beginCommandBuffer(VkCommandBuffer                       commandBuffer,
+                                             const VkCommandBufferInheritanceInfo& inheritance);
+  virtual void            endCommandBuffer(VkCommandBuffer commandBuffer);
+
+ private:
+  struct ThreadCommands {
+    std::vector<VkCommandPool>   commandPools;    // one per frame in flight
+    std::vector<VkCommandBuffer> commandBuffers;  // allocated from the pool of the same frame
+  };
+
+  VkDevice                     _device      = VK_NULL_HANDLE;
+  uint32_t                     _queueFamily = 0;
+  unsigned int                 _threadCount = 0;
+  std::vector<ThreadCommands>  _threads;  // [0] belongs to the thread calling record()
+  std::vector<std::thread>     _workers;
+  std::vector<VkCommandBuffer> _recorded;
+
+  // the current record() call, written under _mutex before the workers are woken
+  uint32_t                              _frame          = 0;
+  const VkCommandBufferInheritanceInfo* _inheritance    = nullptr;
+  const RecordFunction*                 _recordDraws    = nullptr;
+  size_t                                _drawCount      = 0;
+  size_t                                _partitionCount = 0;
+
+  std::mutex              _mutex;
+  std::condition_variable _jobReady;
+  std::condition_variable _jobDone;
+  uint64_t                _job               = 0;  // record() calls handed to the workers so far
+  size_t                  _pendingPartitions = 0;  // partitions the workers have not finished yet
+  bool                    _stopping          = false;
+  std::exception_ptr      _error;
+
+  void work(unsigned int thread);
+  void recordPartition(unsigned int partition);
+  void stopWorkers();
+};
@@ -0,0 +1,182 @@
+#include "./framestats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+constexpr auto DRAIN_INTERVAL  = std::chrono::milliseconds(50);
+constexpr auto REPORT_INTERVAL = std::chrono::seconds(1);
+
+float percentile(const std::vector<float>& sorted, double p) {
+  size_t index = static_cast<size_t>(std::ceil(p * sorted.size()));
+  return sorted[std::max<size_t>(index, 1) - 1];
+}
+
+}  // namespace
+
+FrameSummary summarizeFrames(const std::vector<float>& frameTimes) {
+  FrameSummary summary;
+  summary.frameCount = static_cast<uint32_t>(frameTimes.size());
+  if (frameTimes.empty()) {
+    return summary;
+  }
+
+  std::vector<float> sorted = frameTimes;
+  std::sort(sorted.begin(), sorted.end());
+  summary.p50Ms = percentile(sorted, 0.50);
+  summary.p95Ms = percentile(sorted, 0.95);
+  summary.p99Ms = percentile(sorted, 0.99);
+  summary.maxMs = sorted.back();
+
+  float hitchMs      = HITCH_FACTOR * summary.p50Ms;
+  summary.hitchCount = static_cast<uint32_t>(sorted.end() - std::upper_bound(sorted.begin(), sorted.end(), hitchMs));
+  return summary;
+}
+
+FrameStats::~FrameStats() {
+  stop();
+}
+
+void FrameStats::start(const std::string& csvPath) {
+  if (!csvPath.empty()) {
+    _csv.open(csvPath, std::ios::trunc);
+    if (!_csv) {
+      throw std::runtime_error("failed to open frame statistics file!");
+    }
+    _csv << "frame,ms,hitch,resize_ms\n";
+  }
+
+  _stopping = false;
+  _reporter = std::thread(&FrameStats::report, this);
+}
+
+void FrameStats::stop() {
+  if (!_reporter.joinable()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _wake.notify_one();
+  _reporter.join();
+  _csv.close();
+}
+
+void FrameStats::record(float frameMs, float resizeMs) {
+  uint64_t head = _head.load(std::memory_order_relaxed);
+  _ring[head % RING_SIZE].store({frameMs, resizeMs}, std::memory_order_relaxed);
+  _head.store(head + 1, std::memory_order_release);
+}
+
+bool FrameStats::takeSummary(FrameSummary& summary) {
+  std::unique_lock<std::mutex> lock(_mutex, std::try_to_lock);
+  if (!lock.owns_lock() || _summaryTaken) {
+    return false;
+  }
+  summary       = _summary;
+  _summaryTaken = true;
+  return true;
+}
+
+void FrameStats::print(std::string text) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _pending += text;
+}
+
+void FrameStats::report() {
+  std::vector<Sample> window;
+  auto                windowStart = std::chrono::steady_clock::now();
+
+  std::unique_lock<std::mutex> lock(_mutex);
+  for (;;) {
+    bool stopping = _wake.wait_for(lock, DRAIN_INTERVAL, [&] { return _stopping; });
+    lock.unlock();
+
+    drain(window);
+    auto  now     = std::chrono::steady_clock::now();
+    float seconds = std::chrono::duration<float>(now - windowStart).count();
+    if (stopping || now - windowStart >= REPORT_INTERVAL) {
+      summarize(window, seconds);
+      windowStart = now;
+    }
+
+    lock.lock();
+    if (stopping) {
+      return;
+    }
+  }
+}
+
+void FrameStats::drain(std::vector<Sample>& window) {
+  uint64_t head = _head.load(std::memory_order_acquire);
+  if (head - _tail > RING_SIZE) {
+    _lostCount += head - _tail - RING_SIZE;
+    _tail = head - RING_SIZE;
+  }
+
+  size_t first = window.size();
+  for (uint64_t frame = _tail; frame < head; frame++) {
+    window.push_back(_ring[frame % RING_SIZE].load(std::memory_order_relaxed));
+  }
+
+  // the render thread may have lapped the ring while it was read, what it overwrote is lost
+  uint64_t overwritten = _head.load(std::memory_order_acquire);
+  if (overwritten - _tail > RING_SIZE) {
+    uint64_t lost = std::min(overwritten - _tail - RING_SIZE, head - _tail);
+    window.erase(window.begin() + first, window.begin() + first + lost);
+    _lostCount += lost;
+  }
+  _tail = head;
+}
+
+void FrameStats::summarize(std::vector<Sample>& window, float seconds) {
+  std::vector<float> frameTimes(window.size());
+  for (size_t i = 0; i < window.size(); i++) {
+    frameTimes[i] = window[i].frameMs;
+  }
+  FrameSummary summary = summarizeFrames(frameTimes);
+
+  for (const Sample& sample : window) {
+    if (sample.resizeMs > 0.0f) {
+      summary.resizeCount++;
+      summary.resizeMaxMs = std::max(summary.resizeMaxMs, sample.resizeMs);
+    }
+  }
+
+  if (_csv.is_open()) {
+    for (const Sample& sample : window) {
+      _csv << _csvFrame++ << ',' << sample.frameMs << ',' << (sample.frameMs > HITCH_FACTOR * summary.p50Ms ? 1 : 0)
+           << ',' << sample.resizeMs << '\n';
+    }
+  }
+  window.clear();
+
+  std::string pending;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    pending.swap(_pending);
+    _summary      = summary;
+    _summaryTaken = false;
+  }
+
+  if (summary.frameCount > 0) {
+    std::cout << "Frames: " << summary.frameCount << " in " << seconds << " s, " << summary.p50Ms << " ms p50, "
+              << summary.p95Ms << " ms p95, " << summary.p99Ms << " ms p99, " << summary.maxMs << " ms max, "
+              << summary.hitchCount << " hitches";
+    if (summary.resizeCount > 0) {
+      std::cout << ", " << summary.resizeCount << " resizes taking up to " << summary.resizeMaxMs << " ms";
+    }
+    if (_lostCount > 0) {
+      std::cout << ", " << _lostCount << " frames lost";
+      _lostCount = 0;
+    }
+    std::cout << "\n";
+  }
+  std::cout << pending << std::flush;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Frame time distribution of one reporting interval.
+struct FrameSummary {
+  uint32_t frameCount = 0;
+  float    p50Ms      = 0.0f;
+  float    p95Ms      = 0.0f;
+  float    p99Ms      = 0.0f;
+  float    maxMs      = 0.0f;
+  uint32_t hitchCount = 0;  // frames taking more than HITCH_FACTOR times the median
+
+  // swap chain recreations, only filled in by FrameStats
+  uint32_t resizeCount = 0;
+  float    resizeMaxMs = 0.0f;
+};
+
+constexpr float HITCH_FACTOR = 2.0f;
+
+FrameSummary summarizeFrames(const std::vector<float>& frameTimes);
+
+/*
+Collects frame times without ever blocking the render loop. record() stores into a single producer ring of atomics; a
+reporter thread drains it every few milliseconds, prints one summary line a second and, when a CSV path was given,
+appends every frame there. Console output of other parts of the render loop goes through print() so it leaves from
+the same thread instead of interleaving.
+
+If the reporter falls more than RING_SIZE frames behind, the oldest ones are counted as lost rather than waited for.
+*/
+class FrameStats {
+ public:
+  static constexpr size_t RING_SIZE = 4096;
+
+  ~FrameStats();
+
+  // starts the reporter; an empty csvPath writes no CSV
+  void start(const std::string& csvPath = "");
+  // reports what is left and joins the reporter
+  void stop();
+
+  // from the render thread only; resizeMs is the part of the frame spent recreating the swap chain
+  void record(float frameMs, float resizeMs = 0.0f);
+
+  // the newest summary if one was made since the last call; never waits for the reporter
+  bool takeSummary(FrameSummary& summary);
+
+  // printed by the reporter with its next summary
+  void print(std::string text);
+
+ private:
+  struct Sample {
+    float frameMs;
+    float resizeMs;
+  };
+
+  std::array<std::atomic<Sample>, RING_SIZE> _ring;
+  std::atomic<uint64_t>                      _head{0};   // frames ever recorded
+  uint64_t                                   _tail = 0;  // frames drained, reporter only
+
+  std::thread             _reporter;
+  std::mutex              _mutex;
+  std::condition_variable _wake;
+  bool                    _stopping = false;
+  std::string             _pending;  // text for print(), guarded by _mutex
+  FrameSummary            _summary;  // guarded by _mutex
+  bool                    _summaryTaken = true;
+
+  std::ofstream _csv;
+  uint64_t      _csvFrame  = 0;
+  uint64_t      _lostCount = 0;
+
+  void report();
+  void drain(std::vector<Sample>& window);
+  void summarize(std::vector<Sample>& window, float seconds);
+};
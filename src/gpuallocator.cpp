@@ -0,0 +1,263 @@
+#include "./gpuallocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+const VkDeviceSize LARGE_HEAP_BLOCK_SIZE = VkDeviceSize(64) << 20;
+const VkDeviceSize SMALL_HEAP_SIZE       = VkDeviceSize(1) << 30;
+const int          BLOCK_SIZE_FALLBACKS  = 3;  // halve a block this often before giving up on a heap
+
+}  // namespace
+
+void GpuAllocator::init(VkPhysicalDevice physicalDevice, VkDevice device) {
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  VkPhysicalDeviceProperties       properties;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+  _device = device;
+  init(memoryProperties, properties.limits.bufferImageGranularity);
+}
+
+void GpuAllocator::init(const VkPhysicalDeviceMemoryProperties& memoryProperties,
+                        VkDeviceSize                            bufferImageGranularity) {
+  _memoryProperties       = memoryProperties;
+  _bufferImageGranularity = std::max<VkDeviceSize>(bufferImageGranularity, 1);
+  _deviceAllocationCount  = 0;
+
+  _pools.clear();
+  for (uint32_t type = 0; type < memoryProperties.memoryTypeCount; type++) {
+    _pools.push_back({type, {}});
+    _pools.push_back({type, {}});
+  }
+  _dedicatedCounts.assign(memoryProperties.memoryHeapCount, 0);
+  _dedicatedBytes.assign(memoryProperties.memoryHeapCount, 0);
+}
+
+void GpuAllocator::destroy() {
+  for (Pool& pool : _pools) {
+    for (Block& block : pool.blocks) {
+      if (block.memory != VK_NULL_HANDLE) {
+        freeMemory(block.memory);
+        _deviceAllocationCount--;
+      }
+    }
+    pool.blocks.clear();
+  }
+}
+
+// a fixed size for large heaps, an eighth of small ones such as the 256 MB host visible device local heap
+VkDeviceSize GpuAllocator::blockSize(uint32_t memoryType) const {
+  VkDeviceSize heapSize = _memoryProperties.memoryHeaps[_memoryProperties.memoryTypes[memoryType].heapIndex].size;
+  return heapSize <= SMALL_HEAP_SIZE ? heapSize / 8 : LARGE_HEAP_BLOCK_SIZE;
+}
+
+GpuAllocation GpuAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+                                     bool optimalImage) {
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  bool suitable = false;
+  for (uint32_t type = 0; type < _memoryProperties.memoryTypeCount; type++) {
+    if ((requirements.memoryTypeBits & (1u << type)) &&
+        (_memoryProperties.memoryTypes[type].propertyFlags & properties) == properties) {
+      suitable = true;
+
+      GpuAllocation allocation;
+      if (allocateFromType(type, requirements, optimalImage, allocation)) {
+        return allocation;
+      }
+    }
+  }
+
+  throw std::runtime_error(suitable ? "failed to allocate device memory!" : "failed to find suitable memory type!");
+}
+
+bool GpuAllocator::allocateFromType(uint32_t memoryType, const VkMemoryRequirements& requirements, bool optimalImage,
+                                    GpuAllocation& allocation) {
+  uint32_t heap        = _memoryProperties.memoryTypes[memoryType].heapIndex;
+  bool     hostVisible = _memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+
+  allocation.memoryType = memoryType;
+  allocation.size       = requirements.size;
+
+  if (requirements.size > blockSize(memoryType) / 2) {
+    if (allocateMemory(memoryType, requirements.size, allocation.memory) != VK_SUCCESS) {
+      return false;
+    }
+    allocation.mapped = hostVisible ? mapOrFree(allocation.memory, requirements.size) : nullptr;
+
+    _deviceAllocationCount++;
+    _dedicatedCounts[heap]++;
+    _dedicatedBytes[heap] += requirements.size;
+
+    allocation.offset = 0;
+    allocation.block  = DEDICATED;
+    return true;
+  }
+
+  uint32_t poolIndex = memoryType * 2 + (optimalImage && _bufferImageGranularity > 1 ? 1 : 0);
+  Pool&    pool      = _pools[poolIndex];
+
+  // first fit over the blocks, each block answers in constant time
+  uint32_t blockIndex = 0;
+  uint32_t range      = RangeAllocator::INVALID;
+  for (; blockIndex < pool.blocks.size() && range == RangeAllocator::INVALID; blockIndex++) {
+    if (pool.blocks[blockIndex].memory != VK_NULL_HANDLE) {
+      range = pool.blocks[blockIndex].ranges.allocate(requirements.size, requirements.alignment);
+    }
+  }
+  if (range != RangeAllocator::INVALID) {
+    blockIndex--;
+  } else {
+    if (!createBlock(pool, requirements.size, blockIndex)) {
+      return false;
+    }
+    range = pool.blocks[blockIndex].ranges.allocate(requirements.size, requirements.alignment);
+  }
+
+  Block& block      = pool.blocks[blockIndex];
+  allocation.offset = block.ranges.offset(range);
+  allocation.memory = block.memory;
+  allocation.mapped = block.mapped ? block.mapped + allocation.offset : nullptr;
+  allocation.pool   = poolIndex;
+  allocation.block  = blockIndex;
+  allocation.range  = range;
+  return true;
+}
+
+bool GpuAllocator::createBlock(Pool& pool, VkDeviceSize minimumSize, uint32_t& blockIndex) {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize   size   = blockSize(pool.memoryType);
+  for (int attempt = 0;; attempt++) {
+    if (allocateMemory(pool.memoryType, size, memory) == VK_SUCCESS) {
+      break;
+    }
+    if (attempt == BLOCK_SIZE_FALLBACKS || size / 2 < minimumSize) {
+      return false;
+    }
+    size /= 2;
+  }
+
+  VkMemoryPropertyFlags flags  = _memoryProperties.memoryTypes[pool.memoryType].propertyFlags;
+  void*                 mapped = (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ? mapOrFree(memory, size) : nullptr;
+  _deviceAllocationCount++;
+
+  // reuse the slot of a released block so the indices of live allocations stay valid
+  blockIndex = 0;
+  while (blockIndex < pool.blocks.size() && pool.blocks[blockIndex].memory != VK_NULL_HANDLE) {
+    blockIndex++;
+  }
+  if (blockIndex == pool.blocks.size()) {
+    pool.blocks.emplace_back();
+  }
+
+  Block& block = pool.blocks[blockIndex];
+  block.memory = memory;
+  block.mapped = static_cast<uint8_t*>(mapped);
+  block.ranges = RangeAllocator(size);
+  return true;
+}
+
+void GpuAllocator::free(GpuAllocation& allocation) {
+  if (allocation.memory == VK_NULL_HANDLE) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  if (allocation.block == DEDICATED) {
+    uint32_t heap = _memoryProperties.memoryTypes[allocation.memoryType].heapIndex;
+    freeMemory(allocation.memory);
+    _deviceAllocationCount--;
+    _dedicatedCounts[heap]--;
+    _dedicatedBytes[heap] -= allocation.size;
+  } else {
+    Pool&  pool  = _pools[allocation.pool];
+    Block& block = pool.blocks[allocation.block];
+    block.ranges.free(allocation.range);
+
+    // an empty block is kept while it is the pool's last one, so filling and draining does not thrash the driver
+    if (block.ranges.allocationCount() == 0) {
+      bool otherBlocks = std::any_of(pool.blocks.begin(), pool.blocks.end(), [&](const Block& other) {
+        return &other != &block && other.memory != VK_NULL_HANDLE;
+      });
+      if (otherBlocks) {
+        freeMemory(block.memory);
+        _deviceAllocationCount--;
+        block = Block();
+      }
+    }
+  }
+
+  allocation = GpuAllocation();
+}
+
+std::vector<GpuHeapStats> GpuAllocator::heapStats() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  std::vector<GpuHeapStats> stats(_memoryProperties.memoryHeapCount, GpuHeapStats());
+  std::vector<VkDeviceSize> freeBytes(_memoryProperties.memoryHeapCount, 0);
+  std::vector<VkDeviceSize> contiguousBytes(_memoryProperties.memoryHeapCount, 0);
+
+  for (uint32_t heap = 0; heap < _memoryProperties.memoryHeapCount; heap++) {
+    stats[heap].heapSize        = _memoryProperties.memoryHeaps[heap].size;
+    stats[heap].dedicatedCount  = _dedicatedCounts[heap];
+    stats[heap].dedicatedBytes  = _dedicatedBytes[heap];
+    stats[heap].allocationCount = _dedicatedCounts[heap];
+  }
+
+  for (const Pool& pool : _pools) {
+    uint32_t heap = _memoryProperties.memoryTypes[pool.memoryType].heapIndex;
+    for (const Block& block : pool.blocks) {
+      if (block.memory == VK_NULL_HANDLE) {
+        continue;
+      }
+      GpuHeapStats& heapStat = stats[heap];
+      heapStat.blockCount++;
+      heapStat.blockBytes += block.ranges.size();
+      heapStat.usedBytes += block.ranges.usedBytes();
+      heapStat.allocationCount += block.ranges.allocationCount();
+      heapStat.freeRangeCount += block.ranges.freeRangeCount();
+      heapStat.largestFreeRange = std::max(heapStat.largestFreeRange, block.ranges.largestFreeRange());
+      freeBytes[heap] += block.ranges.size() - block.ranges.usedBytes();
+      contiguousBytes[heap] += block.ranges.largestFreeRange();
+    }
+  }
+
+  for (uint32_t heap = 0; heap < _memoryProperties.memoryHeapCount; heap++) {
+    stats[heap].fragmentation =
+        freeBytes[heap] > 0 ? 1.0f - static_cast<float>(contiguousBytes[heap]) / freeBytes[heap] : 0.0f;
+  }
+  return stats;
+}
+
+void* GpuAllocator::mapOrFree(VkDeviceMemory memory, VkDeviceSize size) {
+  try {
+    return mapMemory(memory, size);
+  } catch (...) {
+    freeMemory(memory);
+    throw;
+  }
+}
+
+VkResult GpuAllocator::allocateMemory(uint32_t memoryType, VkDeviceSize size, VkDeviceMemory& memory) {
+  VkMemoryAllocateInfo allocInfo = {};
+  allocInfo.sType                = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize       = size;
+  allocInfo.memoryTypeIndex      = memoryType;
+
+  return vkAllocateMemory(_device, &allocInfo, nullptr, &memory);
+}
+
+void GpuAllocator::freeMemory(VkDeviceMemory memory) {
+  vkFreeMemory(_device, memory, nullptr);
+}
+
+void* GpuAllocator::mapMemory(VkDeviceMemory memory, VkDeviceSize size) {
+  void* data = nullptr;
+  if (vkMapMemory(_device, memory, 0, size, 0, &data) != VK_SUCCESS) {
+    throw std::runtime_error("failed to map device memory!");
+  }
+  return data;
+}
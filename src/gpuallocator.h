@@ -0,0 +1,105 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "./rangeallocator.h"
+
+// A range of device memory handed out by GpuAllocator, bind resources at memory + offset.
+struct GpuAllocation {
+  VkDeviceMemory memory     = VK_NULL_HANDLE;
+  VkDeviceSize   offset     = 0;
+  VkDeviceSize   size       = 0;
+  void*          mapped     = nullptr;  // host visible memory stays mapped, this already includes offset
+  uint32_t       memoryType = 0;
+  uint32_t       pool       = 0;
+  uint32_t       block      = 0;  // DEDICATED when the allocation owns its memory
+  uint32_t       range      = 0;
+};
+
+struct GpuHeapStats {
+  VkDeviceSize heapSize;
+  uint32_t     blockCount;
+  VkDeviceSize blockBytes;  // reserved by blocks, used or not
+  VkDeviceSize usedBytes;   // handed out from blocks
+  uint32_t     allocationCount;
+  uint32_t     dedicatedCount;
+  VkDeviceSize dedicatedBytes;
+  uint32_t     freeRangeCount;
+  VkDeviceSize largestFreeRange;
+  float        fragmentation;  // 1 - sum of each block's largest free range / free bytes, 0 when no block is split
+};
+
+/*
+Sub-allocates buffers and images from large VkDeviceMemory blocks instead of one vkAllocateMemory per resource. Every
+memory type has its own blocks, each managed by a TLSF RangeAllocator. When bufferImageGranularity is larger than one,
+buffers and optimally tiled images go to separate blocks so they never share a granularity page. Resources larger
+than half a block get a dedicated allocation, blocks that run empty are released as long as another block of the
+same pool remains.
+
+Host visible blocks are mapped once when they are created. Allocations of host visible memory must ask for
+HOST_COHERENT as well, nothing is flushed. allocate, free and heapStats may be called from several threads.
+*/
+class GpuAllocator {
+ public:
+  static constexpr uint32_t DEDICATED = UINT32_MAX;
+
+  virtual ~GpuAllocator() = default;
+
+  void init(VkPhysicalDevice physicalDevice, VkDevice device);
+  void init(const VkPhysicalDeviceMemoryProperties& memoryProperties, VkDeviceSize bufferImageGranularity);
+
+  // frees every block, all allocations have to be freed before
+  void destroy();
+
+  // picks the first memory type with the properties and falls back to the next one when its heap is exhausted;
+  // throws when no memory type fits or every candidate heap is out of memory
+  GpuAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+                         bool optimalImage);
+  void          free(GpuAllocation& allocation);
+
+  std::vector<GpuHeapStats> heapStats() const;
+
+  // vkAllocateMemory calls that are currently live, blocks and dedicated allocations
+  uint32_t deviceAllocationCount() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _deviceAllocationCount;
+  }
+
+ protected:
+  // the only device calls, overridden by the allocator benchmark to run against a mock memory type table
+  virtual VkResult allocateMemory(uint32_t memoryType, VkDeviceSize size, VkDeviceMemory& memory);
+  virtual void     freeMemory(VkDeviceMemory memory);
+  virtual void*    mapMemory(VkDeviceMemory memory, VkDeviceSize size);
+
+ private:
+  struct Block {
+    VkDeviceMemory memory = VK_NULL_HANDLE;  // null once released, the slot is then reused
+    uint8_t*       mapped = nullptr;
+    RangeAllocator ranges{0};
+  };
+
+  struct Pool {
+    uint32_t           memoryType;
+    std::vector<Block> blocks;
+  };
+
+  mutable std::mutex               _mutex;
+  VkDevice                         _device = VK_NULL_HANDLE;
+  VkPhysicalDeviceMemoryProperties _memoryProperties;
+  VkDeviceSize                     _bufferImageGranularity = 1;
+  std::vector<Pool>                _pools;  // two per memory type: buffers and linear images, optimal images
+  std::vector<uint32_t>            _dedicatedCounts;
+  std::vector<VkDeviceSize>        _dedicatedBytes;
+  uint32_t                         _deviceAllocationCount = 0;
+
+  VkDeviceSize blockSize(uint32_t memoryType) const;
+  bool         allocateFromType(uint32_t memoryType, const VkMemoryRequirements& requirements, bool optimalImage,
+                                GpuAllocation& allocation);
+  bool         createBlock(Pool& pool, VkDeviceSize minimumSize, uint32_t& blockIndex);
+  // maps freshly allocated memory, frees it again when mapping throws so nothing leaks
+  void*        mapOrFree(VkDeviceMemory memory, VkDeviceSize size);
+};
@@ -0,0 +1,206 @@
+#include "./gpuprofiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+// in the order vkGetQueryPoolResults writes them, lowest bit first
+constexpr VkQueryPipelineStatisticFlags STATISTICS = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+                                                     VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+                                                     VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+                                                     VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+VkQueryPool createQueryPool(VkDevice device, VkQueryType type, uint32_t count,
+                            VkQueryPipelineStatisticFlags statistics = 0) {
+  VkQueryPoolCreateInfo poolInfo = {};
+  poolInfo.sType                 = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  poolInfo.queryType             = type;
+  poolInfo.queryCount            = count;
+  poolInfo.pipelineStatistics    = statistics;
+
+  VkQueryPool pool;
+  if (vkCreateQueryPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create query pool!");
+  }
+  return pool;
+}
+
+}  // namespace
+
+uint32_t GpuProfiler::addPass(std::string name) {
+  if (_device != VK_NULL_HANDLE) {
+    throw std::logic_error("passes have to be added before init!");
+  }
+
+  Pass pass;
+  pass.name = std::move(name);
+  _passes.push_back(std::move(pass));
+  return static_cast<uint32_t>(_passes.size() - 1);
+}
+
+void GpuProfiler::init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily, uint32_t frameCount) {
+  _device = device;
+  _submitted.assign(frameCount, false);
+
+  uint32_t passCount = static_cast<uint32_t>(_passes.size());
+  if (passCount == 0) {
+    return;
+  }
+
+  uint32_t familyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> families(familyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+  uint32_t timestampBits = families[queueFamily].timestampValidBits;
+  if (timestampBits > 0) {
+    _timestampPeriod = properties.limits.timestampPeriod;
+    _timestampMask   = timestampBits == 64 ? ~uint64_t(0) : (uint64_t(1) << timestampBits) - 1;
+    _timestampPool   = createQueryPool(_device, VK_QUERY_TYPE_TIMESTAMP, 2 * passCount * frameCount);
+  }
+
+  // createLogicalDevice enables the features wherever they are supported
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+  _inheritedQueries = supportedFeatures.inheritedQueries;
+  if (supportedFeatures.pipelineStatisticsQuery) {
+    _statisticsPool = createQueryPool(_device, VK_QUERY_TYPE_PIPELINE_STATISTICS, passCount * frameCount, STATISTICS);
+  }
+}
+
+void GpuProfiler::destroy() {
+  vkDestroyQueryPool(_device, _timestampPool, nullptr);
+  vkDestroyQueryPool(_device, _statisticsPool, nullptr);
+  _timestampPool  = VK_NULL_HANDLE;
+  _statisticsPool = VK_NULL_HANDLE;
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frame) {
+  uint32_t passCount = static_cast<uint32_t>(_passes.size());
+  if (_timestampPool != VK_NULL_HANDLE) {
+    vkCmdResetQueryPool(commandBuffer, _timestampPool, 2 * passCount * frame, 2 * passCount);
+  }
+  if (_statisticsPool != VK_NULL_HANDLE) {
+    vkCmdResetQueryPool(commandBuffer, _statisticsPool, passCount * frame, passCount);
+  }
+}
+
+VkQueryPipelineStatisticFlags GpuProfiler::inheritedStatistics() const {
+  return _statisticsPool != VK_NULL_HANDLE && _inheritedQueries ? STATISTICS : 0;
+}
+
+void GpuProfiler::beginPass(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t pass) {
+  uint32_t query = static_cast<uint32_t>(_passes.size()) * frame + pass;
+  if (_timestampPool != VK_NULL_HANDLE) {
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, _timestampPool, 2 * query);
+  }
+  if (_statisticsPool != VK_NULL_HANDLE) {
+    vkCmdBeginQuery(commandBuffer, _statisticsPool, query, 0);
+  }
+}
+
+void GpuProfiler::endPass(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t pass) {
+  uint32_t query = static_cast<uint32_t>(_passes.size()) * frame + pass;
+  if (_statisticsPool != VK_NULL_HANDLE) {
+    vkCmdEndQuery(commandBuffer, _statisticsPool, query);
+  }
+  if (_timestampPool != VK_NULL_HANDLE) {
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _timestampPool, 2 * query + 1);
+  }
+}
+
+void GpuProfiler::frameSubmitted(uint32_t frame) {
+  _submitted[frame] = true;
+}
+
+void GpuProfiler::collect(uint32_t frame) {
+  if (!_submitted[frame] || _passes.empty()) {
+    return;
+  }
+  _submitted[frame] = false;
+
+  // every value is followed by its availability, passes left out of the frame report 0 there
+  uint32_t              passCount = static_cast<uint32_t>(_passes.size());
+  VkQueryResultFlags    flags     = VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT;
+  std::vector<uint64_t> timestamps(2 * passCount * 2);
+  std::vector<uint64_t> statistics(passCount * (STATISTIC_COUNT + 1));
+
+  // VK_NOT_READY only means some queries are unavailable, their availability says which
+  if (_timestampPool != VK_NULL_HANDLE) {
+    vkGetQueryPoolResults(_device, _timestampPool, 2 * passCount * frame, 2 * passCount,
+                          timestamps.size() * sizeof(uint64_t), timestamps.data(), 2 * sizeof(uint64_t), flags);
+  }
+  if (_statisticsPool != VK_NULL_HANDLE) {
+    vkGetQueryPoolResults(_device, _statisticsPool, passCount * frame, passCount,
+                          statistics.size() * sizeof(uint64_t), statistics.data(),
+                          (STATISTIC_COUNT + 1) * sizeof(uint64_t), flags);
+  }
+
+  for (uint32_t p = 0; p < passCount; p++) {
+    Sample sample;
+    bool   sampled = false;
+
+    const uint64_t* begin = &timestamps[4 * p];
+    const uint64_t* end   = &timestamps[4 * p + 2];
+    if (begin[1] != 0 && end[1] != 0) {
+      sample.ms = static_cast<float>(((end[0] - begin[0]) & _timestampMask) * _timestampPeriod / 1e6);
+      sampled   = true;
+    }
+
+    const uint64_t* values = &statistics[(STATISTIC_COUNT + 1) * p];
+    if (values[STATISTIC_COUNT] != 0) {
+      std::copy(values, values + STATISTIC_COUNT, sample.statistics.begin());
+      sampled = true;
+    }
+
+    if (sampled) {
+      Pass& pass = _passes[p];
+      if (pass.samples.size() < WINDOW_SIZE) {
+        pass.samples.push_back(sample);
+      } else {
+        pass.samples[pass.next] = sample;
+      }
+      pass.next = (pass.next + 1) % WINDOW_SIZE;
+    }
+  }
+}
+
+GpuPassStats GpuProfiler::passStats(uint32_t pass) const {
+  const Pass&  source = _passes[pass];
+  GpuPassStats stats;
+  stats.name        = source.name;
+  stats.sampleCount = static_cast<uint32_t>(source.samples.size());
+  if (source.samples.empty()) {
+    return stats;
+  }
+
+  std::vector<float>                    times;
+  std::array<uint64_t, STATISTIC_COUNT> sums = {};
+  for (const Sample& sample : source.samples) {
+    times.push_back(sample.ms);
+    for (uint32_t s = 0; s < STATISTIC_COUNT; s++) {
+      sums[s] += sample.statistics[s];
+    }
+  }
+  std::sort(times.begin(), times.end());
+
+  float total = 0.0f;
+  for (float time : times) {
+    total += time;
+  }
+  size_t p99Index = static_cast<size_t>(std::ceil(0.99 * times.size())) - 1;
+
+  stats.minMs               = times.front();
+  stats.avgMs               = total / times.size();
+  stats.p99Ms               = times[p99Index];
+  stats.vertexInvocations   = sums[0] / times.size();
+  stats.clippingInvocations = sums[1] / times.size();
+  stats.clippingPrimitives  = sums[2] / times.size();
+  stats.fragmentInvocations = sums[3] / times.size();
+  return stats;
+}
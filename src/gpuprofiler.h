@@ -0,0 +1,100 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A pass's GPU time over the last GpuProfiler::WINDOW_SIZE frames it was recorded in.
+struct GpuPassStats {
+  std::string name;
+  uint32_t    sampleCount = 0;
+  float       minMs       = 0.0f;
+  float       avgMs       = 0.0f;
+  float       p99Ms       = 0.0f;
+
+  // averages over the same frames, 0 without the pipelineStatisticsQuery feature
+  uint64_t vertexInvocations   = 0;
+  uint64_t clippingInvocations = 0;  // primitives entering the clipper
+  uint64_t clippingPrimitives  = 0;  // primitives leaving it
+  uint64_t fragmentInvocations = 0;
+};
+
+/*
+GPU time and pipeline statistics per pass. Each frame in flight has queries of its own: the frame's command buffer
+resets them in beginFrame() and brackets every pass with beginPass()/endPass(), collect() reads them back once the
+frame's fence has signalled. Results therefore arrive a frame-in-flight cycle late and reading them never waits for
+the GPU; a pass left out of a frame is simply not sampled for it.
+
+Passes are registered with addPass() before init(). Pipeline statistics need the pipelineStatisticsQuery feature to be
+enabled on the device, timestamps a graphics queue with timestamp bits; whatever is missing records nothing. Secondary
+command buffers may only run inside a measured pass when inheritedQueries is enabled as well, without it a pass has to
+record its draws inline, see allowsSecondaryCommandBuffers().
+*/
+class GpuProfiler {
+ public:
+  static constexpr uint32_t WINDOW_SIZE = 256;
+
+  uint32_t addPass(std::string name);
+
+  void init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily, uint32_t frameCount);
+  void destroy();
+
+  // recorded outside of any render pass, before the first beginPass() of the frame
+  void beginFrame(VkCommandBuffer commandBuffer, uint32_t frame);
+  void beginPass(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t pass);
+  void endPass(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t pass);
+
+  // a command buffer recorded for frame was submitted
+  void frameSubmitted(uint32_t frame);
+  // reads what frame's last submission measured, call after its fence has signalled and before submitting it again
+  void collect(uint32_t frame);
+
+  uint32_t passCount() const {
+    return static_cast<uint32_t>(_passes.size());
+  }
+
+  bool hasTimestamps() const {
+    return _timestampPool != VK_NULL_HANDLE;
+  }
+
+  bool hasPipelineStatistics() const {
+    return _statisticsPool != VK_NULL_HANDLE;
+  }
+
+  // false while pipeline statistics are measured on a device without inheritedQueries
+  bool allowsSecondaryCommandBuffers() const {
+    return _statisticsPool == VK_NULL_HANDLE || _inheritedQueries;
+  }
+
+  // for VkCommandBufferInheritanceInfo::pipelineStatistics of secondary command buffers executed inside a pass
+  VkQueryPipelineStatisticFlags inheritedStatistics() const;
+
+  GpuPassStats passStats(uint32_t pass) const;
+
+ private:
+  static constexpr uint32_t STATISTIC_COUNT = 4;
+
+  struct Sample {
+    float                                 ms         = 0.0f;
+    std::array<uint64_t, STATISTIC_COUNT> statistics = {};
+  };
+
+  struct Pass {
+    std::string         name;
+    std::vector<Sample> samples;  // ring of the last WINDOW_SIZE frames
+    uint32_t            next = 0;
+  };
+
+  VkDevice    _device           = VK_NULL_HANDLE;
+  VkQueryPool _timestampPool    = VK_NULL_HANDLE;  // two per pass and frame
+  VkQueryPool _statisticsPool   = VK_NULL_HANDLE;  // one per pass and frame
+  float       _timestampPeriod  = 1.0f;            // ns per tick
+  uint64_t    _timestampMask    = 0;
+  bool        _inheritedQueries = false;           // statistics queries may stay active across secondaries
+
+  std::vector<Pass> _passes;
+  std::vector<bool> _submitted;  // per frame, queries hold results nobody has collected yet
+};
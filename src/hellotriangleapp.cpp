@@ -2,15 +2,33 @@
 
 #include <algorithm>
 #include <chrono>
-#include <fstream>
+#include <cmath>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
 #include <set>
+#include <sstream>
 #include <stdexcept>
-#include <unordered_map>
 #include <vector>
 
+#include "./blockcompression.h"
+#include "./commandrecorder.h"
+#include "./gpuallocator.h"
+#include "./gpuprofiler.h"
+#include "./jpegdecoder.h"
+#include "./mappedfile.h"
+#include "./meshlet.h"
+#include "./meshoptimizer.h"
+#include "./meshsimplifier.h"
+#include "./mipmap.h"
+#include "./objparser.h"
+#include "./pipelinecache.h"
+#include "./profiler.h"
+#include "./taskgraph.h"
+#include "./texturecache.h"
+#include "./vertexdedup.h"
+#include "./vertexpacking.h"
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "./stb_image.h"
 
@@ -36,37 +54,125 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT
   }
 }
 
-static std::vector<char> readFile(const std::string& filename) {
-  std::ifstream file(filename, std::ios::ate | std::ios::binary);
+static void printLods(const MeshLod* lods, size_t lodCount) {
+  for (size_t l = 0; l < lodCount; l++) {
+    std::cout << "\tLOD " << l << ": " << lods[l].indexCount / 3 << " triangles, error " << lods[l].error << std::endl;
+  }
+}
+
+static void printHeapStats(const std::vector<GpuHeapStats>& heaps) {
+  for (size_t h = 0; h < heaps.size(); h++) {
+    const GpuHeapStats& heap = heaps[h];
+    if (heap.blockCount == 0 && heap.dedicatedCount == 0) {
+      continue;
+    }
+    std::cout << "\tHeap " << h << ": " << heap.allocationCount << " allocations, " << heap.usedBytes / 1024
+              << " KB used of " << heap.blockCount << " blocks (" << heap.blockBytes / 1024 << " KB), "
+              << heap.dedicatedCount << " dedicated (" << heap.dedicatedBytes / 1024 << " KB), " << heap.freeRangeCount
+              << " free ranges, fragmentation " << heap.fragmentation << std::endl;
+  }
+}
 
-  if (!file.is_open()) {
+static void printGpuPassStats(std::ostream& out, const GpuPassStats& pass) {
+  out << "GPU " << pass.name << " pass over " << pass.sampleCount << " frames: " << pass.minMs << " ms min, "
+      << pass.avgMs << " ms avg, " << pass.p99Ms << " ms p99; " << pass.vertexInvocations << " vertex and "
+      << pass.fragmentInvocations << " fragment invocations, " << pass.clippingPrimitives << " of "
+      << pass.clippingInvocations << " primitives left after clipping\n";
+}
+
+static MappedFile readFile(const std::string& filename) {
+  MappedFile file;
+
+  if (!file.open(filename)) {
     throw std::runtime_error("failed to open file!");
   }
 
-  size_t            fileSize = (size_t)file.tellg();
-  std::vector<char> buffer(fileSize);
+  return file;
+}
+
+// true when the SPIR-V module decorates a resource with this descriptor binding
+static bool spirvUsesBinding(const MappedFile& code, uint32_t binding) {
+  const uint32_t OP_DECORATE        = 71;
+  const uint32_t DECORATION_BINDING = 33;
+
+  const uint32_t* words     = reinterpret_cast<const uint32_t*>(code.data());
+  size_t          wordCount = code.size() / sizeof(uint32_t);
+
+  // the instructions follow the 5 word header, each starts with its word count and opcode
+  for (size_t i = 5; i < wordCount;) {
+    uint32_t length = words[i] >> 16;
+    uint32_t opcode = words[i] & 0xffff;
+    if (length == 0 || length > wordCount - i) {
+      return false;
+    }
+    if (opcode == OP_DECORATE && length >= 4 && words[i + 2] == DECORATION_BINDING && words[i + 3] == binding) {
+      return true;
+    }
+    i += length;
+  }
+  return false;
+}
+
+// baseline JPEGs are decoded across all cores, everything else goes through stb
+static void decodeTexture(const MappedFile& textureFile, bool parallelJpeg, uint8_t* pixels, size_t imageSize) {
+  const uint8_t* fileData = reinterpret_cast<const uint8_t*>(textureFile.data());
 
-  file.seekg(0);
-  file.read(buffer.data(), fileSize);
+  auto decodeStartTime = std::chrono::high_resolution_clock::now();
+  bool decoded         = parallelJpeg && decodeJpeg(fileData, textureFile.size(), pixels);
+  if (!decoded) {
+    int      texWidth, texHeight, texChannels;
+    stbi_uc* stbPixels = stbi_load_from_memory(fileData, static_cast<int>(textureFile.size()), &texWidth, &texHeight,
+                                               &texChannels, STBI_rgb_alpha);
+    if (!stbPixels) {
+      throw std::runtime_error("failed to load texture image!");
+    }
+    memcpy(pixels, stbPixels, imageSize);
+    stbi_image_free(stbPixels);
+  }
+  auto  decodeEndTime  = std::chrono::high_resolution_clock::now();
+  float decodeDuration =
+      std::chrono::duration<float, std::chrono::milliseconds::period>(decodeEndTime - decodeStartTime).count();
+  std::cout << "decoded " << HelloTriangleApp::TEXTURE_PATH << " with "
+            << (decoded ? "the parallel JPEG decoder" : "stb_image") << " in " << decodeDuration << " ms" << std::endl;
+}
 
-  file.close();
+void HelloTriangleApp::setFrameStatsCsv(const std::string& path) {
+  _frameStatsCsvPath = path;
+}
+
+void HelloTriangleApp::setHeadless(uint32_t frameCount) {
+  _headless       = true;
+  _headlessFrames = frameCount;
+  _streamAssets   = false;  // every measured frame draws the whole scene
+}
 
-  return buffer;
+void HelloTriangleApp::setObjectCount(uint32_t count) {
+  _objectCount = std::max(count, 1u);
 }
 
 void HelloTriangleApp::run() {
-  initWindow();
+  setProfileThreadName("main");
+
+  if (!_headless) {
+    initWindow();
+  }
   initVulkan();
   mainLoop();
+  writeTrace();
   cleanup();
 }
 
+void HelloTriangleApp::writeTrace() {
+  size_t zoneCount = writeChromeTrace(TRACE_PATH);
+  std::cout << "wrote " << zoneCount << " profile zones to " << TRACE_PATH << std::endl;
+}
+
 void HelloTriangleApp::initWindow() {
   glfwInit();
 
   glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 
-  _window = glfwCreateWindow(_windowGeometry.size.x, _windowGeometry.size.y, "Vulkan Hello Triangle", nullptr, nullptr);
+  _window = glfwCreateWindow(_windowGeometry.size.x, _windowGeometry.size.y, WINDOW_TITLE, nullptr, nullptr);
   glfwSetWindowPos(_window, _windowGeometry.pos.x, _windowGeometry.pos.y);
   glfwSwapInterval(1);  // Enable vsync
   glfwSetWindowUserPointer(_window, this);
@@ -76,32 +182,136 @@ void HelloTriangleApp::initWindow() {
   glfwSetKeyCallback(_window, HelloTriangleApp::key_callback);
 }
 
+/*
+Startup runs as a task graph: loading the model and the texture need no device and start right away, next to
+instance and device creation, and only the steps that upload them wait for both sides. Steps recording into _uploads
+are chained through "assets", the only one of them.
+*/
 void HelloTriangleApp::initVulkan() {
-  createInstance();
-  setupDebugMessenger();
-  createSurface();
-  pickPhysicalDevice();
-  createLogicalDevice();
-  createSwapChain();
-  createImageViews();
-  createRenderPass();
-  createDescriptorSetLayout();
-  createGraphicsPipeline();
-  createCommandPool();
-  createColorResources();
-  createDepthResources();
-  createFramebuffers();
-  createTextureImage();
-  createTextureImageView();
-  createTextureSampler();
-  loadModel();
-  createVertexBuffer();
-  createIndexBuffer();
-  createUniformBuffers();
-  createDescriptorPool();
-  createDescriptorSets();
-  createCommandBuffers();
-  createSyncObjects();
+  // GLFW only answers on the main thread, the swap chain is created on a worker
+  if (_headless) {
+    _framebufferSize = {static_cast<uint32_t>(_windowGeometry.size.x), static_cast<uint32_t>(_windowGeometry.size.y)};
+  } else {
+    int width, height;
+    glfwGetFramebufferSize(_window, &width, &height);
+    _framebufferSize = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+  }
+
+  using TaskId = TaskGraph::TaskId;
+  TaskGraph graph;
+
+  TaskId model = graph.add("load model", {}, [this] {
+    loadModel();
+
+    // packed positions are dequantized by the model matrix, which frames need before the vertices arrive
+    if (_usePackedVertices) {
+      _vertexQuantization = computeQuantization(_vertexData, _vertexCount);
+    }
+  });
+  TaskId texture = graph.add("load texture", {}, [this] { loadTexture(); });
+
+  TaskId instance = graph.add("instance", {}, [this] {
+    createInstance();
+    setupDebugMessenger();
+    if (!_headless) {
+      createSurface();
+    }
+  });
+  TaskId device = graph.add("device", {instance}, [this] {
+    pickPhysicalDevice();
+    createLogicalDevice();
+    _allocator.init(_physicalDevice, _device);
+
+    _pipelineCache.init(_physicalDevice, _device, PIPELINE_CACHE_PATH);
+
+    _mainPass = _gpuProfiler.addPass("main");
+    _gpuProfiler.init(_physicalDevice, _device, _queueFamilies.graphicsFamily.value(), MAX_FRAMES_IN_FLIGHT);
+  });
+  TaskId swapChain = graph.add("swap chain", {device}, [this] {
+    createSwapChain();
+    createImageViews();
+  });
+  TaskId renderPass = graph.add("render pass", {swapChain}, [this] { createRenderPass(); });
+  TaskId layout     = graph.add("descriptor set layout", {device}, [this] { createDescriptorSetLayout(); });
+  TaskId pipeline   = graph.add("pipeline", {renderPass, layout}, [this] { createGraphicsPipeline(); });
+  TaskId attachments = graph.add("attachments", {renderPass}, [this] {
+    createColorResources();
+    createDepthResources();
+    createFramebuffers();
+  });
+  TaskId commandPools = graph.add("command pools", {device}, [this] {
+    createCommandPools();
+    _commandRecorder.init(_device, _queueFamilies.graphicsFamily.value(), MAX_FRAMES_IN_FLIGHT);
+    _uploads.init(_device, _graphicsQueue, _queueFamilies.graphicsFamily.value(), _allocator);
+  });
+  TaskId sampler  = graph.add("sampler", {device}, [this] { createTextureSampler(); });
+  TaskId uniforms = graph.add("uniform buffers", {device}, [this] { createUniformBuffers(); });
+  TaskId objects  = graph.add("object buffers", {device, model}, [this] { createObjectBuffers(); });
+  TaskId indirect = graph.add("indirect buffers", {swapChain, model}, [this] { createIndirectBuffers(); });
+  TaskId sync     = graph.add("sync objects", {swapChain}, [this] { createSyncObjects(); });
+
+  TaskId assets = graph.add("assets", {commandPools, model, texture}, [this] {
+    if (_streamAssets) {
+      createPlaceholderTexture();
+      startAssetStream();
+    } else {
+      createTextureImage(_uploads);
+      createTextureImageView();
+      createVertexBuffer(_uploads);
+      createIndexBuffer(_uploads);
+      _acquiredAssets = STREAMED_MODEL | STREAMED_TEXTURE;
+    }
+  });
+  TaskId descriptors = graph.add("descriptor sets", {layout, uniforms, objects, sampler, assets}, [this] {
+    createDescriptorPool();
+    createDescriptorSets();
+  });
+  TaskId commandBuffers = graph.add("command buffers", {pipeline, attachments, indirect, descriptors, sync},
+                                    [this] {
+                                      createCommandBuffers();
+
+                                      // everything was recorded into upload batches, the first frame is ordered
+                                      // after them on the queue
+                                      _uploads.submit();
+                                    });
+
+  graph.start();
+  graph.finish();
+  printStartupReport(graph, commandBuffers);
+
+  if (!_streamAssets) {
+    printUploadStats();
+  }
+}
+
+// the tasks that decided when the first frame could be recorded, next to the time everything would take in sequence
+void HelloTriangleApp::printStartupReport(const TaskGraph& graph, TaskGraph::TaskId last) {
+  float sequential = 0.0f;
+  for (TaskGraph::TaskId task = 0; task < graph.taskCount(); task++) {
+    sequential += graph.timing(task).duration;
+  }
+
+  TaskGraph::TaskTiming lastTiming = graph.timing(last);
+  std::cout << "Startup: " << lastTiming.start + lastTiming.duration << " ms for " << graph.taskCount()
+            << " tasks on " << graph.threadCount() << " threads, " << sequential << " ms in sequence" << std::endl;
+  std::cout << "\tcritical path:" << std::endl;
+  for (TaskGraph::TaskId task : graph.criticalPath(last)) {
+    TaskGraph::TaskTiming timing = graph.timing(task);
+    std::cout << "\t\t" << timing.name << ": " << timing.start << " ms + " << timing.duration << " ms" << std::endl;
+  }
+}
+
+void HelloTriangleApp::printUploadStats() {
+  std::cout << "Uploads: " << _uploads.stagedBytes() / 1024 << " KB staged in " << _uploads.batchCount()
+            << " batches, " << _uploads.fenceWaitCount() << " fence waits, no queue idle waits" << std::endl;
+  if (_streamAssets) {
+    std::cout << "Streamed: " << _streamUploads.stagedBytes() / 1024 << " KB staged in "
+              << _streamUploads.batchCount() << " batches on the transfer queue, " << _streamUploads.fenceWaitCount()
+              << " fence waits" << std::endl;
+  }
+
+  std::cout << "Device memory: " << _allocator.deviceAllocationCount() << " vkAllocateMemory calls" << std::endl;
+  printHeapStats(_allocator.heapStats());
 }
 
 void HelloTriangleApp::populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo) {
@@ -118,6 +328,8 @@ void HelloTriangleApp::populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCre
 }
 
 void HelloTriangleApp::setupDebugMessenger() {
+  PROFILE_FUNCTION();
+
   if (!_enableValidationLayers) return;
 
   VkDebugUtilsMessengerCreateInfoEXT createInfo;
@@ -154,12 +366,14 @@ bool HelloTriangleApp::checkValidationLayerSupport() {
 }
 
 std::vector<const char*> HelloTriangleApp::getRequiredExtensions() {
-  uint32_t     glfwExtensionCount = 0;
-  const char** glfwExtensions;
-
-  glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+  std::vector<const char*> extensions;
 
-  std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  // offscreen rendering needs neither VK_KHR_surface nor GLFW
+  if (!_headless) {
+    uint32_t     glfwExtensionCount = 0;
+    const char** glfwExtensions     = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  }
 
   if (_enableValidationLayers) {
     extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -169,6 +383,8 @@ std::vector<const char*> HelloTriangleApp::getRequiredExtensions() {
 }
 
 void HelloTriangleApp::createInstance() {
+  PROFILE_FUNCTION();
+
   if (_enableValidationLayers && !checkValidationLayerSupport()) {
     throw std::runtime_error("validation layers requested, but not available!");
   }
@@ -221,43 +437,141 @@ void HelloTriangleApp::createInstance() {
 }
 
 void HelloTriangleApp::createSurface() {
+  PROFILE_FUNCTION();
+
   if (glfwCreateWindowSurface(_instance, _window, nullptr, &_surface) != VK_SUCCESS) {
     throw std::runtime_error("failed to create window surface!");
   }
 }
 
 void HelloTriangleApp::mainLoop() {
-  while (!glfwWindowShouldClose(_window)) {
-    glfwPollEvents();
+  // console output and the CSV are written by the reporter thread, the loop only stores frame times
+  _frameStats.start(_frameStatsCsvPath);
+
+  // headless runs keep every frame time for the report at the end
+  std::vector<float> frameTimes;
+  frameTimes.reserve(_headlessFrames);
+
+  auto lastFrameEnd = std::chrono::high_resolution_clock::now();
+  while (_headless ? frameTimes.size() < _headlessFrames : !glfwWindowShouldClose(_window)) {
+    PROFILE_ZONE("frame");
+    if (!_headless) {
+      PROFILE_ZONE("poll events");
+      glfwPollEvents();
+    }
 
-    auto startTime = std::chrono::high_resolution_clock::now();
+    acquireStreamedAssets();
     drawFrame();
 
-    auto  currentTime   = std::chrono::high_resolution_clock::now();
-    float frameDuration = std::chrono::duration<float, std::chrono::milliseconds::period>(currentTime - startTime).count();
-    float fps           = static_cast<float>(1000) / frameDuration;
-    std::cout << "Frame duration: " << frameDuration << " ms (" << fps << " FPS)" << std::endl;
+    // from the end of one frame to the end of the next, event handling and vsync waits included
+    auto  frameEnd = std::chrono::high_resolution_clock::now();
+    float frameDuration =
+        std::chrono::duration<float, std::chrono::milliseconds::period>(frameEnd - lastFrameEnd).count();
+    lastFrameEnd = frameEnd;
+    _frameStats.record(frameDuration, _resizeMs);
+    _resizeMs = 0.0f;
+    if (_headless) {
+      frameTimes.push_back(frameDuration);
+    }
+
+    FrameSummary summary;
+    if (!_headless && _showFrameStats && _frameStats.takeSummary(summary)) {
+      std::ostringstream title;
+      title << WINDOW_TITLE << " - " << summary.frameCount << " FPS, " << summary.p50Ms << " ms p50, " << summary.p99Ms
+            << " ms p99, " << summary.hitchCount << " hitches";
+      glfwSetWindowTitle(_window, title.str().c_str());
+    }
+
+    // the CPU frame time includes waiting for vsync, the GPU pass times do not
+    if (++_gpuReportFrame == GpuProfiler::WINDOW_SIZE) {
+      _gpuReportFrame = 0;
+      std::ostringstream text;
+      for (uint32_t pass = 0; pass < _gpuProfiler.passCount(); pass++) {
+        printGpuPassStats(text, _gpuProfiler.passStats(pass));
+      }
+      text << "Recording: " << _recordMsTotal / GpuProfiler::WINDOW_SIZE << " ms avg, " << _recordMsMax
+           << " ms max per frame\n";
+      _recordMsTotal = 0.0f;
+      _recordMsMax   = 0.0f;
+      _frameStats.print(text.str());
+    }
+  }
+  _frameStats.stop();
+
+  // the stream thread submits to the transfer queue until it is done, the device can only go idle after it
+  if (_streamThread.joinable()) {
+    _streamThread.join();
+    if (_streamError) {
+      std::rethrow_exception(_streamError);
+    }
   }
 
   vkDeviceWaitIdle(_device);
+
+  if (_headless) {
+    printHeadlessReport(frameTimes);
+  }
+}
+
+void HelloTriangleApp::printHeadlessReport(const std::vector<float>& frameTimes) {
+  float total = 0.0f;
+  for (float frameTime : frameTimes) {
+    total += frameTime;
+  }
+  FrameSummary summary = summarizeFrames(frameTimes);
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(_physicalDevice, &properties);
+
+  std::cout << "Headless: " << summary.frameCount << " frames at " << _swapChainExtent.width << "x"
+            << _swapChainExtent.height << " on " << properties.deviceName << " in " << total << " ms, "
+            << (summary.frameCount > 0 ? total / summary.frameCount : 0.0f) << " ms avg, " << summary.p50Ms
+            << " ms p50, " << summary.p95Ms << " ms p95, " << summary.p99Ms << " ms p99, " << summary.maxMs
+            << " ms max, " << summary.hitchCount << " hitches" << std::endl;
+  for (uint32_t pass = 0; pass < _gpuProfiler.passCount(); pass++) {
+    printGpuPassStats(std::cout, _gpuProfiler.passStats(pass));
+  }
 }
 
 void HelloTriangleApp::cleanup() {
-  cleanupSwapChain();
+  retireSwapChain();
+  destroyRetiredSwapChains(true);
+
+  vkDestroyPipeline(_device, _graphicsPipeline, nullptr);
+  vkDestroyPipelineLayout(_device, _pipelineLayout, nullptr);
+  vkDestroyRenderPass(_device, _renderPass, nullptr);
+
+  for (size_t i = 0; i < _indirectBuffers.size(); i++) {
+    vkDestroyBuffer(_device, _indirectBuffers[i], nullptr);
+    _allocator.free(_indirectBuffersMemory[i]);
+  }
 
   vkDestroySampler(_device, _textureSampler, nullptr);
   vkDestroyImageView(_device, _textureImageView, nullptr);
 
+  if (_placeholderImageView != VK_NULL_HANDLE) {
+    vkDestroyImageView(_device, _placeholderImageView, nullptr);
+    vkDestroyImage(_device, _placeholderImage, nullptr);
+    _allocator.free(_placeholderImageMemory);
+  }
+
   vkDestroyImage(_device, _textureImage, nullptr);
-  vkFreeMemory(_device, _textureImageMemory, nullptr);
+  _allocator.free(_textureImageMemory);
 
+  vkDestroyDescriptorPool(_device, _descriptorPool, nullptr);
   vkDestroyDescriptorSetLayout(_device, _descriptorSetLayout, nullptr);
 
+  vkDestroyBuffer(_device, _uniformRing, nullptr);
+  _allocator.free(_uniformRingMemory);
+
+  vkDestroyBuffer(_device, _objectRing, nullptr);
+  _allocator.free(_objectRingMemory);
+
   vkDestroyBuffer(_device, _indexBuffer, nullptr);
-  vkFreeMemory(_device, _indexBufferMemory, nullptr);
+  _allocator.free(_indexBufferMemory);
 
   vkDestroyBuffer(_device, _vertexBuffer, nullptr);
-  vkFreeMemory(_device, _vertexBufferMemory, nullptr);
+  _allocator.free(_vertexBufferMemory);
 
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
     vkDestroySemaphore(_device, _renderFinishedSemaphores[i], nullptr);
@@ -265,19 +579,44 @@ void HelloTriangleApp::cleanup() {
     vkDestroyFence(_device, _inFlightFences[i], nullptr);
   }
 
-  vkDestroyCommandPool(_device, _commandPool, nullptr);
+  for (VkCommandPool commandPool : _commandPools) {
+    vkDestroyCommandPool(_device, commandPool, nullptr);
+  }
+  _commandRecorder.destroy();
+
+  if (_streamAssets) {
+    // closed before everything was acquired, the stream uploads are still around
+    if (_acquiredAssets != (STREAMED_MODEL | STREAMED_TEXTURE)) {
+      _streamUploads.destroy();
+    }
+    for (VkSemaphore semaphore : _streamSemaphores) {
+      vkDestroySemaphore(_device, semaphore, nullptr);
+    }
+  }
 
+  if (!_pipelineCache.save()) {
+    std::cerr << "failed to write pipeline cache " << PIPELINE_CACHE_PATH << std::endl;
+  }
+  _pipelineCache.destroy();
+
+  _uploads.destroy();
+  _gpuProfiler.destroy();
+  _allocator.destroy();
   vkDestroyDevice(_device, nullptr);
 
   if (_enableValidationLayers) {
     DestroyDebugUtilsMessengerEXT(_instance, _debugMessenger, nullptr);
   }
 
-  vkDestroySurfaceKHR(_instance, _surface, nullptr);
+  if (!_headless) {
+    vkDestroySurfaceKHR(_instance, _surface, nullptr);
+  }
   vkDestroyInstance(_instance, nullptr);
 
-  glfwDestroyWindow(_window);
-  glfwTerminate();
+  if (!_headless) {
+    glfwDestroyWindow(_window);
+    glfwTerminate();
+  }
 }
 
 VKAPI_ATTR VkBool32 VKAPI_CALL HelloTriangleApp::debugCallback(
@@ -305,6 +644,8 @@ VKAPI_ATTR VkBool32 VKAPI_CALL HelloTriangleApp::debugCallback(
 }
 
 void HelloTriangleApp::pickPhysicalDevice() {
+  PROFILE_FUNCTION();
+
   uint32_t deviceCount = 0;
   vkEnumeratePhysicalDevices(_instance, &deviceCount, nullptr);
 
@@ -328,6 +669,11 @@ void HelloTriangleApp::pickPhysicalDevice() {
   }
 }
 
+// the swap chain extension is only needed to present
+std::vector<const char*> HelloTriangleApp::requiredDeviceExtensions() const {
+  return _headless ? std::vector<const char*>() : _deviceExtensions;
+}
+
 bool HelloTriangleApp::checkDeviceExtensionSupport(VkPhysicalDevice device) {
   uint32_t extensionCount;
   vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
@@ -335,7 +681,8 @@ bool HelloTriangleApp::checkDeviceExtensionSupport(VkPhysicalDevice device) {
   std::vector<VkExtensionProperties> availableExtensions(extensionCount);
   vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-  std::set<std::string> requiredExtensions(_deviceExtensions.begin(), _deviceExtensions.end());
+  std::vector<const char*> deviceExtensions = requiredDeviceExtensions();
+  std::set<std::string>    requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
 
   std::cout << "available device extensions:" << std::endl;
   for (const auto& extension : availableExtensions) {
@@ -362,8 +709,8 @@ bool HelloTriangleApp::isDeviceSuitable(VkPhysicalDevice device) {
 
   bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-  bool swapChainAdequate = false;
-  if (extensionsSupported) {
+  bool swapChainAdequate = _headless;
+  if (extensionsSupported && !_headless) {
     SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
     swapChainAdequate                        = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
   }
@@ -385,19 +732,32 @@ QueueFamilyIndices HelloTriangleApp::findQueueFamilies(VkPhysicalDevice device)
 
   int i = 0;
   for (const auto& queueFamily : queueFamilies) {
-    if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-      indices.graphicsFamily = i;
-    }
+    if (!indices.isComplete()) {
+      if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        indices.graphicsFamily = i;
+      }
 
-    VkBool32 presentSupport = false;
-    vkGetPhysicalDeviceSurfaceSupportKHR(device, i, _surface, &presentSupport);
+      // without a surface nothing is presented, the graphics queue stands in for the present queue
+      VkBool32 presentSupport = false;
+      if (_headless) {
+        presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+      } else {
+        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, _surface, &presentSupport);
+      }
 
-    if (presentSupport) {
-      indices.presentFamily = i;
+      if (presentSupport) {
+        indices.presentFamily = i;
+      }
+    }
+
+    // a family that can only transfer is a copy engine running next to the graphics queue
+    if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+        !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+      indices.transferFamily = i;
     }
 
     // early exit
-    if (indices.isComplete()) {
+    if (indices.isComplete() && indices.transferFamily.has_value()) {
       break;
     }
 
@@ -408,11 +768,20 @@ QueueFamilyIndices HelloTriangleApp::findQueueFamilies(VkPhysicalDevice device)
 }
 
 void HelloTriangleApp::createLogicalDevice() {
+  PROFILE_FUNCTION();
+
   QueueFamilyIndices indices = findQueueFamilies(_physicalDevice);
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
   std::set<uint32_t>                   uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
 
+  // assets only stream in the background when there is a queue of their own to upload them on
+  _queueFamilies = indices;
+  _streamAssets  = _streamAssets && indices.transferFamily.has_value();
+  if (_streamAssets) {
+    uniqueQueueFamilies.insert(indices.transferFamily.value());
+  }
+
   float queuePriority = 1.0f;
 
   for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -424,17 +793,47 @@ void HelloTriangleApp::createLogicalDevice() {
     queueCreateInfos.push_back(queueCreateInfo);
   }
 
-  VkPhysicalDeviceFeatures deviceFeatures = {};
-  deviceFeatures.samplerAnisotropy        = VK_TRUE;
-  deviceFeatures.sampleRateShading        = VK_TRUE;  // enable sample shading feature for the device
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(_physicalDevice, &supportedFeatures);
+
+  VkPhysicalDeviceFeatures deviceFeatures  = {};
+  deviceFeatures.samplerAnisotropy         = VK_TRUE;
+  deviceFeatures.sampleRateShading         = supportedFeatures.sampleRateShading;  // missing on some software ICDs
+  deviceFeatures.multiDrawIndirect         = supportedFeatures.multiDrawIndirect;  // one indirect draw per meshlet run
+  deviceFeatures.textureCompressionBC      = supportedFeatures.textureCompressionBC;  // BC1/BC7 texture cache
+  deviceFeatures.pipelineStatisticsQuery   = supportedFeatures.pipelineStatisticsQuery;  // GpuProfiler invocations
+  deviceFeatures.inheritedQueries          = supportedFeatures.inheritedQueries;  // secondaries inside a measured pass
+  deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;  // object of a draw command
+
+  if (_objectCount > 1 && !(supportedFeatures.multiDrawIndirect && supportedFeatures.drawIndirectFirstInstance)) {
+    std::cout << "drawing a single object, the device can not pick objects by indirect draw" << std::endl;
+    _objectCount = 1;
+  }
 
   VkDeviceCreateInfo createInfo      = {};
   createInfo.sType                   = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
   createInfo.queueCreateInfoCount    = static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pQueueCreateInfos       = queueCreateInfos.data();
   createInfo.pEnabledFeatures        = &deviceFeatures;
-  createInfo.enabledExtensionCount   = static_cast<uint32_t>(_deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = _deviceExtensions.data();
+  std::vector<const char*> deviceExtensions = requiredDeviceExtensions();
+
+  // optional, without it every command of the indirect buffer is drawn and the unused ones are zeroed
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(_physicalDevice, nullptr, &extensionCount, nullptr);
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(_physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+  bool drawIndirectCount = false;
+  for (const auto& extension : availableExtensions) {
+    drawIndirectCount = drawIndirectCount ||
+                        strcmp(extension.extensionName, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0;
+  }
+  if (drawIndirectCount) {
+    deviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+  }
+
+  createInfo.enabledExtensionCount   = static_cast<uint32_t>(deviceExtensions.size());
+  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
   // this is for backward compatibility
   /*
@@ -453,8 +852,16 @@ void HelloTriangleApp::createLogicalDevice() {
     throw std::runtime_error("failed to create logical device!");
   }
 
+  if (drawIndirectCount) {
+    _cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+        vkGetDeviceProcAddr(_device, "vkCmdDrawIndexedIndirectCountKHR"));
+  }
+
   vkGetDeviceQueue(_device, indices.graphicsFamily.value(), 0, &_graphicsQueue);
   vkGetDeviceQueue(_device, indices.presentFamily.value(), 0, &_presentQueue);
+  if (_streamAssets) {
+    vkGetDeviceQueue(_device, indices.transferFamily.value(), 0, &_transferQueue);
+  }
 }
 
 SwapChainSupportDetails HelloTriangleApp::querySwapChainSupport(VkPhysicalDevice device) {
@@ -512,12 +919,7 @@ VkExtent2D HelloTriangleApp::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& ca
   if (capabilities.currentExtent.width != UINT32_MAX) {
     return capabilities.currentExtent;
   } else {
-    int width, height;
-    glfwGetFramebufferSize(_window, &width, &height);
-
-    VkExtent2D actualExtent = {
-        static_cast<uint32_t>(width),
-        static_cast<uint32_t>(height)};
+    VkExtent2D actualExtent = _framebufferSize;
 
     actualExtent.width =
         std::max(capabilities.minImageExtent.width, std::min(capabilities.maxImageExtent.width, actualExtent.width));
@@ -528,65 +930,121 @@ VkExtent2D HelloTriangleApp::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& ca
   }
 }
 
+/*
+Only what depends on the extent is replaced: the swap chain, its views and framebuffers and the attachments; command
+buffers are recorded every frame anyway. Viewport and scissor are dynamic state, so the pipeline is kept unless the
+surface format changed, and descriptors and uniforms never see the swap chain. The old swap chain is handed to the new
+one as oldSwapchain and retired rather than destroyed, nothing waits for the device here.
+*/
 void HelloTriangleApp::recreateSwapChain() {
+  PROFILE_FUNCTION();
+
   int width = 0, height = 0;
   glfwGetFramebufferSize(_window, &width, &height);
   while (width == 0 || height == 0) {
     glfwGetFramebufferSize(_window, &width, &height);
     glfwWaitEvents();
   }
+  _framebufferSize = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
 
-  vkDeviceWaitIdle(_device);
-
-  cleanupSwapChain();
+  auto startTime = std::chrono::high_resolution_clock::now();
 
-  createSwapChain();
+  retireSwapChain();
+  createSwapChain(_retiredSwapChains.back().swapChain);
   createImageViews();
-  createRenderPass();
-  createGraphicsPipeline();
+
+  if (_swapChainImageFormat != _renderPassFormat || _msaaSamples != _renderPassSamples) {
+    _retiredSwapChains.back().renderPass = _renderPass;
+    _retiredSwapChains.back().pipeline   = _graphicsPipeline;
+    createRenderPass();
+    createGraphicsPipeline();
+  }
+
   createColorResources();
   createDepthResources();
   createFramebuffers();
-  createUniformBuffers();
-  createDescriptorPool();
-  createDescriptorSets();
-  createCommandBuffers();
-}
+  createIndirectBuffers();
 
-void HelloTriangleApp::cleanupSwapChain() {
-  vkDestroyImageView(_device, _colorImageView, nullptr);
-  vkDestroyImage(_device, _colorImage, nullptr);
-  vkFreeMemory(_device, _colorImageMemory, nullptr);
+  // frames still in flight keep the fences of the images they used, new images start out unused
+  _imagesInFlight.resize(_swapChainImages.size(), VK_NULL_HANDLE);
 
-  vkDestroyImageView(_device, _depthImageView, nullptr);
-  vkDestroyImage(_device, _depthImage, nullptr);
-  vkFreeMemory(_device, _depthImageMemory, nullptr);
+  auto currentTime = std::chrono::high_resolution_clock::now();
+  _resizeMs += std::chrono::duration<float, std::chrono::milliseconds::period>(currentTime - startTime).count();
+}
 
-  for (auto framebuffer : _swapChainFramebuffers) {
-    vkDestroyFramebuffer(_device, framebuffer, nullptr);
-  }
+void HelloTriangleApp::retireSwapChain() {
+  RetiredSwapChain retired;
+  retired.submittedFrames = _submittedFrames;
+  if (_headless) {
+    retired.offscreenImages.swap(_swapChainImages);
+    retired.offscreenImagesMemory.swap(_offscreenImagesMemory);
+  } else {
+    retired.swapChain = _swapChain;
+    _swapChainImages.clear();
+  }
+  retired.imageViews.swap(_swapChainImageViews);
+  retired.framebuffers.swap(_swapChainFramebuffers);
+  retired.colorImage       = _colorImage;
+  retired.colorImageMemory = _colorImageMemory;
+  retired.colorImageView   = _colorImageView;
+  retired.depthImage       = _depthImage;
+  retired.depthImageMemory = _depthImageMemory;
+  retired.depthImageView   = _depthImageView;
+
+  _retiredSwapChains.push_back(std::move(retired));
+}
+
+// all = false destroys only what no frame in flight can still use, called after waiting for the current frame's fence
+void HelloTriangleApp::destroyRetiredSwapChains(bool all) {
+  auto finished = [&](const RetiredSwapChain& retired) {
+    return all || retired.submittedFrames + MAX_FRAMES_IN_FLIGHT <= _submittedFrames;
+  };
+
+  for (RetiredSwapChain& retired : _retiredSwapChains) {
+    if (!finished(retired)) {
+      continue;
+    }
 
-  vkFreeCommandBuffers(_device, _commandPool, static_cast<uint32_t>(_commandBuffers.size()), _commandBuffers.data());
+    vkDestroyImageView(_device, retired.colorImageView, nullptr);
+    vkDestroyImage(_device, retired.colorImage, nullptr);
+    _allocator.free(retired.colorImageMemory);
 
-  vkDestroyPipeline(_device, _graphicsPipeline, nullptr);
-  vkDestroyPipelineLayout(_device, _pipelineLayout, nullptr);
-  vkDestroyRenderPass(_device, _renderPass, nullptr);
+    vkDestroyImageView(_device, retired.depthImageView, nullptr);
+    vkDestroyImage(_device, retired.depthImage, nullptr);
+    _allocator.free(retired.depthImageMemory);
 
-  for (auto imageView : _swapChainImageViews) {
-    vkDestroyImageView(_device, imageView, nullptr);
-  }
+    for (auto framebuffer : retired.framebuffers) {
+      vkDestroyFramebuffer(_device, framebuffer, nullptr);
+    }
+
+    if (retired.pipeline != VK_NULL_HANDLE) {
+      vkDestroyPipeline(_device, retired.pipeline, nullptr);
+      vkDestroyRenderPass(_device, retired.renderPass, nullptr);
+    }
 
-  vkDestroySwapchainKHR(_device, _swapChain, nullptr);
+    for (auto imageView : retired.imageViews) {
+      vkDestroyImageView(_device, imageView, nullptr);
+    }
 
-  for (size_t i = 0; i < _swapChainImages.size(); i++) {
-    vkDestroyBuffer(_device, _uniformBuffers[i], nullptr);
-    vkFreeMemory(_device, _uniformBuffersMemory[i], nullptr);
+    for (size_t i = 0; i < retired.offscreenImages.size(); i++) {
+      vkDestroyImage(_device, retired.offscreenImages[i], nullptr);
+      _allocator.free(retired.offscreenImagesMemory[i]);
+    }
+    vkDestroySwapchainKHR(_device, retired.swapChain, nullptr);
   }
 
-  vkDestroyDescriptorPool(_device, _descriptorPool, nullptr);
+  _retiredSwapChains.erase(std::remove_if(_retiredSwapChains.begin(), _retiredSwapChains.end(), finished),
+                           _retiredSwapChains.end());
 }
 
-void HelloTriangleApp::createSwapChain() {
+void HelloTriangleApp::createSwapChain(VkSwapchainKHR oldSwapChain) {
+  PROFILE_FUNCTION();
+
+  if (_headless) {
+    createOffscreenTargets();
+    return;
+  }
+
   SwapChainSupportDetails swapChainSupport = querySwapChainSupport(_physicalDevice);
 
   VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
@@ -626,7 +1084,7 @@ void HelloTriangleApp::createSwapChain() {
   createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
   createInfo.presentMode    = presentMode;
   createInfo.clipped        = VK_TRUE;
-  createInfo.oldSwapchain   = VK_NULL_HANDLE;
+  createInfo.oldSwapchain   = oldSwapChain;  // lets the presentation engine hand its resources over
 
   if (vkCreateSwapchainKHR(_device, &createInfo, nullptr, &_swapChain) != VK_SUCCESS) {
     throw std::runtime_error("failed to create swap chain!");
@@ -640,7 +1098,25 @@ void HelloTriangleApp::createSwapChain() {
   _swapChainExtent      = extent;
 }
 
+// stands in for the swap chain images, the same format and count a window would typically get
+void HelloTriangleApp::createOffscreenTargets() {
+  const uint32_t imageCount = 3;
+
+  _swapChainImageFormat = VK_FORMAT_B8G8R8A8_UNORM;
+  _swapChainExtent      = _framebufferSize;
+  _swapChainImages.resize(imageCount);
+  _offscreenImagesMemory.resize(imageCount);
+
+  for (uint32_t i = 0; i < imageCount; i++) {
+    createImage(_swapChainExtent.width, _swapChainExtent.height, 1, VK_SAMPLE_COUNT_1_BIT, _swapChainImageFormat,
+                VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _swapChainImages[i], _offscreenImagesMemory[i]);
+  }
+}
+
 void HelloTriangleApp::createImageViews() {
+  PROFILE_FUNCTION();
+
   _swapChainImageViews.resize(_swapChainImages.size());
 
   for (size_t i = 0; i < _swapChainImages.size(); i++) {
@@ -649,6 +1125,8 @@ void HelloTriangleApp::createImageViews() {
 }
 
 void HelloTriangleApp::createRenderPass() {
+  PROFILE_FUNCTION();
+
   VkAttachmentDescription colorAttachment = {};
   colorAttachment.format                  = _swapChainImageFormat;
   colorAttachment.samples                 = _msaaSamples;
@@ -677,7 +1155,9 @@ void HelloTriangleApp::createRenderPass() {
   colorAttachmentResolve.stencilLoadOp           = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   colorAttachmentResolve.stencilStoreOp          = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   colorAttachmentResolve.initialLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
-  colorAttachmentResolve.finalLayout             = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  // offscreen targets are left ready to be copied out
+  colorAttachmentResolve.finalLayout =
+      _headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
   VkAttachmentReference colorAttachmentRef = {};
   colorAttachmentRef.attachment            = 0;
@@ -719,12 +1199,21 @@ void HelloTriangleApp::createRenderPass() {
   if (vkCreateRenderPass(_device, &renderPassInfo, nullptr, &_renderPass) != VK_SUCCESS) {
     throw std::runtime_error("failed to create render pass!");
   }
+  _renderPassFormat  = _swapChainImageFormat;
+  _renderPassSamples = _msaaSamples;
 }
 
 void HelloTriangleApp::createGraphicsPipeline() {
-  auto vertShaderCode = readFile("shaders/basic.vert.spv");
+  PROFILE_FUNCTION();
+
+  auto vertShaderCode = readFile(_usePackedVertices ? "shaders/basic_packed.vert.spv" : "shaders/basic.vert.spv");
   auto fragShaderCode = readFile("shaders/basic.frag.spv");
 
+  // the model matrices are read from binding 2, a vertex shader compiled before that reads the old uniform layout
+  if (!spirvUsesBinding(vertShaderCode, 2)) {
+    throw std::runtime_error("failed to find the object buffer in the vertex shader, run shaders/compile.bat!");
+  }
+
   VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
   VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
 
@@ -742,8 +1231,17 @@ void HelloTriangleApp::createGraphicsPipeline() {
 
   VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
 
-  auto bindingDescription    = Vertex::getBindingDescription();
-  auto attributeDescriptions = Vertex::getAttributeDescriptions();
+  VkVertexInputBindingDescription                bindingDescription;
+  std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+  if (_usePackedVertices) {
+    auto packedAttributes = PackedVertex::getAttributeDescriptions();
+    bindingDescription    = PackedVertex::getBindingDescription();
+    attributeDescriptions.assign(packedAttributes.begin(), packedAttributes.end());
+  } else {
+    auto attributes    = Vertex::getAttributeDescriptions();
+    bindingDescription = Vertex::getBindingDescription();
+    attributeDescriptions.assign(attributes.begin(), attributes.end());
+  }
 
   VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
   vertexInputInfo.sType                                = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -757,24 +1255,17 @@ void HelloTriangleApp::createGraphicsPipeline() {
   inputAssembly.topology                               = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
   inputAssembly.primitiveRestartEnable                 = VK_FALSE;
 
-  VkViewport viewport = {};
-  viewport.x          = 0.0f;
-  viewport.y          = 0.0f;
-  viewport.width      = (float)_swapChainExtent.width;
-  viewport.height     = (float)_swapChainExtent.height;
-  viewport.minDepth   = 0.0f;
-  viewport.maxDepth   = 1.0f;
-
-  VkRect2D scissor = {};
-  scissor.offset   = {0, 0};
-  scissor.extent   = _swapChainExtent;
-
+  // set by the command buffers, so the pipeline outlives swap chain recreations
   VkPipelineViewportStateCreateInfo viewportState = {};
   viewportState.sType                             = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
   viewportState.viewportCount                     = 1;
-  viewportState.pViewports                        = &viewport;
   viewportState.scissorCount                      = 1;
-  viewportState.pScissors                         = &scissor;
+
+  std::array<VkDynamicState, 2>    dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+  VkPipelineDynamicStateCreateInfo dynamicState  = {};
+  dynamicState.sType                             = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicState.dynamicStateCount                 = static_cast<uint32_t>(dynamicStates.size());
+  dynamicState.pDynamicStates                    = dynamicStates.data();
 
   VkPipelineRasterizationStateCreateInfo rasterizer = {};
   rasterizer.sType                                  = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -789,10 +1280,13 @@ void HelloTriangleApp::createGraphicsPipeline() {
   rasterizer.depthBiasClamp                         = 0.0f;  // Optional
   rasterizer.depthBiasSlopeFactor                   = 0.0f;  // Optional
 
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(_physicalDevice, &supportedFeatures);
+
   VkPipelineMultisampleStateCreateInfo multisampling = {};
   multisampling.sType                                = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-  multisampling.sampleShadingEnable                  = VK_TRUE;  // enable sample shading in the pipeline
-  multisampling.minSampleShading                     = .2f;      // min fraction for sample shading; closer to one is smoother
+  multisampling.sampleShadingEnable                  = supportedFeatures.sampleRateShading;  // enabled when supported
+  multisampling.minSampleShading                     = .2f;  // min fraction for sample shading; closer to one is smoother
   multisampling.rasterizationSamples                 = _msaaSamples;
 
   VkPipelineDepthStencilStateCreateInfo depthStencil = {};
@@ -823,15 +1317,6 @@ void HelloTriangleApp::createGraphicsPipeline() {
   colorBlending.blendConstants[2]                   = 0.0f;
   colorBlending.blendConstants[3]                   = 0.0f;
 
-  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-  pipelineLayoutInfo.sType                      = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipelineLayoutInfo.setLayoutCount             = 1;
-  pipelineLayoutInfo.pSetLayouts                = &_descriptorSetLayout;
-
-  if (vkCreatePipelineLayout(_device, &pipelineLayoutInfo, nullptr, &_pipelineLayout) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create pipeline layout!");
-  }
-
   VkGraphicsPipelineCreateInfo pipelineInfo = {};
   pipelineInfo.sType                        = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
   pipelineInfo.stageCount                   = 2;
@@ -842,21 +1327,33 @@ void HelloTriangleApp::createGraphicsPipeline() {
   pipelineInfo.pRasterizationState          = &rasterizer;
   pipelineInfo.pMultisampleState            = &multisampling;
   pipelineInfo.pColorBlendState             = &colorBlending;
+  pipelineInfo.pDynamicState                = &dynamicState;
   pipelineInfo.layout                       = _pipelineLayout;
   pipelineInfo.renderPass                   = _renderPass;
   pipelineInfo.subpass                      = 0;
   pipelineInfo.basePipelineHandle           = VK_NULL_HANDLE;
   pipelineInfo.pDepthStencilState           = &depthStencil;
 
-  if (vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &_graphicsPipeline) != VK_SUCCESS) {
+  auto startTime = std::chrono::high_resolution_clock::now();
+  if (vkCreateGraphicsPipelines(_device, _pipelineCache.handle(), 1, &pipelineInfo, nullptr, &_graphicsPipeline) !=
+      VK_SUCCESS) {
     throw std::runtime_error("failed to create graphics pipeline!");
   }
+  auto  currentTime = std::chrono::high_resolution_clock::now();
+  float pipelineDuration =
+      std::chrono::duration<float, std::chrono::milliseconds::period>(currentTime - startTime).count();
+
+  // warm once the cache came from disk or this pipeline was already created in this run, surface format changes
+  bool warm = _pipelineCache.loadedBytes() > 0 || _pipelineCount > 0;
+  _pipelineCount++;
+  std::cout << "created graphics pipeline in " << pipelineDuration << " ms from a " << (warm ? "warm" : "cold")
+            << " pipeline cache (" << _pipelineCache.loadedBytes() / 1024 << " KB loaded)" << std::endl;
 
   vkDestroyShaderModule(_device, fragShaderModule, nullptr);
   vkDestroyShaderModule(_device, vertShaderModule, nullptr);
 }
 
-VkShaderModule HelloTriangleApp::createShaderModule(const std::vector<char>& code) {
+VkShaderModule HelloTriangleApp::createShaderModule(const MappedFile& code) {
   VkShaderModuleCreateInfo createInfo = {};
   createInfo.sType                    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
   createInfo.codeSize                 = code.size();
@@ -871,6 +1368,8 @@ VkShaderModule HelloTriangleApp::createShaderModule(const std::vector<char>& cod
 }
 
 void HelloTriangleApp::createFramebuffers() {
+  PROFILE_FUNCTION();
+
   _swapChainFramebuffers.resize(_swapChainImageViews.size());
   for (size_t i = 0; i < _swapChainImageViews.size(); i++) {
     std::array<VkImageView, 3> attachments = {
@@ -893,76 +1392,146 @@ void HelloTriangleApp::createFramebuffers() {
   }
 }
 
-void HelloTriangleApp::createCommandPool() {
+void HelloTriangleApp::createCommandPools() {
+  PROFILE_FUNCTION();
+
   QueueFamilyIndices queueFamilyIndices = findQueueFamilies(_physicalDevice);
 
+  // the command buffer of a frame is short lived, its whole pool is reset before it is recorded again
   VkCommandPoolCreateInfo poolInfo = {};
   poolInfo.sType                   = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
   poolInfo.queueFamilyIndex        = queueFamilyIndices.graphicsFamily.value();
-  poolInfo.flags                   = 0;  // Optional
+  poolInfo.flags                   = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
 
-  if (vkCreateCommandPool(_device, &poolInfo, nullptr, &_commandPool) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create command pool!");
+  _commandPools.resize(MAX_FRAMES_IN_FLIGHT);
+  for (VkCommandPool& commandPool : _commandPools) {
+    if (vkCreateCommandPool(_device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create command pool!");
+    }
   }
 }
 
 void HelloTriangleApp::createCommandBuffers() {
-  _commandBuffers.resize(_swapChainFramebuffers.size());
+  PROFILE_FUNCTION();
+
+  _commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+
+  for (size_t i = 0; i < _commandBuffers.size(); i++) {
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool                 = _commandPools[i];
+    allocInfo.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount          = 1;
+
+    if (vkAllocateCommandBuffers(_device, &allocInfo, &_commandBuffers[i]) != VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate command buffers!");
+    }
+  }
+}
 
-  VkCommandBufferAllocateInfo allocInfo = {};
-  allocInfo.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  allocInfo.commandPool                 = _commandPool;
-  allocInfo.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  allocInfo.commandBufferCount          = (uint32_t)_commandBuffers.size();
+// records the frame from the current state of the scene, its pool was reset after the frame's fence
+void HelloTriangleApp::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t image) {
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-  if (vkAllocateCommandBuffers(_device, &allocInfo, _commandBuffers.data()) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate command buffers!");
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("failed to begin recording command buffer!");
   }
 
-  for (size_t i = 0; i < _commandBuffers.size(); i++) {
-    VkCommandBufferBeginInfo beginInfo = {};
-    beginInfo.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    //beginInfo.flags                    = 0;        // Optional
-    //beginInfo.pInheritanceInfo         = nullptr;  // Optional
+  _gpuProfiler.beginFrame(commandBuffer, frame);
+  _gpuProfiler.beginPass(commandBuffer, frame, _mainPass);
 
-    if (vkBeginCommandBuffer(_commandBuffers[i], &beginInfo) != VK_SUCCESS) {
-      throw std::runtime_error("failed to begin recording command buffer!");
-    }
+  VkRenderPassBeginInfo renderPassInfo = {};
+  renderPassInfo.sType                 = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  renderPassInfo.renderPass            = _renderPass;
+  renderPassInfo.framebuffer           = _swapChainFramebuffers[image];
+  renderPassInfo.renderArea.offset     = {0, 0};
+  renderPassInfo.renderArea.extent     = _swapChainExtent;
+
+  std::array<VkClearValue, 2> clearValues = {};
+  clearValues[0].color                    = {0.0f, 0.0f, 0.0f, 1.0f};
+  clearValues[1].depthStencil             = {1.0f, 0};
 
-    VkRenderPassBeginInfo renderPassInfo = {};
-    renderPassInfo.sType                 = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass            = _renderPass;
-    renderPassInfo.framebuffer           = _swapChainFramebuffers[i];
-    renderPassInfo.renderArea.offset     = {0, 0};
-    renderPassInfo.renderArea.extent     = _swapChainExtent;
+  renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+  renderPassInfo.pClearValues    = clearValues.data();
 
-    std::array<VkClearValue, 2> clearValues = {};
-    clearValues[0].color                    = {0.0f, 0.0f, 0.0f, 1.0f};
-    clearValues[1].depthStencil             = {1.0f, 0};
+  // until the model has streamed in the frame is only cleared
+  bool drawModel = (_acquiredAssets & STREAMED_MODEL) != 0;
 
-    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-    renderPassInfo.pClearValues    = clearValues.data();
+  // the indirect commands are the draw list, but every secondary still records one vkCmdDrawIndexedIndirect over a
+  // slice of the same indirect buffer, so splitting parallelizes nothing yet; a counted list is one draw call, the
+  // count is not relative to a partition's offset. Without inheritedQueries the statistics query of the pass forbids
+  // secondaries altogether.
+  size_t drawCalls = _cmdDrawIndexedIndirectCount ? 1 : _maxDrawCount;
+  bool   parallel  = drawModel && _commandRecorder.partitionCount(drawCalls) > 1 &&
+                     _gpuProfiler.allowsSecondaryCommandBuffers();
+  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
+                       parallel ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
 
-    vkCmdBeginRenderPass(_commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+  if (drawModel && !parallel) {
+    recordModelDraws(commandBuffer, frame, image, 0, drawCalls);
+  } else if (drawModel) {
+    VkCommandBufferInheritanceInfo inheritance = {};
+    inheritance.sType                          = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance.renderPass                     = _renderPass;
+    inheritance.subpass                        = 0;
+    inheritance.framebuffer                    = _swapChainFramebuffers[image];
+    inheritance.pipelineStatistics             = _gpuProfiler.inheritedStatistics();
 
-    vkCmdBindPipeline(_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, _graphicsPipeline);
-    VkBuffer     vertexBuffers[] = {_vertexBuffer};
-    VkDeviceSize offsets[]       = {0};
-    vkCmdBindVertexBuffers(_commandBuffers[i], 0, 1, vertexBuffers, offsets);
-    vkCmdBindIndexBuffer(_commandBuffers[i], _indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    const std::vector<VkCommandBuffer>& secondaries = _commandRecorder.record(
+        frame, inheritance, drawCalls, [&](VkCommandBuffer secondary, size_t firstDraw, size_t drawCount) {
+          recordModelDraws(secondary, frame, image, firstDraw, drawCount);
+        });
+    vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+  }
+  vkCmdEndRenderPass(commandBuffer);
 
-    vkCmdBindDescriptorSets(_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayout, 0, 1, &_descriptorSets[i], 0, nullptr);
-    // do indexed draw
-    vkCmdDrawIndexed(_commandBuffers[i], static_cast<uint32_t>(_indices.size()), 1, 0, 0, 0);
-    vkCmdEndRenderPass(_commandBuffers[i]);
+  _gpuProfiler.endPass(commandBuffer, frame, _mainPass);
 
-    if (vkEndCommandBuffer(_commandBuffers[i]) != VK_SUCCESS) {
-      throw std::runtime_error("failed to record command buffer!");
-    }
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record command buffer!");
+  }
+}
+
+// one partition of the model's indirect commands, on a recorder thread; nothing is inherited but the render pass
+void HelloTriangleApp::recordModelDraws(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t image, size_t firstDraw,
+                                        size_t drawCount) {
+  VkViewport viewport = {};
+  viewport.width      = static_cast<float>(_swapChainExtent.width);
+  viewport.height     = static_cast<float>(_swapChainExtent.height);
+  viewport.maxDepth   = 1.0f;
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+  VkRect2D scissor = {{0, 0}, _swapChainExtent};
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _graphicsPipeline);
+  VkBuffer     vertexBuffers[] = {_vertexBuffer};
+  VkDeviceSize offsets[]       = {0};
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+  vkCmdBindIndexBuffer(commandBuffer, _indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+  uint32_t dynamicOffsets[] = {static_cast<uint32_t>(frame * _uniformSlotSize),
+                               static_cast<uint32_t>(frame * _objectSlotSize)};
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayout, 0, 1, &_descriptorSet, 2,
+                          dynamicOffsets);
+
+  // do indexed draw, the LOD and the visible meshlets of every object are only known per frame so updateIndirectDraws
+  // writes the commands; the count behind them says how many there are, without it the unused ones are zeroed
+  if (_cmdDrawIndexedIndirectCount) {
+    _cmdDrawIndexedIndirectCount(commandBuffer, _indirectBuffers[image], 0, _indirectBuffers[image],
+                                 sizeof(VkDrawIndexedIndirectCommand) * _maxDrawCount,
+                                 static_cast<uint32_t>(_maxDrawCount), sizeof(VkDrawIndexedIndirectCommand));
+  } else {
+    vkCmdDrawIndexedIndirect(commandBuffer, _indirectBuffers[image], firstDraw * sizeof(VkDrawIndexedIndirectCommand),
+                             static_cast<uint32_t>(drawCount), sizeof(VkDrawIndexedIndirectCommand));
   }
 }
 
 void HelloTriangleApp::createSyncObjects() {
+  PROFILE_FUNCTION();
+
   _imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
   _renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
   _inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
@@ -985,11 +1554,26 @@ void HelloTriangleApp::createSyncObjects() {
 }
 
 void HelloTriangleApp::drawFrame() {
-  vkWaitForFences(_device, 1, &_inFlightFences[_currentFrame], VK_TRUE, UINT64_MAX);
+  {
+    PROFILE_ZONE("wait for frame");
+    vkWaitForFences(_device, 1, &_inFlightFences[_currentFrame], VK_TRUE, UINT64_MAX);
+  }
+  // the frame's queries are done with the fence, the next submit resets them
+  _gpuProfiler.collect(static_cast<uint32_t>(_currentFrame));
+  destroyRetiredSwapChains(false);
 
   uint32_t imageIndex;
-  VkResult result = vkAcquireNextImageKHR(_device, _swapChain, UINT64_MAX,
-                                          _imageAvailableSemaphores[_currentFrame], VK_NULL_HANDLE, &imageIndex);
+  VkResult result;
+  if (_headless) {
+    // offscreen targets are taken round robin, the image fences below keep one from being reused while in flight
+    imageIndex      = _offscreenImage;
+    result          = VK_SUCCESS;
+    _offscreenImage = (_offscreenImage + 1) % static_cast<uint32_t>(_swapChainImages.size());
+  } else {
+    PROFILE_ZONE("acquire image");
+    result = vkAcquireNextImageKHR(_device, _swapChain, UINT64_MAX, _imageAvailableSemaphores[_currentFrame],
+                                   VK_NULL_HANDLE, &imageIndex);
+  }
 
   if (result == VK_ERROR_OUT_OF_DATE_KHR) {
     recreateSwapChain();
@@ -1000,32 +1584,60 @@ void HelloTriangleApp::drawFrame() {
 
   // Check if a previous frame is using this image (i.e. there is its fence to wait on)
   if (_imagesInFlight[imageIndex] != VK_NULL_HANDLE) {  // FIXME: crash when minimize window
+    PROFILE_ZONE("wait for image");
     vkWaitForFences(_device, 1, &_imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
   }
   // Mark the image as now being in use by this frame
   _imagesInFlight[imageIndex] = _inFlightFences[_currentFrame];
 
-  updateUniformBuffer(imageIndex);
+  {
+    PROFILE_ZONE("update uniforms");
+    updateUniformBuffer(imageIndex);
+  }
+
+  {
+    PROFILE_ZONE("record commands");
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    vkResetCommandPool(_device, _commandPools[_currentFrame], 0);
+    recordCommandBuffer(_commandBuffers[_currentFrame], static_cast<uint32_t>(_currentFrame), imageIndex);
+
+    auto  currentTime = std::chrono::high_resolution_clock::now();
+    float recordMs =
+        std::chrono::duration<float, std::chrono::milliseconds::period>(currentTime - startTime).count();
+    _recordMsTotal += recordMs;
+    _recordMsMax    = std::max(_recordMsMax, recordMs);
+  }
 
   VkSubmitInfo submitInfo = {};
   submitInfo.sType        = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
   VkSemaphore          waitSemaphores[] = {_imageAvailableSemaphores[_currentFrame]};
   VkPipelineStageFlags waitStages[]     = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-  submitInfo.waitSemaphoreCount         = 1;
+  submitInfo.waitSemaphoreCount         = _headless ? 0 : 1;
   submitInfo.pWaitSemaphores            = waitSemaphores;
   submitInfo.pWaitDstStageMask          = waitStages;
   submitInfo.commandBufferCount         = 1;
-  submitInfo.pCommandBuffers            = &_commandBuffers[imageIndex];
+  submitInfo.pCommandBuffers            = &_commandBuffers[_currentFrame];
 
   VkSemaphore signalSemaphores[]  = {_renderFinishedSemaphores[_currentFrame]};
-  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.signalSemaphoreCount = _headless ? 0 : 1;
   submitInfo.pSignalSemaphores    = signalSemaphores;
 
   vkResetFences(_device, 1, &_inFlightFences[_currentFrame]);
 
-  if (vkQueueSubmit(_graphicsQueue, 1, &submitInfo, _inFlightFences[_currentFrame]) != VK_SUCCESS) {
-    throw std::runtime_error("failed to submit draw command buffer!");
+  {
+    PROFILE_ZONE("submit");
+    if (vkQueueSubmit(_graphicsQueue, 1, &submitInfo, _inFlightFences[_currentFrame]) != VK_SUCCESS) {
+      throw std::runtime_error("failed to submit draw command buffer!");
+    }
+  }
+  _gpuProfiler.frameSubmitted(static_cast<uint32_t>(_currentFrame));
+  _submittedFrames++;
+
+  if (_headless) {
+    _currentFrame = (_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    return;
   }
 
   VkPresentInfoKHR presentInfo = {};
@@ -1040,7 +1652,10 @@ void HelloTriangleApp::drawFrame() {
   presentInfo.pImageIndices   = &imageIndex;
   //presentInfo.pResults        = nullptr;  // Optional
 
-  result = vkQueuePresentKHR(_presentQueue, &presentInfo);
+  {
+    PROFILE_ZONE("present");
+    result = vkQueuePresentKHR(_presentQueue, &presentInfo);
+  }
 
   if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || _framebufferResized) {
     _framebufferResized = false;
@@ -1052,67 +1667,43 @@ void HelloTriangleApp::drawFrame() {
   _currentFrame = (_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
-uint32_t HelloTriangleApp::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-  VkPhysicalDeviceMemoryProperties memProperties;
-  vkGetPhysicalDeviceMemoryProperties(_physicalDevice, &memProperties);
-
-  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-    if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-      return i;
-    }
-  }
-
-  throw std::runtime_error("failed to find suitable memory type!");
-}
+void HelloTriangleApp::createVertexBuffer(UploadManager& uploads) {
+  PROFILE_FUNCTION();
 
-void HelloTriangleApp::createVertexBuffer() {
-  VkDeviceSize bufferSize = sizeof(_vertices[0]) * _vertices.size();
+  VkDeviceSize bufferSize = (_usePackedVertices ? sizeof(PackedVertex) : sizeof(Vertex)) * _vertexCount;
 
-  VkBuffer       stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-  createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-               stagingBuffer, stagingBufferMemory);
+  StagingRange staging = uploads.stage(bufferSize);
 
-  void* data;
-  vkMapMemory(_device, stagingBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, _vertices.data(), (size_t)bufferSize);
-  vkUnmapMemory(_device, stagingBufferMemory);
+  void* data = staging.data;
+  if (_usePackedVertices) {
+    // quantized straight into the staging memory
+    packVertices(_vertexData, _vertexCount, _vertexQuantization, static_cast<PackedVertex*>(data));
+  } else {
+    memcpy(data, _vertexData, (size_t)bufferSize);
+  }
 
   createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _vertexBuffer, _vertexBufferMemory);
 
-  copyBuffer(stagingBuffer, _vertexBuffer, bufferSize);
-
-  vkDestroyBuffer(_device, stagingBuffer, nullptr);
-  vkFreeMemory(_device, stagingBufferMemory, nullptr);
+  copyBuffer(uploads.commandBuffer(), staging.buffer, staging.offset, _vertexBuffer, bufferSize);
 }
 
-void HelloTriangleApp::createIndexBuffer() {
-  VkDeviceSize bufferSize = sizeof(_indices[0]) * _indices.size();
+void HelloTriangleApp::createIndexBuffer(UploadManager& uploads) {
+  PROFILE_FUNCTION();
 
-  VkBuffer       stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-  createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-               stagingBuffer, stagingBufferMemory);
+  VkDeviceSize bufferSize = sizeof(uint32_t) * _indexCount;
 
-  void* data;
-  vkMapMemory(_device, stagingBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, _indices.data(), (size_t)bufferSize);
-  vkUnmapMemory(_device, stagingBufferMemory);
+  StagingRange staging = uploads.stage(bufferSize);
+  memcpy(staging.data, _indexData, (size_t)bufferSize);
 
   createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _indexBuffer, _indexBufferMemory);
 
-  copyBuffer(stagingBuffer, _indexBuffer, bufferSize);
-
-  vkDestroyBuffer(_device, stagingBuffer, nullptr);
-  vkFreeMemory(_device, stagingBufferMemory, nullptr);
+  copyBuffer(uploads.commandBuffer(), staging.buffer, staging.offset, _indexBuffer, bufferSize);
 }
 
 void HelloTriangleApp::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-                                    VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+                                    VkBuffer& buffer, GpuAllocation& bufferMemory) {
   VkBufferCreateInfo bufferInfo = {};
   bufferInfo.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   bufferInfo.size               = size;
@@ -1126,32 +1717,25 @@ void HelloTriangleApp::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
   VkMemoryRequirements memRequirements;
   vkGetBufferMemoryRequirements(_device, buffer, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo = {};
-  allocInfo.sType                = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize       = memRequirements.size;
-  allocInfo.memoryTypeIndex      = findMemoryType(memRequirements.memoryTypeBits, properties);
+  bufferMemory = _allocator.allocate(memRequirements, properties, false);
 
-  if (vkAllocateMemory(_device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate vertex buffer memory!");
-  }
-
-  vkBindBufferMemory(_device, buffer, bufferMemory, 0);
+  vkBindBufferMemory(_device, buffer, bufferMemory.memory, bufferMemory.offset);
 }
 
-void HelloTriangleApp::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-  VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
+void HelloTriangleApp::copyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkDeviceSize srcOffset,
+                                  VkBuffer dstBuffer, VkDeviceSize size) {
   VkBufferCopy copyRegion = {};
+  copyRegion.srcOffset    = srcOffset;
   copyRegion.size         = size;
   vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-  endSingleTimeCommands(commandBuffer);
 }
 
 void HelloTriangleApp::createDescriptorSetLayout() {
+  PROFILE_FUNCTION();
+
   VkDescriptorSetLayoutBinding uboLayoutBinding = {};
   uboLayoutBinding.binding                      = 0;
-  uboLayoutBinding.descriptorType               = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  uboLayoutBinding.descriptorType               = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
   uboLayoutBinding.descriptorCount              = 1;
   uboLayoutBinding.stageFlags                   = VK_SHADER_STAGE_VERTEX_BIT;
   uboLayoutBinding.pImmutableSamplers           = nullptr;  // Optional
@@ -1163,7 +1747,13 @@ void HelloTriangleApp::createDescriptorSetLayout() {
   samplerLayoutBinding.pImmutableSamplers           = nullptr;
   samplerLayoutBinding.stageFlags                   = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-  std::array<VkDescriptorSetLayoutBinding, 2> bindings = {uboLayoutBinding, samplerLayoutBinding};
+  VkDescriptorSetLayoutBinding objectLayoutBinding = {};
+  objectLayoutBinding.binding                      = 2;
+  objectLayoutBinding.descriptorCount              = 1;
+  objectLayoutBinding.descriptorType               = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  objectLayoutBinding.stageFlags                   = VK_SHADER_STAGE_VERTEX_BIT;
+
+  std::array<VkDescriptorSetLayoutBinding, 3> bindings = {uboLayoutBinding, samplerLayoutBinding, objectLayoutBinding};
 
   VkDescriptorSetLayoutCreateInfo layoutInfo = {};
   layoutInfo.sType                           = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -1173,20 +1763,31 @@ void HelloTriangleApp::createDescriptorSetLayout() {
   if (vkCreateDescriptorSetLayout(_device, &layoutInfo, nullptr, &_descriptorSetLayout) != VK_SUCCESS) {
     throw std::runtime_error("failed to create descriptor set layout!");
   }
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+  pipelineLayoutInfo.sType                      = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount             = 1;
+  pipelineLayoutInfo.pSetLayouts                = &_descriptorSetLayout;
+
+  if (vkCreatePipelineLayout(_device, &pipelineLayoutInfo, nullptr, &_pipelineLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline layout!");
+  }
 }
 
 void HelloTriangleApp::createUniformBuffers() {
-  VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+  PROFILE_FUNCTION();
 
-  _uniformBuffers.resize(_swapChainImages.size());
-  _uniformBuffersMemory.resize(_swapChainImages.size());
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(_physicalDevice, &properties);
 
-  for (size_t i = 0; i < _swapChainImages.size(); i++) {
-    createBuffer(bufferSize,
-                 VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 _uniformBuffers[i], _uniformBuffersMemory[i]);
-  }
+  // dynamic offsets have to be multiples of minUniformBufferOffsetAlignment, a power of two
+  VkDeviceSize alignment = properties.limits.minUniformBufferOffsetAlignment;
+  _uniformSlotSize       = (sizeof(UniformBufferObject) + alignment - 1) & ~(alignment - 1);
+
+  createBuffer(_uniformSlotSize * MAX_FRAMES_IN_FLIGHT,
+               VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+               _uniformRing, _uniformRingMemory);
 }
 
 void HelloTriangleApp::updateUniformBuffer(uint32_t currentImage) {
@@ -1195,30 +1796,180 @@ void HelloTriangleApp::updateUniformBuffer(uint32_t currentImage) {
   auto  currentTime = std::chrono::high_resolution_clock::now();
   float time        = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 
+  glm::mat4 rotation = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+
   UniformBufferObject ubo = {};
-  ubo.model               = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
   ubo.view                = updateViewMatrix();
   ubo.proj                = glm::perspective(glm::radians(45.0f), _swapChainExtent.width / (float)_swapChainExtent.height, 0.1f, 100.0f);
   ubo.proj[1][1] *= -1;
 
-  void* data;
-  vkMapMemory(_device, _uniformBuffersMemory[currentImage], 0, sizeof(ubo), 0, &data);
-  memcpy(data, &ubo, sizeof(ubo));
-  vkUnmapMemory(_device, _uniformBuffersMemory[currentImage]);
+  updateIndirectDraws(currentImage, rotation, ubo.view, ubo.proj);
+
+  // the fence of _currentFrame has signaled, no submitted frame reads these slots any more
+  memcpy(static_cast<uint8_t*>(_uniformRingMemory.mapped) + _currentFrame * _uniformSlotSize, &ubo, sizeof(ubo));
+
+  auto objectModels = reinterpret_cast<glm::mat4*>(static_cast<uint8_t*>(_objectRingMemory.mapped) +
+                                                   _currentFrame * _objectSlotSize);
+  for (uint32_t object = 0; object < _objectCount; object++) {
+    objectModels[object] = objectModel(object, rotation) * _vertexQuantization.dequantizeMatrix();
+  }
+}
+
+void HelloTriangleApp::createObjectBuffers() {
+  PROFILE_FUNCTION();
+
+  // far enough apart that turning objects never touch, they turn around the model's origin
+  float    spacing = 2.0f * (glm::length(_meshCenter) + _meshRadius);
+  uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(_objectCount))));
+  uint32_t rows    = (_objectCount + columns - 1) / columns;
+
+  _objectOffsets.resize(_objectCount);
+  for (uint32_t object = 0; object < _objectCount; object++) {
+    float x                = static_cast<float>(object % columns) - 0.5f * static_cast<float>(columns - 1);
+    float y                = static_cast<float>(object / columns) - 0.5f * static_cast<float>(rows - 1);
+    _objectOffsets[object] = glm::vec3(x * spacing, y * spacing, 0.0f);
+  }
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(_physicalDevice, &properties);
+
+  VkDeviceSize alignment = properties.limits.minStorageBufferOffsetAlignment;
+  _objectSlotSize        = (sizeof(glm::mat4) * _objectCount + alignment - 1) & ~(alignment - 1);
+
+  createBuffer(_objectSlotSize * MAX_FRAMES_IN_FLIGHT,
+               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+               _objectRing, _objectRingMemory);
+}
+
+glm::mat4 HelloTriangleApp::objectModel(uint32_t object, const glm::mat4& rotation) const {
+  return glm::translate(glm::mat4(1.0f), _objectOffsets[object]) * rotation;
+}
+
+void HelloTriangleApp::createIndirectBuffers() {
+  PROFILE_FUNCTION();
+
+  VkPhysicalDeviceFeatures   supportedFeatures;
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceFeatures(_physicalDevice, &supportedFeatures);
+  vkGetPhysicalDeviceProperties(_physicalDevice, &properties);
+
+  // only the meshlets of one LOD are drawn per object and frame
+  size_t maxLodMeshlets = 0;
+  for (size_t l = 0; l + 1 < _lodMeshletOffsets.size(); l++) {
+    maxLodMeshlets = std::max(maxLodMeshlets, _lodMeshletOffsets[l + 1] - _lodMeshletOffsets[l]);
+  }
+
+  _meshletCulling = supportedFeatures.multiDrawIndirect && maxLodMeshlets > 0 &&
+                    maxLodMeshlets * _objectCount <= properties.limits.maxDrawIndirectCount;
+  _maxDrawCount   = _objectCount * (_meshletCulling ? maxLodMeshlets : 1);
+
+  // the draw count follows the commands
+  VkDeviceSize bufferSize = sizeof(VkDrawIndexedIndirectCommand) * _maxDrawCount;
+  if (_cmdDrawIndexedIndirectCount) {
+    bufferSize += sizeof(uint32_t);
+  }
+
+  // a recreated swap chain keeps the buffers it has images for, frames in flight may still read them
+  size_t firstNew = _indirectBuffers.size();
+  if (_swapChainImages.size() <= firstNew) {
+    return;
+  }
+  if (firstNew == 0) {
+    std::cout << "drawing " << _objectCount << " objects with up to " << _maxDrawCount << " indirect commands, "
+              << (_cmdDrawIndexedIndirectCount ? "counted on the GPU" : "unused ones zeroed") << std::endl;
+  }
+  _indirectBuffers.resize(_swapChainImages.size());
+  _indirectBuffersMemory.resize(_swapChainImages.size());
+  _indirectCommands.resize(_swapChainImages.size());
+  _indirectDrawCounts.resize(_swapChainImages.size(), 0);
+
+  for (size_t i = firstNew; i < _swapChainImages.size(); i++) {
+    createBuffer(bufferSize,
+                 VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 _indirectBuffers[i], _indirectBuffersMemory[i]);
+
+    // stays mapped, rewritten by updateIndirectDraws every frame
+    void* data = _indirectBuffersMemory[i].mapped;
+    _indirectCommands[i] = static_cast<VkDrawIndexedIndirectCommand*>(data);
+    memset(data, 0, (size_t)bufferSize);
+  }
+}
+
+void HelloTriangleApp::updateIndirectDraws(uint32_t currentImage, const glm::mat4& rotation, const glm::mat4& view,
+                                           const glm::mat4& proj) {
+  VkDrawIndexedIndirectCommand* commands  = _indirectCommands[currentImage];
+  size_t                        drawCount = 0;
+
+  for (uint32_t object = 0; object < _objectCount; object++) {
+    glm::mat4 model = objectModel(object, rotation);
+    size_t    lod   = selectModelLod(model, view, proj);
+    if (object == 0 && lod != _currentLod) {
+      // the reporter thread writes it, the render loop never blocks on the console
+      std::ostringstream text;
+      text << "switched to LOD " << lod << " (" << _lodData[lod].indexCount / 3 << " triangles)\n";
+      _frameStats.print(text.str());
+      _currentLod = lod;
+    }
+
+    size_t firstCommand = drawCount;
+    if (_meshletCulling) {
+      size_t firstMeshlet = _lodMeshletOffsets[lod];
+      size_t meshletCount = _lodMeshletOffsets[lod + 1] - firstMeshlet;
+      drawCount += cullMeshlets(_meshlets.data() + firstMeshlet, meshletCount, makeCullingView(model, view, proj),
+                                commands + drawCount);
+    } else {
+      VkDrawIndexedIndirectCommand command = {};
+      command.indexCount                   = _lodData[lod].indexCount;
+      command.instanceCount                = 1;
+      command.firstIndex                   = _lodData[lod].firstIndex;
+
+      commands[drawCount++] = command;
+    }
+
+    // the vertex shader looks the model matrix up by gl_InstanceIndex
+    for (size_t c = firstCommand; c < drawCount; c++) {
+      commands[c].firstInstance = object;
+    }
+  }
+
+  if (_cmdDrawIndexedIndirectCount) {
+    uint32_t count = static_cast<uint32_t>(drawCount);
+    memcpy(commands + _maxDrawCount, &count, sizeof(count));
+  } else if (drawCount < _indirectDrawCounts[currentImage]) {
+    // the command buffer draws all _maxDrawCount commands, clear what the last frame left behind
+    memset(commands + drawCount, 0,
+           sizeof(VkDrawIndexedIndirectCommand) * (_indirectDrawCounts[currentImage] - drawCount));
+  }
+  _indirectDrawCounts[currentImage] = drawCount;
+}
+
+size_t HelloTriangleApp::selectModelLod(const glm::mat4& model, const glm::mat4& view, const glm::mat4& proj) const {
+  // distance to the nearest point of the bounding sphere, so no part of the mesh shows more than the error bound
+  glm::vec3 center          = glm::vec3(view * model * glm::vec4(_meshCenter, 1.0f));
+  float     distance        = glm::length(center) - _meshRadius;
+  float     projectionScale = 0.5f * static_cast<float>(_swapChainExtent.height) * std::abs(proj[1][1]);
+
+  return selectLod(_lodData, _lodCount, distance, projectionScale, _maxPixelError);
 }
 
 void HelloTriangleApp::createDescriptorPool() {
-  std::array<VkDescriptorPoolSize, 2> poolSizes = {};
-  poolSizes[0].type                             = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  poolSizes[0].descriptorCount                  = static_cast<uint32_t>(_swapChainImages.size());
+  PROFILE_FUNCTION();
+
+  std::array<VkDescriptorPoolSize, 3> poolSizes = {};
+  poolSizes[0].type                             = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  poolSizes[0].descriptorCount                  = 1;
   poolSizes[1].type                             = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  poolSizes[1].descriptorCount                  = static_cast<uint32_t>(_swapChainImages.size());
+  poolSizes[1].descriptorCount                  = 1;
+  poolSizes[2].type                             = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  poolSizes[2].descriptorCount                  = 1;
 
   VkDescriptorPoolCreateInfo poolInfo = {};
   poolInfo.sType                      = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
   poolInfo.poolSizeCount              = static_cast<uint32_t>(poolSizes.size());
   poolInfo.pPoolSizes                 = poolSizes.data();
-  poolInfo.maxSets                    = static_cast<uint32_t>(_swapChainImages.size());
+  poolInfo.maxSets                    = 1;
 
   if (vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_descriptorPool) != VK_SUCCESS) {
     throw std::runtime_error("failed to create descriptor pool!");
@@ -1226,95 +1977,442 @@ void HelloTriangleApp::createDescriptorPool() {
 }
 
 void HelloTriangleApp::createDescriptorSets() {
-  std::vector<VkDescriptorSetLayout> layouts(_swapChainImages.size(), _descriptorSetLayout);
-  VkDescriptorSetAllocateInfo        allocInfo = {};
-  allocInfo.sType                              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-  allocInfo.descriptorPool                     = _descriptorPool;
-  allocInfo.descriptorSetCount                 = static_cast<uint32_t>(_swapChainImages.size());
-  allocInfo.pSetLayouts                        = layouts.data();
-
-  _descriptorSets.resize(_swapChainImages.size());
-  if (vkAllocateDescriptorSets(_device, &allocInfo, _descriptorSets.data()) != VK_SUCCESS) {
+  PROFILE_FUNCTION();
+
+  VkDescriptorSetAllocateInfo allocInfo = {};
+  allocInfo.sType                       = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool              = _descriptorPool;
+  allocInfo.descriptorSetCount          = 1;
+  allocInfo.pSetLayouts                 = &_descriptorSetLayout;
+
+  if (vkAllocateDescriptorSets(_device, &allocInfo, &_descriptorSet) != VK_SUCCESS) {
     throw std::runtime_error("failed to allocate descriptor sets!");
   }
 
-  for (size_t i = 0; i < _swapChainImages.size(); i++) {
-    VkDescriptorBufferInfo bufferInfo = {};
-    bufferInfo.buffer                 = _uniformBuffers[i];
-    bufferInfo.offset                 = 0;
-    bufferInfo.range                  = sizeof(UniformBufferObject);
-
-    VkDescriptorImageInfo imageInfo = {};
-    imageInfo.imageLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    imageInfo.imageView             = _textureImageView;
-    imageInfo.sampler               = _textureSampler;
-
-    std::array<VkWriteDescriptorSet, 2> descriptorWrites = {};
-
-    VkWriteDescriptorSet descriptorWrite = {};
-    descriptorWrites[0].sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrites[0].dstSet           = _descriptorSets[i];
-    descriptorWrites[0].dstBinding       = 0;
-    descriptorWrites[0].dstArrayElement  = 0;
-    descriptorWrites[0].descriptorType   = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    descriptorWrites[0].descriptorCount  = 1;
-    descriptorWrites[0].pBufferInfo      = &bufferInfo;
-
-    descriptorWrites[1].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrites[1].dstSet          = _descriptorSets[i];
-    descriptorWrites[1].dstBinding      = 1;
-    descriptorWrites[1].dstArrayElement = 0;
-    descriptorWrites[1].descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    descriptorWrites[1].descriptorCount = 1;
-    descriptorWrites[1].pImageInfo      = &imageInfo;
-
-    vkUpdateDescriptorSets(_device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
-  }
-}
-
-void HelloTriangleApp::createTextureImage() {
-  int          texWidth, texHeight, texChannels;
-  stbi_uc*     pixels    = stbi_load(TEXTURE_PATH.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-  VkDeviceSize imageSize = texWidth * texHeight * 4;
-  _mipLevels             = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
-
-  if (!pixels) {
+  updateDescriptorSet();
+}
+
+// the placeholder is sampled until the texture has been acquired from the transfer queue
+void HelloTriangleApp::updateDescriptorSet() {
+  PROFILE_FUNCTION();
+
+  // one slot of the ring, the dynamic offset picks which
+  VkDescriptorBufferInfo bufferInfo = {};
+  bufferInfo.buffer                 = _uniformRing;
+  bufferInfo.offset                 = 0;
+  bufferInfo.range                  = sizeof(UniformBufferObject);
+
+  VkDescriptorBufferInfo objectInfo = {};
+  objectInfo.buffer                 = _objectRing;
+  objectInfo.offset                 = 0;
+  objectInfo.range                  = sizeof(glm::mat4) * _objectCount;
+
+  VkDescriptorImageInfo imageInfo = {};
+  imageInfo.imageLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  imageInfo.imageView             = (_acquiredAssets & STREAMED_TEXTURE) ? _textureImageView : _placeholderImageView;
+  imageInfo.sampler               = _textureSampler;
+
+  std::array<VkWriteDescriptorSet, 3> descriptorWrites = {};
+
+  descriptorWrites[0].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrites[0].dstSet          = _descriptorSet;
+  descriptorWrites[0].dstBinding      = 0;
+  descriptorWrites[0].dstArrayElement = 0;
+  descriptorWrites[0].descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  descriptorWrites[0].descriptorCount = 1;
+  descriptorWrites[0].pBufferInfo     = &bufferInfo;
+
+  descriptorWrites[1].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrites[1].dstSet          = _descriptorSet;
+  descriptorWrites[1].dstBinding      = 1;
+  descriptorWrites[1].dstArrayElement = 0;
+  descriptorWrites[1].descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  descriptorWrites[1].descriptorCount = 1;
+  descriptorWrites[1].pImageInfo      = &imageInfo;
+
+  descriptorWrites[2].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrites[2].dstSet          = _descriptorSet;
+  descriptorWrites[2].dstBinding      = 2;
+  descriptorWrites[2].dstArrayElement = 0;
+  descriptorWrites[2].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  descriptorWrites[2].descriptorCount = 1;
+  descriptorWrites[2].pBufferInfo     = &objectInfo;
+
+  vkUpdateDescriptorSets(_device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
+
+// needs no device, so startup runs it next to instance and device creation
+void HelloTriangleApp::loadTexture() {
+  PROFILE_FUNCTION();
+
+  // a matching KTX2 cache skips decoding, filtering and encoding altogether; whether the device can sample its
+  // format is only known later, createTextureImage then decodes after all
+  if (_compressTextures && _textureCache.open(TEXTURE_PATH, _textureFormat)) {
+    return;
+  }
+  decodeTextureFile();
+}
+
+// level 0 of _textureLevels, the chain is sized for every level so they can be filtered in place
+void HelloTriangleApp::decodeTextureFile() {
+  PROFILE_FUNCTION();
+
+  // decode straight from the mapped file instead of letting stb read it into its own buffer
+  MappedFile     textureFile = readFile(TEXTURE_PATH);
+  const uint8_t* fileData    = reinterpret_cast<const uint8_t*>(textureFile.data());
+
+  int      texWidth, texHeight, texChannels;
+  uint32_t jpegWidth, jpegHeight;
+  bool     parallelJpeg = readJpegInfo(fileData, textureFile.size(), jpegWidth, jpegHeight);
+  if (parallelJpeg) {
+    texWidth  = static_cast<int>(jpegWidth);
+    texHeight = static_cast<int>(jpegHeight);
+  } else if (!stbi_info_from_memory(fileData, static_cast<int>(textureFile.size()), &texWidth, &texHeight,
+                                    &texChannels)) {
     throw std::runtime_error("failed to load texture image!");
   }
+  _mipLevels     = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+  _textureLevels = computeMipLayout(static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), _mipLevels);
+  _texturePixels.resize(mipChainSize(_textureLevels));
 
-  VkBuffer       stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-  createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-               stagingBuffer, stagingBufferMemory);
+  decodeTexture(textureFile, parallelJpeg, _texturePixels.data(), _textureLevels[0].size);
+}
+
+void HelloTriangleApp::createTextureImage(UploadManager& uploads) {
+  PROFILE_FUNCTION();
+
+  // block compressed textures need the BC feature and a format that can be sampled, otherwise stay on RGBA8
+  VkFormat           blockFormat = _textureFormat == BlockFormat::BC1 ? VK_FORMAT_BC1_RGB_SRGB_BLOCK
+                                                                      : VK_FORMAT_BC7_SRGB_BLOCK;
+  VkFormatProperties blockFormatProperties;
+  vkGetPhysicalDeviceFormatProperties(_physicalDevice, blockFormat, &blockFormatProperties);
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(_physicalDevice, &supportedFeatures);
+
+  bool compress = _compressTextures && supportedFeatures.textureCompressionBC &&
+                  (blockFormatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+  _textureImageFormat = compress ? blockFormat : VK_FORMAT_R8G8B8A8_SRGB;
+
+  if (compress && _textureCache.isValid()) {
+    auto startTime = std::chrono::high_resolution_clock::now();
 
-  void* data;
-  vkMapMemory(_device, stagingBufferMemory, 0, imageSize, 0, &data);
-  memcpy(data, pixels, static_cast<size_t>(imageSize));
-  vkUnmapMemory(_device, stagingBufferMemory);
+    _mipLevels = static_cast<uint32_t>(_textureCache.levels().size());
+    uploadTextureLevels(uploads, _textureCache.levels(), _textureCache.data());
 
-  stbi_image_free(pixels);
+    auto  endTime  = std::chrono::high_resolution_clock::now();
+    float duration = std::chrono::duration<float, std::chrono::milliseconds::period>(endTime - startTime).count();
+    std::cout << "loaded " << _mipLevels << " mip levels of " << TEXTURE_PATH
+              << " from the texture cache and recorded the upload in " << duration << " ms" << std::endl;
+    return;
+  }
+
+  if (_texturePixels.empty()) {
+    decodeTextureFile();
+  }
+  // the decoded chain is only needed until its levels are staged
+  std::vector<uint8_t> chain;
+  chain.swap(_texturePixels);
+
+  if (compress) {
+    compressTextureImage(uploads, chain.data(), _textureLevels);
+    return;
+  }
+
+  // without linear filtering support for the format the blit chain is not an option, build the levels on the CPU;
+  // the same goes for a transfer queue, it cannot blit
+  VkFormatProperties formatProperties;
+  vkGetPhysicalDeviceFormatProperties(_physicalDevice, VK_FORMAT_R8G8B8A8_SRGB, &formatProperties);
+  bool cpuMipmaps = _cpuMipmaps || _streamAssets ||
+                    !(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+
+  std::vector<MipLevel> levels = _textureLevels;
+  if (!cpuMipmaps) {
+    levels.resize(1);
+  }
+  uint32_t     texWidth    = levels[0].width;
+  uint32_t     texHeight   = levels[0].height;
+  VkDeviceSize stagingSize = mipChainSize(levels);
+
+  auto startTime = std::chrono::high_resolution_clock::now();
+
+  // the chain is built in ordinary memory, staging memory may be write combined and reading it back is slow
+  if (cpuMipmaps) {
+    generateMipChain(chain.data(), levels, _mipFilter);
+  }
+  StagingRange staging = uploads.stage(stagingSize);
+  memcpy(staging.data, chain.data(), static_cast<size_t>(stagingSize));
 
   createImage(texWidth, texHeight, _mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
               VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _textureImage, _textureImageMemory);
 
-  transitionImageLayout(_textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED,
+  transitionImageLayout(uploads.commandBuffer(), _textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED,
                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, _mipLevels);
-  copyBufferToImage(stagingBuffer, _textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+  copyMipChainToImage(uploads.commandBuffer(), staging.buffer, staging.offset, _textureImage, levels);
 
-  //transitionImageLayout(_textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-  //                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, _mipLevels);
+  // streamed, the release to the graphics queue family performs the transition
+  if (cpuMipmaps && !_streamAssets) {
+    transitionImageLayout(uploads.commandBuffer(), _textureImage, VK_FORMAT_R8G8B8A8_SRGB,
+                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, _mipLevels);
+  }
 
-  vkDestroyBuffer(_device, stagingBuffer, nullptr);
-  vkFreeMemory(_device, stagingBufferMemory, nullptr);
+  if (!cpuMipmaps) {
+    generateMipmaps(uploads.commandBuffer(), _textureImage, VK_FORMAT_R8G8B8A8_SRGB, static_cast<int32_t>(texWidth),
+                    static_cast<int32_t>(texHeight), _mipLevels);
+  }
 
-  generateMipmaps(_textureImage, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, _mipLevels);
+  auto  endTime     = std::chrono::high_resolution_clock::now();
+  float mipDuration = std::chrono::duration<float, std::chrono::milliseconds::period>(endTime - startTime).count();
+  std::cout << "generated " << _mipLevels << " mip levels on the " << (cpuMipmaps ? "CPU" : "GPU")
+            << " and recorded the upload in " << mipDuration << " ms" << std::endl;
+}
+
+void HelloTriangleApp::compressTextureImage(UploadManager& uploads, uint8_t* chain,
+                                            const std::vector<MipLevel>& levels) {
+  PROFILE_FUNCTION();
+
+  auto startTime = std::chrono::high_resolution_clock::now();
+  generateMipChain(chain, levels, _mipFilter);
+  auto compressStartTime = std::chrono::high_resolution_clock::now();
+
+  // the blocks of all levels are packed back to back, every level size is a multiple of the block size
+  std::vector<MipLevel> blockLevels = levels;
+  size_t                blockSize   = 0;
+  size_t                pixelCount  = 0;
+  for (MipLevel& level : blockLevels) {
+    level.offset = blockSize;
+    level.size   = compressedSize(level.width, level.height, _textureFormat);
+    blockSize += level.size;
+    pixelCount += static_cast<size_t>(level.width) * level.height;
+  }
+
+  std::vector<uint8_t> blocks(blockSize);
+  for (size_t i = 0; i < levels.size(); i++) {
+    compressBlocks(chain + levels[i].offset, levels[i].width, levels[i].height, _textureFormat,
+                   blocks.data() + blockLevels[i].offset);
+  }
+
+  auto  compressEndTime = std::chrono::high_resolution_clock::now();
+  float mipDuration =
+      std::chrono::duration<float, std::chrono::milliseconds::period>(compressStartTime - startTime).count();
+  float compressDuration =
+      std::chrono::duration<float, std::chrono::milliseconds::period>(compressEndTime - compressStartTime).count();
+  std::cout << "generated " << _mipLevels << " mip levels on the CPU in " << mipDuration << " ms and compressed them to "
+            << (_textureFormat == BlockFormat::BC1 ? "BC1" : "BC7") << " in " << compressDuration << " ms ("
+            << pixelCount / (compressDuration * 1000.0f) << " MPixels/s)" << std::endl;
+
+  if (!_textureCache.write(blockLevels, blocks.data())) {
+    std::cerr << "failed to write texture cache for " << TEXTURE_PATH << std::endl;
+  }
+
+  uploadTextureLevels(uploads, blockLevels, blocks.data());
+}
+
+void HelloTriangleApp::uploadTextureLevels(UploadManager& uploads, const std::vector<MipLevel>& levels,
+                                           const uint8_t* data) {
+  PROFILE_FUNCTION();
+
+  // levels are packed into staging in order, copyMipChainToImage then writes one region per level
+  std::vector<MipLevel> stagingLevels = levels;
+  VkDeviceSize          stagingSize   = 0;
+  for (MipLevel& level : stagingLevels) {
+    level.offset = static_cast<size_t>(stagingSize);
+    stagingSize += level.size;
+  }
+
+  StagingRange staging = uploads.stage(stagingSize);
+  for (size_t i = 0; i < levels.size(); i++) {
+    memcpy(staging.data + stagingLevels[i].offset, data + levels[i].offset, levels[i].size);
+  }
+
+  uint32_t mipLevels = static_cast<uint32_t>(levels.size());
+  createImage(levels[0].width, levels[0].height, mipLevels, VK_SAMPLE_COUNT_1_BIT, _textureImageFormat,
+              VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _textureImage, _textureImageMemory);
+
+  transitionImageLayout(uploads.commandBuffer(), _textureImage, _textureImageFormat, VK_IMAGE_LAYOUT_UNDEFINED,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+  copyMipChainToImage(uploads.commandBuffer(), staging.buffer, staging.offset, _textureImage, stagingLevels);
+  if (!_streamAssets) {
+    transitionImageLayout(uploads.commandBuffer(), _textureImage, _textureImageFormat,
+                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
+  }
+}
+
+// a single mid gray texel
+void HelloTriangleApp::createPlaceholderTexture() {
+  PROFILE_FUNCTION();
+
+  const uint8_t         texel[4] = {128, 128, 128, 255};
+  std::vector<MipLevel> levels   = computeMipLayout(1, 1, 1);
+
+  StagingRange staging = _uploads.stage(sizeof(texel));
+  memcpy(staging.data, texel, sizeof(texel));
+
+  createImage(1, 1, 1, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
+              VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+              _placeholderImage, _placeholderImageMemory);
+
+  transitionImageLayout(_uploads.commandBuffer(), _placeholderImage, VK_FORMAT_R8G8B8A8_SRGB,
+                        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1);
+  copyMipChainToImage(_uploads.commandBuffer(), staging.buffer, staging.offset, _placeholderImage, levels);
+  transitionImageLayout(_uploads.commandBuffer(), _placeholderImage, VK_FORMAT_R8G8B8A8_SRGB,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1);
+
+  _placeholderImageView = createImageView(_placeholderImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+}
+
+void HelloTriangleApp::startAssetStream() {
+  _streamUploads.init(_device, _transferQueue, _queueFamilies.transferFamily.value(), _allocator);
+
+  VkSemaphoreCreateInfo semaphoreInfo = {};
+  semaphoreInfo.sType                 = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+  for (VkSemaphore& semaphore : _streamSemaphores) {
+    if (vkCreateSemaphore(_device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create stream semaphores!");
+    }
+  }
+
+  _streamStartTime = std::chrono::high_resolution_clock::now();
+  _streamThread    = std::thread(&HelloTriangleApp::streamAssets, this);
+}
+
+// runs on the stream thread, the model is small next to the texture and comes first
+void HelloTriangleApp::streamAssets() {
+  setProfileThreadName("asset stream");
+
+  try {
+    createVertexBuffer(_streamUploads);
+    createIndexBuffer(_streamUploads);
+    releaseStreamedAsset(STREAMED_MODEL);
+
+    createTextureImage(_streamUploads);
+    createTextureImageView();
+    releaseStreamedAsset(STREAMED_TEXTURE);
+  } catch (...) {
+    _streamError = std::current_exception();
+    _streamedAssets.fetch_or(STREAM_FAILED, std::memory_order_release);
+  }
+}
+
+void HelloTriangleApp::releaseStreamedAsset(uint32_t asset) {
+  recordOwnershipTransfer(_streamUploads.commandBuffer(), asset, true);
+  _streamUploads.submit(_streamSemaphores[asset == STREAMED_MODEL ? 0 : 1]);
+  _streamedAssets.fetch_or(asset, std::memory_order_release);
+}
+
+/*
+Both halves of moving the streamed resources from the transfer to the graphics queue family. The release runs on
+the transfer queue after the copies, the acquire on the graphics queue once the release's semaphore has signaled;
+the texture changes its layout in between.
+*/
+void HelloTriangleApp::recordOwnershipTransfer(VkCommandBuffer commandBuffer, uint32_t assets, bool release) {
+  std::vector<VkBufferMemoryBarrier> bufferBarriers;
+  std::vector<VkImageMemoryBarrier>  imageBarriers;
+
+  if (assets & STREAMED_MODEL) {
+    std::array<std::pair<VkBuffer, VkAccessFlags>, 2> buffers = {
+        std::make_pair(_vertexBuffer, VkAccessFlags(VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT)),
+        std::make_pair(_indexBuffer, VkAccessFlags(VK_ACCESS_INDEX_READ_BIT))};
+
+    for (const auto& buffer : buffers) {
+      VkBufferMemoryBarrier barrier = {};
+      barrier.sType                 = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+      barrier.srcAccessMask         = release ? VK_ACCESS_TRANSFER_WRITE_BIT : 0;
+      barrier.dstAccessMask         = release ? 0 : buffer.second;
+      barrier.srcQueueFamilyIndex   = _queueFamilies.transferFamily.value();
+      barrier.dstQueueFamilyIndex   = _queueFamilies.graphicsFamily.value();
+      barrier.buffer                = buffer.first;
+      barrier.offset                = 0;
+      barrier.size                  = VK_WHOLE_SIZE;
+      bufferBarriers.push_back(barrier);
+    }
+  }
+
+  if (assets & STREAMED_TEXTURE) {
+    VkImageMemoryBarrier barrier            = {};
+    barrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask                   = release ? VK_ACCESS_TRANSFER_WRITE_BIT : 0;
+    barrier.dstAccessMask                   = release ? 0 : VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout                       = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout                       = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcQueueFamilyIndex             = _queueFamilies.transferFamily.value();
+    barrier.dstQueueFamilyIndex             = _queueFamilies.graphicsFamily.value();
+    barrier.image                           = _textureImage;
+    barrier.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel   = 0;
+    barrier.subresourceRange.levelCount     = _mipLevels;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount     = 1;
+    imageBarriers.push_back(barrier);
+  }
+
+  // the acquire waits for the semaphore at the stages that use the assets
+  VkPipelineStageFlags useStages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  vkCmdPipelineBarrier(commandBuffer, release ? VK_PIPELINE_STAGE_TRANSFER_BIT : useStages,
+                       release ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : useStages, 0, 0, nullptr,
+                       static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+                       static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+}
+
+/*
+Called before every frame, does nothing until the stream thread has released another asset. The acquire is submitted
+right away and the command buffer recorded next draws with the asset, every frame records its own. Frames in flight
+never touch the model, but they sample the placeholder through the one descriptor set, so only the texture waits for
+them before the set is rewritten and the placeholder destroyed.
+*/
+void HelloTriangleApp::acquireStreamedAssets() {
+  uint32_t streamed = _streamedAssets.load(std::memory_order_acquire);
+  if (streamed & STREAM_FAILED) {
+    _streamThread.join();
+    std::rethrow_exception(_streamError);
+  }
+
+  uint32_t arrived = streamed & ~_acquiredAssets;
+  if (arrived == 0) {
+    return;
+  }
+  PROFILE_ZONE("acquire streamed assets");
+
+  VkPipelineStageFlags useStages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  for (uint32_t asset : {STREAMED_MODEL, STREAMED_TEXTURE}) {
+    if (arrived & asset) {
+      recordOwnershipTransfer(_uploads.commandBuffer(), asset, false);
+      _uploads.submit(VK_NULL_HANDLE, _streamSemaphores[asset == STREAMED_MODEL ? 0 : 1], useStages);
+    }
+  }
+
+  _acquiredAssets |= arrived;
+
+  auto        currentTime    = std::chrono::high_resolution_clock::now();
+  float       streamDuration =
+      std::chrono::duration<float, std::chrono::milliseconds::period>(currentTime - _streamStartTime).count();
+  const char* assetNames     = arrived == (STREAMED_MODEL | STREAMED_TEXTURE) ? "model and texture"
+                               : (arrived & STREAMED_TEXTURE)                 ? "texture"
+                                                                              : "model";
+  std::cout << "streamed in the " << assetNames << " after " << streamDuration << " ms" << std::endl;
+
+  if (arrived & STREAMED_TEXTURE) {
+    vkWaitForFences(_device, MAX_FRAMES_IN_FLIGHT, _inFlightFences.data(), VK_TRUE, UINT64_MAX);
+    updateDescriptorSet();
+
+    vkDestroyImageView(_device, _placeholderImageView, nullptr);
+    vkDestroyImage(_device, _placeholderImage, nullptr);
+    _allocator.free(_placeholderImageMemory);
+    _placeholderImageView = VK_NULL_HANDLE;
+  }
+
+  if (_acquiredAssets == (STREAMED_MODEL | STREAMED_TEXTURE)) {
+    _streamThread.join();
+    _streamUploads.destroy();
+    printUploadStats();
+  }
 }
 
 void HelloTriangleApp::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples,
                                    VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
-                                   VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
+                                   VkMemoryPropertyFlags properties, VkImage& image, GpuAllocation& imageMemory) {
   VkImageCreateInfo imageInfo = {};
   imageInfo.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
   imageInfo.imageType         = VK_IMAGE_TYPE_2D;
@@ -1337,55 +2435,13 @@ void HelloTriangleApp::createImage(uint32_t width, uint32_t height, uint32_t mip
   VkMemoryRequirements memRequirements;
   vkGetImageMemoryRequirements(_device, image, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo = {};
-  allocInfo.sType                = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize       = memRequirements.size;
-  allocInfo.memoryTypeIndex      = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-  if (vkAllocateMemory(_device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate image memory!");
-  }
-
-  vkBindImageMemory(_device, image, imageMemory, 0);
-}
-
-VkCommandBuffer HelloTriangleApp::beginSingleTimeCommands() {
-  VkCommandBufferAllocateInfo allocInfo = {};
-  allocInfo.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  allocInfo.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  allocInfo.commandPool                 = _commandPool;
-  allocInfo.commandBufferCount          = 1;
-
-  VkCommandBuffer commandBuffer;
-  vkAllocateCommandBuffers(_device, &allocInfo, &commandBuffer);
-
-  VkCommandBufferBeginInfo beginInfo = {};
-  beginInfo.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-  beginInfo.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-  vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-  return commandBuffer;
-}
-
-void HelloTriangleApp::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
-  vkEndCommandBuffer(commandBuffer);
-
-  VkSubmitInfo submitInfo       = {};
-  submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers    = &commandBuffer;
-
-  vkQueueSubmit(_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-  vkQueueWaitIdle(_graphicsQueue);
+  imageMemory = _allocator.allocate(memRequirements, properties, tiling == VK_IMAGE_TILING_OPTIMAL);
 
-  vkFreeCommandBuffers(_device, _commandPool, 1, &commandBuffer);
+  vkBindImageMemory(_device, image, imageMemory.memory, imageMemory.offset);
 }
 
-void HelloTriangleApp::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout,
-                                             VkImageLayout newLayout, uint32_t mipLevels) {
-  VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
+void HelloTriangleApp::transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkFormat format,
+                                             VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels) {
   VkImageMemoryBarrier barrier            = {};
   barrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
   barrier.oldLayout                       = oldLayout;
@@ -1425,42 +2481,12 @@ void HelloTriangleApp::transitionImageLayout(VkImage image, VkFormat format, VkI
       0, nullptr,
       0, nullptr,
       1, &barrier);
-
-  endSingleTimeCommands(commandBuffer);
-}
-
-void HelloTriangleApp::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
-  VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-  VkBufferImageCopy region = {};
-  region.bufferOffset      = 0;
-  region.bufferRowLength   = 0;
-  region.bufferImageHeight = 0;
-
-  region.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
-  region.imageSubresource.mipLevel       = 0;
-  region.imageSubresource.baseArrayLayer = 0;
-  region.imageSubresource.layerCount     = 1;
-
-  region.imageOffset = {0, 0, 0};
-  region.imageExtent = {
-      width,
-      height,
-      1};
-
-  vkCmdCopyBufferToImage(
-      commandBuffer,
-      buffer,
-      image,
-      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-      1,
-      &region);
-
-  endSingleTimeCommands(commandBuffer);
 }
 
 void HelloTriangleApp::createTextureImageView() {
-  _textureImageView = createImageView(_textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, _mipLevels);
+  PROFILE_FUNCTION();
+
+  _textureImageView = createImageView(_textureImage, _textureImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, _mipLevels);
 }
 
 VkImageView HelloTriangleApp::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels) {
@@ -1484,6 +2510,8 @@ VkImageView HelloTriangleApp::createImageView(VkImage image, VkFormat format, Vk
 }
 
 void HelloTriangleApp::createTextureSampler() {
+  PROFILE_FUNCTION();
+
   VkSamplerCreateInfo samplerInfo     = {};
   samplerInfo.sType                   = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
   samplerInfo.magFilter               = VK_FILTER_LINEAR;
@@ -1499,7 +2527,7 @@ void HelloTriangleApp::createTextureSampler() {
   samplerInfo.compareOp               = VK_COMPARE_OP_ALWAYS;
   samplerInfo.mipmapMode              = VK_SAMPLER_MIPMAP_MODE_LINEAR;
   samplerInfo.minLod                  = 0;
-  samplerInfo.maxLod                  = static_cast<float>(_mipLevels);
+  samplerInfo.maxLod                  = VK_LOD_CLAMP_NONE;  // the image views limit the levels
   samplerInfo.mipLodBias              = 0;  // Optional
 
   if (vkCreateSampler(_device, &samplerInfo, nullptr, &_textureSampler) != VK_SUCCESS) {
@@ -1508,6 +2536,8 @@ void HelloTriangleApp::createTextureSampler() {
 }
 
 void HelloTriangleApp::createDepthResources() {
+  PROFILE_FUNCTION();
+
   VkFormat depthFormat = findDepthFormat();
 
   createImage(_swapChainExtent.width, _swapChainExtent.height, 1, _msaaSamples, depthFormat, VK_IMAGE_TILING_OPTIMAL,
@@ -1542,40 +2572,105 @@ bool HelloTriangleApp::hasStencilComponent(VkFormat format) {
 }
 
 void HelloTriangleApp::loadModel() {
-  tinyobj::attrib_t                attrib;
-  std::vector<tinyobj::shape_t>    shapes;
-  std::vector<tinyobj::material_t> materials;
-  std::string                      warn, err;
+  PROFILE_FUNCTION();
+
+  auto startTime = std::chrono::high_resolution_clock::now();
+
+  // warm start: the deduplicated arrays are uploaded straight out of the mapped cache
+  if (_meshCache.open(MODEL_PATH)) {
+    _vertexData  = _meshCache.vertices();
+    _vertexCount = _meshCache.vertexCount();
+    _indexData   = _meshCache.indices();
+    _indexCount  = _meshCache.indexCount();
+    _lodData     = _meshCache.lods();
+    _lodCount    = _meshCache.lodCount();
 
-  if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, MODEL_PATH.c_str())) {
+    auto  currentTime  = std::chrono::high_resolution_clock::now();
+    float loadDuration = std::chrono::duration<float, std::chrono::milliseconds::period>(currentTime - startTime).count();
+    std::cout << "loaded mesh cache for " << MODEL_PATH << " in " << loadDuration << " ms" << std::endl;
+    printLods(_lodData, _lodCount);
+
+    buildModelMeshlets();
+    return;
+  }
+
+  tinyobj::attrib_t             attrib;
+  std::vector<tinyobj::shape_t> shapes;
+  std::string                   warn, err;
+
+  if (!loadObjParallel(&attrib, &shapes, &warn, &err, MODEL_PATH)) {
     throw std::runtime_error(warn + err);
   }
 
-  std::unordered_map<Vertex, uint32_t> uniqueVertices = {};
+  auto  parseTime     = std::chrono::high_resolution_clock::now();
+  float parseDuration = std::chrono::duration<float, std::chrono::milliseconds::period>(parseTime - startTime).count();
+  std::cout << "parsed " << MODEL_PATH << " in " << parseDuration << " ms" << std::endl;
 
-  for (const auto& shape : shapes) {
-    for (const auto& index : shape.mesh.indices) {
-      Vertex vertex = {};
+  deduplicateVertices(attrib, shapes, _vertices, _indices);
 
-      vertex.pos = {
-          attrib.vertices[3 * index.vertex_index + 0],
-          attrib.vertices[3 * index.vertex_index + 1],
-          attrib.vertices[3 * index.vertex_index + 2]};
+  VertexCacheStats before = analyzeVertexCache(_indices.data(), _indices.size(), _vertices.size());
+  optimizeMesh(_vertices, _indices);
+  VertexCacheStats after = analyzeVertexCache(_indices.data(), _indices.size(), _vertices.size());
 
-      vertex.texCoord = {
-          attrib.texcoords[2 * index.texcoord_index + 0],
-          1.0f - attrib.texcoords[2 * index.texcoord_index + 1]};
+  std::cout << "optimized mesh: ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> "
+            << after.atvr << std::endl;
 
-      vertex.color = {1.0f, 1.0f, 1.0f};
+  auto lodStartTime = std::chrono::high_resolution_clock::now();
+  buildLodChain(_vertices.data(), _vertices.size(), _indices, _lods);
 
-      if (uniqueVertices.count(vertex) == 0) {
-        uniqueVertices[vertex] = static_cast<uint32_t>(_vertices.size());
-        _vertices.push_back(vertex);
-      }
+  auto  lodTime     = std::chrono::high_resolution_clock::now();
+  float lodDuration = std::chrono::duration<float, std::chrono::milliseconds::period>(lodTime - lodStartTime).count();
+  std::cout << "simplified " << _lods.size() - 1 << " LODs in " << lodDuration << " ms" << std::endl;
+  printLods(_lods.data(), _lods.size());
 
-      _indices.push_back(uniqueVertices[vertex]);
+  _vertexData  = _vertices.data();
+  _vertexCount = _vertices.size();
+  _indexData   = _indices.data();
+  _indexCount  = _indices.size();
+  _lodData     = _lods.data();
+  _lodCount    = _lods.size();
+
+  if (!_meshCache.write(_vertexData, _vertexCount, _indexData, _indexCount, _lodData, _lodCount)) {
+    std::cerr << "failed to write mesh cache for " << MODEL_PATH << std::endl;
+  }
+
+  buildModelMeshlets();
+}
+
+void HelloTriangleApp::buildModelMeshlets() {
+  PROFILE_FUNCTION();
+
+  auto startTime = std::chrono::high_resolution_clock::now();
+
+  // every LOD gets its own meshlets, their index ranges are relative to the LOD
+  _meshlets.clear();
+  _lodMeshletOffsets.assign(1, 0);
+  for (size_t l = 0; l < _lodCount; l++) {
+    const MeshLod&       lod      = _lodData[l];
+    std::vector<Meshlet> meshlets = buildMeshlets(_vertexData, _vertexCount, _indexData + lod.firstIndex, lod.indexCount);
+    for (Meshlet& meshlet : meshlets) {
+      meshlet.firstIndex += lod.firstIndex;
     }
+
+    _meshlets.insert(_meshlets.end(), meshlets.begin(), meshlets.end());
+    _lodMeshletOffsets.push_back(_meshlets.size());
   }
+
+  // bounding sphere of the full mesh for LOD selection, the meshlet spheres of LOD 0 cover every triangle
+  glm::vec3 minimum(INFINITY), maximum(-INFINITY);
+  for (size_t m = 0; m < _lodMeshletOffsets[1]; m++) {
+    minimum = glm::min(minimum, _meshlets[m].center - glm::vec3(_meshlets[m].radius));
+    maximum = glm::max(maximum, _meshlets[m].center + glm::vec3(_meshlets[m].radius));
+  }
+  _meshCenter = (minimum + maximum) * 0.5f;
+  _meshRadius = 0.0f;
+  for (size_t m = 0; m < _lodMeshletOffsets[1]; m++) {
+    _meshRadius = std::max(_meshRadius, glm::length(_meshlets[m].center - _meshCenter) + _meshlets[m].radius);
+  }
+
+  auto  currentTime   = std::chrono::high_resolution_clock::now();
+  float buildDuration = std::chrono::duration<float, std::chrono::milliseconds::period>(currentTime - startTime).count();
+  std::cout << "built " << _meshlets.size() << " meshlets in " << buildDuration << " ms" << std::endl;
 }
 
 void HelloTriangleApp::framebufferResizeCallback(GLFWwindow* window, int width, int height) {
@@ -1594,6 +2689,11 @@ void HelloTriangleApp::key_callback(GLFWwindow* window, int key, int scancode, i
   if (key == GLFW_KEY_F11 && action == GLFW_PRESS) {
     app->toggleFullscreen();
   }
+
+  // everything recorded so far, the trace written on exit has the rest too
+  if (key == GLFW_KEY_F12 && action == GLFW_PRESS) {
+    app->writeTrace();
+  }
 }
 
 void HelloTriangleApp::toggleFullscreen() {
@@ -1616,11 +2716,34 @@ void HelloTriangleApp::toggleFullscreen() {
   }
 }
 
+// one region per level, every level lands in a single vkCmdCopyBufferToImage; level offsets start at bufferOffset
+void HelloTriangleApp::copyMipChainToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize bufferOffset,
+                                           VkImage image, const std::vector<MipLevel>& levels) {
+  std::vector<VkBufferImageCopy> regions(levels.size());
+  for (size_t i = 0; i < levels.size(); i++) {
+    VkBufferImageCopy& region = regions[i];
+    region                    = {};
+    region.bufferOffset       = bufferOffset + levels[i].offset;
+
+    region.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel       = static_cast<uint32_t>(i);
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount     = 1;
+
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {levels[i].width, levels[i].height, 1};
+  }
+
+  vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         static_cast<uint32_t>(regions.size()), regions.data());
+}
+
 glm::mat4 HelloTriangleApp::updateViewMatrix() {
   return glm::lookAt(_viewTranslation, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 }
 
-void HelloTriangleApp::generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels) {
+void HelloTriangleApp::generateMipmaps(VkCommandBuffer commandBuffer, VkImage image, VkFormat imageFormat,
+                                       int32_t texWidth, int32_t texHeight, uint32_t mipLevels) {
   // Check if image format supports linear blitting
   VkFormatProperties formatProperties;
   vkGetPhysicalDeviceFormatProperties(_physicalDevice, imageFormat, &formatProperties);
@@ -1629,8 +2752,6 @@ void HelloTriangleApp::generateMipmaps(VkImage image, VkFormat imageFormat, int3
     throw std::runtime_error("texture image format does not support linear blitting!");
   }
 
-  VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
   VkImageMemoryBarrier barrier            = {};
   barrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
   barrier.image                           = image;
@@ -1703,8 +2824,6 @@ void HelloTriangleApp::generateMipmaps(VkImage image, VkFormat imageFormat, int3
                        0, nullptr,
                        0, nullptr,
                        1, &barrier);
-
-  endSingleTimeCommands(commandBuffer);
 }
 
 VkSampleCountFlagBits HelloTriangleApp::getMaxUsableSampleCount() {
@@ -1736,6 +2855,8 @@ VkSampleCountFlagBits HelloTriangleApp::getMaxUsableSampleCount() {
 }
 
 void HelloTriangleApp::createColorResources() {
+  PROFILE_FUNCTION();
+
   VkFormat colorFormat = _swapChainImageFormat;
 
   createImage(_swapChainExtent.width, _swapChainExtent.height, 1, _msaaSamples, colorFormat,
@@ -3,20 +3,35 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
-#define GLM_FORCE_RADIANS
-#define GLM_FORCE_DEPTH_ZERO_TO_ONE
-#include <glm/glm.hpp>
-
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
-
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <exception>
 #include <optional>
+#include <string>
+#include <thread>
 #include <vector>
 
+#include "./blockcompression.h"
+#include "./commandrecorder.h"
+#include "./gpuallocator.h"
+#include "./framestats.h"
+#include "./gpuprofiler.h"
+#include "./mappedfile.h"
+#include "./meshcache.h"
+#include "./meshlet.h"
+#include "./meshsimplifier.h"
+#include "./mipmap.h"
+#include "./pipelinecache.h"
+#include "./taskgraph.h"
+#include "./texturecache.h"
+#include "./uploadmanager.h"
+#include "./vertex.h"
+
 struct QueueFamilyIndices {
   std::optional<uint32_t> graphicsFamily;
   std::optional<uint32_t> presentFamily;
+  std::optional<uint32_t> transferFamily;  // neither graphics nor compute, absent on many integrated GPUs
 
   bool isComplete() {
     return graphicsFamily.has_value() && presentFamily.has_value();
@@ -29,60 +44,8 @@ struct SwapChainSupportDetails {
   std::vector<VkPresentModeKHR>   presentModes;
 };
 
-struct Vertex {
-  glm::vec3 pos;
-  glm::vec3 color;
-  glm::vec2 texCoord;
-
-  bool operator==(const Vertex& other) const {
-    return pos == other.pos && color == other.color && texCoord == other.texCoord;
-  }
-
-  static VkVertexInputBindingDescription getBindingDescription() {
-    VkVertexInputBindingDescription bindingDescription = {};
-    bindingDescription.binding                         = 0;
-    bindingDescription.stride                          = sizeof(Vertex);
-    bindingDescription.inputRate                       = VK_VERTEX_INPUT_RATE_VERTEX;
-
-    return bindingDescription;
-  }
-
-  static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions() {
-    std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions = {};
-
-    attributeDescriptions[0].binding  = 0;
-    attributeDescriptions[0].location = 0;
-    attributeDescriptions[0].format   = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[0].offset   = offsetof(Vertex, pos);
-
-    attributeDescriptions[1].binding  = 0;
-    attributeDescriptions[1].location = 1;
-    attributeDescriptions[1].format   = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[1].offset   = offsetof(Vertex, color);
-
-    attributeDescriptions[2].binding  = 0;
-    attributeDescriptions[2].location = 2;
-    attributeDescriptions[2].format   = VK_FORMAT_R32G32_SFLOAT;
-    attributeDescriptions[2].offset   = offsetof(Vertex, texCoord);
-
-    return attributeDescriptions;
-  }
-};
-
-namespace std {
-template <>
-struct hash<Vertex> {
-  size_t operator()(Vertex const& vertex) const {
-    return ((hash<glm::vec3>()(vertex.pos) ^
-             (hash<glm::vec3>()(vertex.color) << 1)) >>
-            1) ^
-           (hash<glm::vec2>()(vertex.texCoord) << 1);
-  }
-};
-}  // namespace std
-
+// the model matrices are per object, in the object ring
 struct UniformBufferObject {
-  alignas(16) glm::mat4 model;
   alignas(16) glm::mat4 view;
   alignas(16) glm::mat4 proj;
 };
@@ -96,35 +59,83 @@ class HelloTriangleApp {
  public:
   void run();
 
+  // appends every frame time to a CSV file for offline analysis
+  void setFrameStatsCsv(const std::string& path);
+  // renders frameCount frames into offscreen images without a window or surface, then reports the timings
+  void setHeadless(uint32_t frameCount);
+  // draws count copies of the model side by side on a square grid, all of them through the same indirect draw
+  void setObjectCount(uint32_t count);
+
+  /*
+  Model from sketchfab: https://sketchfab.com/3d-models/drinking-fountain-barratt-gardens-fadb7924554048fdb59dcaabf6714832
+  Author: artfletch
+  License: CC Attribution
+  */
+  inline static const std::string MODEL_PATH   = "models/drinking-fountain-barratt-gardens/DrinkingFountainBarrattGardens01.obj";
+  inline static const std::string TEXTURE_PATH = "models/drinking-fountain-barratt-gardens/DrinkingFountainBarrattGardens_2m_8k_01_u1_v1.jpg";
+
+  /*
+  inline static const std::string MODEL_PATH   = "models/the-parade-armour-of-king-erik-xiv-of-sweden/180212_Erik_XIV_Rustning_2.obj";
+  inline static const std::string TEXTURE_PATH = "models/the-parade-armour-of-king-erik-xiv-of-sweden/180212_Erik_XIV_Rustning_2_u1_v1.png";
+  */
+
  private:
-  GLFWwindow*              _window;
+  inline static const char* WINDOW_TITLE = "Vulkan Hello Triangle";
+
+  GLFWwindow*              _window = nullptr;
   VkInstance               _instance;
   VkDebugUtilsMessengerEXT _debugMessenger;
   VkPhysicalDevice         _physicalDevice = VK_NULL_HANDLE;
   VkDevice                 _device;
   VkQueue                  _graphicsQueue;
   VkQueue                  _presentQueue;
+  VkQueue                  _transferQueue = VK_NULL_HANDLE;
+  QueueFamilyIndices       _queueFamilies;  // the ones createLogicalDevice created queues for
   VkSurfaceKHR             _surface;
   VkSwapchainKHR           _swapChain;
   std::vector<VkImage>     _swapChainImages;
 
   VkFormat   _swapChainImageFormat;
   VkExtent2D _swapChainExtent;
+  VkExtent2D _framebufferSize;  // queried on the main thread, used when the surface leaves the extent to us
 
   std::vector<VkImageView> _swapChainImageViews;
 
+  // headless runs render into images of their own in place of the swap chain
+  bool                       _headless       = false;
+  uint32_t                   _headlessFrames = 0;
+  std::vector<GpuAllocation> _offscreenImagesMemory;
+  uint32_t                   _offscreenImage = 0;  // the next one to render into
+
   const std::vector<const char*> _validationLayers = {"VK_LAYER_KHRONOS_validation"};
   const std::vector<const char*> _deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
-  VkRenderPass          _renderPass;
+  VkRenderPass          _renderPass = VK_NULL_HANDLE;
   VkDescriptorSetLayout _descriptorSetLayout;
   VkPipelineLayout      _pipelineLayout;
   VkPipeline            _graphicsPipeline;
 
+  // the render pass, and the pipeline made for it, only depend on these; a new swap chain of the same ones keeps both
+  VkFormat              _renderPassFormat  = VK_FORMAT_UNDEFINED;
+  VkSampleCountFlagBits _renderPassSamples = VK_SAMPLE_COUNT_1_BIT;
+
+  // driver compiled pipelines kept across runs, shared by every pipeline creation
+  inline static const std::string PIPELINE_CACHE_PATH = "pipeline.cache";
+  PipelineCache                   _pipelineCache;
+  uint32_t                        _pipelineCount = 0;  // graphics pipelines created so far
+
   std::vector<VkFramebuffer> _swapChainFramebuffers;
 
-  VkCommandPool                _commandPool;
+  // one transient pool per frame in flight, reset and its command buffer recorded again every frame
+  std::vector<VkCommandPool>   _commandPools;
   std::vector<VkCommandBuffer> _commandBuffers;
+  float                        _recordMsTotal = 0.0f;  // recording time since the pass statistics were last printed
+  float                        _recordMsMax   = 0.0f;
+
+  // scaffolding for draw lists recorded command by command: the model is a single multi draw indirect, a split list
+  // only spreads one vkCmdDrawIndexedIndirect per slice over the workers and wins nothing, the scaling the recorder
+  // benchmark shows comes from its mock draws
+  CommandRecorder _commandRecorder;
 
   std::vector<VkSemaphore> _imageAvailableSemaphores;
   std::vector<VkSemaphore> _renderFinishedSemaphores;
@@ -133,8 +144,32 @@ class HelloTriangleApp {
 
   const int MAX_FRAMES_IN_FLIGHT = 2;
   size_t    _currentFrame        = 0;
+  uint64_t  _submittedFrames     = 0;
 
-  bool _framebufferResized = false;
+  bool  _framebufferResized = false;
+  float _resizeMs           = 0.0f;  // spent recreating the swap chain during the current frame
+
+  /*
+  What a swap chain recreation replaced. Frames recorded against it may still be in flight, so instead of waiting for
+  the device to go idle it is kept until the frame fences show they have finished.
+  */
+  struct RetiredSwapChain {
+    uint64_t                     submittedFrames;  // frames that may use it
+    VkSwapchainKHR               swapChain = VK_NULL_HANDLE;
+    std::vector<VkImage>         offscreenImages;
+    std::vector<GpuAllocation>   offscreenImagesMemory;
+    std::vector<VkImageView>     imageViews;
+    std::vector<VkFramebuffer>   framebuffers;
+    VkImage                      colorImage;
+    GpuAllocation                colorImageMemory;
+    VkImageView                  colorImageView;
+    VkImage                      depthImage;
+    GpuAllocation                depthImageMemory;
+    VkImageView                  depthImageView;
+    VkRenderPass                 renderPass = VK_NULL_HANDLE;  // set when the surface format changed
+    VkPipeline                   pipeline   = VK_NULL_HANDLE;
+  };
+  std::vector<RetiredSwapChain> _retiredSwapChains;
 
 #ifdef NDEBUG
   bool _enableValidationLayers = false;
@@ -144,10 +179,12 @@ class HelloTriangleApp {
 
   void initWindow();
   void initVulkan();
+  void printStartupReport(const TaskGraph& graph, TaskGraph::TaskId last);
   void setupDebugMessenger();
   void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
   void createInstance();
   void mainLoop();
+  void printHeadlessReport(const std::vector<float>& frameTimes);
   void cleanup();
 
   bool                                  checkValidationLayerSupport();
@@ -159,10 +196,11 @@ class HelloTriangleApp {
 
   void createSurface();
 
-  void               pickPhysicalDevice();
-  bool               isDeviceSuitable(VkPhysicalDevice device);
-  bool               checkDeviceExtensionSupport(VkPhysicalDevice device);
-  QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
+  void                     pickPhysicalDevice();
+  bool                     isDeviceSuitable(VkPhysicalDevice device);
+  std::vector<const char*> requiredDeviceExtensions() const;
+  bool                     checkDeviceExtensionSupport(VkPhysicalDevice device);
+  QueueFamilyIndices       findQueueFamilies(VkPhysicalDevice device);
 
   void createLogicalDevice();
 
@@ -171,22 +209,27 @@ class HelloTriangleApp {
   VkPresentModeKHR        chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
   VkExtent2D              chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
 
-  void createSwapChain();
+  void createSwapChain(VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE);
+  void createOffscreenTargets();
   void createImageViews();
 
-  VkShaderModule createShaderModule(const std::vector<char>& code);
+  VkShaderModule createShaderModule(const MappedFile& code);
   void           createRenderPass();
   void           createGraphicsPipeline();
 
   void createFramebuffers();
-  void createCommandPool();
+  void createCommandPools();
   void createCommandBuffers();
+  void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t image);
+  void recordModelDraws(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t image, size_t firstDraw,
+                        size_t drawCount);
 
   void createSyncObjects();
   void drawFrame();
 
   void recreateSwapChain();
-  void cleanupSwapChain();
+  void retireSwapChain();
+  void destroyRetiredSwapChains(bool all);
 
   /*
   const std::vector<Vertex> _vertices = {
@@ -212,46 +255,172 @@ class HelloTriangleApp {
   std::vector<Vertex>   _vertices;
   std::vector<uint32_t> _indices;
 
-  VkBuffer       _vertexBuffer;
-  VkDeviceMemory _vertexBufferMemory;
-  VkBuffer       _indexBuffer;
-  VkDeviceMemory _indexBufferMemory;
+  // point either into _vertices/_indices or into the mapped mesh cache
+  MeshCache       _meshCache;
+  const Vertex*   _vertexData  = nullptr;
+  size_t          _vertexCount = 0;
+  const uint32_t* _indexData   = nullptr;
+  size_t          _indexCount  = 0;
+  const MeshLod*  _lodData     = nullptr;
+  size_t          _lodCount    = 0;
+
+  // levels of detail are appended to _indices, every object gets one by its projected error
+  std::vector<MeshLod> _lods;
+  size_t               _currentLod    = 0;  // of the first object, reported when it changes
+  float                _maxPixelError = 1.0f;
+  glm::vec3            _meshCenter    = glm::vec3(0.0f);
+  float                _meshRadius    = 0.0f;
+
+  // upload PackedVertex instead of Vertex, positions are dequantized through the model matrix
+  bool               _usePackedVertices  = true;
+  VertexQuantization _vertexQuantization = {};
+
+  // every buffer and image is bound to a range of a shared block instead of its own vkAllocateMemory
+  GpuAllocator _allocator;
+
+  // GPU time and invocation counts of the render pass, read back a frame-in-flight cycle late
+  GpuProfiler _gpuProfiler;
+  uint32_t    _mainPass       = 0;
+  uint32_t    _gpuReportFrame = 0;  // frames since the pass statistics were last printed
+
+  // frame time percentiles and hitches, printed once a second by a reporter thread and shown in the window title
+  FrameStats  _frameStats;
+  bool        _showFrameStats = true;
+  std::string _frameStatsCsvPath;
+
+  VkBuffer      _vertexBuffer;
+  GpuAllocation _vertexBufferMemory;
+  VkBuffer      _indexBuffer;
+  GpuAllocation _indexBufferMemory;
+
+  void createVertexBuffer(UploadManager& uploads);
+  void createIndexBuffer(UploadManager& uploads);
+  void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer,
+                    GpuAllocation& bufferMemory);
+
+  // staging copies, barriers and blits are recorded into the current upload batch, submitted at the end of initVulkan
+  UploadManager _uploads;
+
+  void copyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkDeviceSize srcOffset, VkBuffer dstBuffer,
+                  VkDeviceSize size);
+  void printUploadStats();
 
-  uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
-  void     createVertexBuffer();
-  void     createIndexBuffer();
-  void     createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-                        VkBuffer& buffer, VkDeviceMemory& bufferMemory);
-
-  void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+  /*
+  With a transfer only queue family the model buffers and the texture are built and uploaded on a background thread
+  through that family's queue, so the first frames render before they arrive: without the model at first, then with
+  a placeholder texture. Each asset is released by the transfer family and acquired by the graphics family before
+  frames use it. Without such a family everything is uploaded in initVulkan.
+  */
+  static constexpr uint32_t STREAMED_MODEL   = 1;
+  static constexpr uint32_t STREAMED_TEXTURE = 2;
+  static constexpr uint32_t STREAM_FAILED    = 4;
+
+  bool                       _streamAssets = true;
+  UploadManager              _streamUploads;
+  std::thread                _streamThread;
+  std::exception_ptr         _streamError;
+  std::atomic<uint32_t>      _streamedAssets{0};  // released by the stream thread
+  uint32_t                   _acquiredAssets = 0;  // owned by the graphics queue family, main thread only
+  std::array<VkSemaphore, 2> _streamSemaphores;   // model, texture; signaled by their release
+  std::chrono::high_resolution_clock::time_point _streamStartTime;
+
+  VkImage       _placeholderImage;
+  GpuAllocation _placeholderImageMemory;
+  VkImageView   _placeholderImageView = VK_NULL_HANDLE;
+
+  void createPlaceholderTexture();
+  void startAssetStream();
+  void streamAssets();
+  void releaseStreamedAsset(uint32_t asset);
+  void recordOwnershipTransfer(VkCommandBuffer commandBuffer, uint32_t assets, bool release);
+  void acquireStreamedAssets();
 
   void createDescriptorSetLayout();
 
-  std::vector<VkBuffer>       _uniformBuffers;
-  std::vector<VkDeviceMemory> _uniformBuffersMemory;
+  // one slot per frame in flight, written in place and picked by the dynamic offset of the uniform descriptor
+  VkBuffer      _uniformRing;
+  GpuAllocation _uniformRingMemory;
+  VkDeviceSize  _uniformSlotSize;
 
   void createUniformBuffers();
   void updateUniformBuffer(uint32_t currentImage);
-  void createDescriptorPool();
-  void createDescriptorSets();
 
-  VkDescriptorPool             _descriptorPool;
-  std::vector<VkDescriptorSet> _descriptorSets;
+  /*
+  Every object of the scene is drawn from the shared vertex and index buffers by the draw commands of one indirect
+  buffer, so drawing costs the CPU the same whatever the object count. A command's firstInstance names its object, the
+  vertex shader fetches the object's model matrix from a storage buffer through gl_InstanceIndex. A nonzero
+  firstInstance needs the drawIndirectFirstInstance feature and more than one command multiDrawIndirect, without them
+  the scene is a single object.
+  */
+  uint32_t               _objectCount = 1;
+  std::vector<glm::vec3> _objectOffsets;  // grid position of every object
+  VkBuffer               _objectRing;     // model matrices, one slot per frame in flight like the uniforms
+  GpuAllocation          _objectRingMemory;
+  VkDeviceSize           _objectSlotSize;
+
+  // VK_KHR_draw_indirect_count, when present the GPU reads the command count stored after the commands
+  PFN_vkCmdDrawIndexedIndirectCountKHR _cmdDrawIndexedIndirectCount = nullptr;
+
+  void      createObjectBuffers();
+  glm::mat4 objectModel(uint32_t object, const glm::mat4& rotation) const;
 
-  void createTextureImage();
+  /*
+  The model is always drawn from the per-image indirect buffers. With CPU meshlet culling the visible meshlet runs of
+  each object's LOD are drawn through one multi draw indirect, otherwise a single command per object covers its LOD.
+  */
+  std::vector<Meshlet>                       _meshlets;
+  std::vector<size_t>                        _lodMeshletOffsets;  // meshlets of LOD l are [offsets[l], offsets[l + 1])
+  size_t                                     _maxDrawCount   = 1;  // commands per indirect buffer, all objects
+  bool                                       _meshletCulling = false;
+  std::vector<VkBuffer>                      _indirectBuffers;
+  std::vector<GpuAllocation>                 _indirectBuffersMemory;
+  std::vector<VkDrawIndexedIndirectCommand*> _indirectCommands;
+  std::vector<size_t>                        _indirectDrawCounts;
+
+  void   buildModelMeshlets();
+  void   createIndirectBuffers();
+  void   updateIndirectDraws(uint32_t currentImage, const glm::mat4& rotation, const glm::mat4& view,
+                             const glm::mat4& proj);
+  size_t selectModelLod(const glm::mat4& model, const glm::mat4& view, const glm::mat4& proj) const;
+  void   createDescriptorPool();
+  void   createDescriptorSets();
+  void   updateDescriptorSet();
+
+  VkDescriptorPool _descriptorPool;
+  VkDescriptorSet  _descriptorSet;
+
+  void createTextureImage(UploadManager& uploads);
+  void loadTexture();
+  void decodeTextureFile();
 
   uint32_t       _mipLevels;
+  bool           _cpuMipmaps = false;  // build the chain on the CPU even when the GPU could blit it
+  MipFilter      _mipFilter  = MipFilter::Box;
   VkImage        _textureImage;
-  VkDeviceMemory _textureImageMemory;
+  GpuAllocation  _textureImageMemory;
+  VkFormat       _textureImageFormat = VK_FORMAT_R8G8B8A8_SRGB;
+
+  // decoded by loadTexture before there is a device, level 0 only until createTextureImage filters the rest
+  std::vector<MipLevel> _textureLevels;
+  std::vector<uint8_t>  _texturePixels;
+
+  // block compress the mip chain once and keep it in a KTX2 cache next to the texture; BC7 keeps more detail, BC1
+  // halves the size again for opaque textures. Devices without BC support get the RGBA8 path.
+  bool         _compressTextures = true;
+  BlockFormat  _textureFormat    = BlockFormat::BC7;
+  TextureCache _textureCache;
+
+  void compressTextureImage(UploadManager& uploads, uint8_t* chain, const std::vector<MipLevel>& levels);
+  void uploadTextureLevels(UploadManager& uploads, const std::vector<MipLevel>& levels, const uint8_t* data);
+
   void           createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples,
                              VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
-                             VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
+                             VkMemoryPropertyFlags properties, VkImage& image, GpuAllocation& imageMemory);
 
-  VkCommandBuffer beginSingleTimeCommands();
-  void            endSingleTimeCommands(VkCommandBuffer commandBuffer);
-
-  void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
-  void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+  void transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout,
+                             VkImageLayout newLayout, uint32_t mipLevels);
+  void copyMipChainToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image,
+                           const std::vector<MipLevel>& levels);
 
   VkImageView _textureImageView;
 
@@ -261,27 +430,16 @@ class HelloTriangleApp {
   VkSampler   _textureSampler;
 
   VkImage        _depthImage;
-  VkDeviceMemory _depthImageMemory;
+  GpuAllocation  _depthImageMemory;
   VkImageView    _depthImageView;
   void           createDepthResources();
   VkFormat       findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
   VkFormat       findDepthFormat();
   bool           hasStencilComponent(VkFormat format);
 
-  /*
-  Model from sketchfab: https://sketchfab.com/3d-models/drinking-fountain-barratt-gardens-fadb7924554048fdb59dcaabf6714832
-  Author: artfletch
-  License: CC Attribution
-  */
-  const std::string MODEL_PATH       = "models/drinking-fountain-barratt-gardens/DrinkingFountainBarrattGardens01.obj";
-  const std::string TEXTURE_PATH     = "models/drinking-fountain-barratt-gardens/DrinkingFountainBarrattGardens_2m_8k_01_u1_v1.jpg";
-  glm::vec3         _viewTranslation = glm::vec3(0.0f, 50.0f, 20.0f);
+  glm::vec3 _viewTranslation = glm::vec3(0.0f, 50.0f, 20.0f);
+  // glm::vec3 _viewTranslation = glm::vec3(0.0f, 50.0f, 50.0f);
 
-  /*
-  const std::string MODEL_PATH       = "models/the-parade-armour-of-king-erik-xiv-of-sweden/180212_Erik_XIV_Rustning_2.obj";
-  const std::string TEXTURE_PATH     = "models/the-parade-armour-of-king-erik-xiv-of-sweden/180212_Erik_XIV_Rustning_2_u1_v1.png";
-  glm::vec3         _viewTranslation = glm::vec3(0.0f, 50.0f, 50.0f);
-  */
   void loadModel();
 
   glm::mat4 updateViewMatrix();
@@ -294,12 +452,17 @@ class HelloTriangleApp {
   bool _fullscreen = false;
   void toggleFullscreen();
 
-  void generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
+  // Chrome trace of the profile zones, written on F12 and on exit
+  inline static const std::string TRACE_PATH = "trace.json";
+  void                            writeTrace();
+
+  void generateMipmaps(VkCommandBuffer commandBuffer, VkImage image, VkFormat imageFormat, int32_t texWidth,
+                       int32_t texHeight, uint32_t mipLevels);
 
   VkSampleCountFlagBits _msaaSamples = VK_SAMPLE_COUNT_1_BIT;
   VkSampleCountFlagBits getMaxUsableSampleCount();
   VkImage               _colorImage;
-  VkDeviceMemory        _colorImageMemory;
+  GpuAllocation         _colorImageMemory;
   VkImageView           _colorImageView;
   void                  createColorResources();
 
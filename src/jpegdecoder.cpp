@@ -0,0 +1,850 @@
+#include "./jpegdecoder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "./parallel.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JPEG_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const int      MAX_COMPONENTS = 3;
+const int      FAST_BITS      = 9;
+const uint32_t BAND_ROWS      = 16;
+
+// JFIF YCbCr to RGB factors in 12 bit fixed point, applied to chroma scaled by 256 and keeping the high 16 bits
+const int32_t CR_TO_R = 5743;   // 1.40200
+const int32_t CR_TO_G = -2925;  // -0.71414
+const int32_t CB_TO_G = -1410;  // -0.34414
+const int32_t CB_TO_B = 7258;   // 1.77200
+
+// natural order index of the k-th coefficient in zigzag order
+const uint8_t ZIGZAG[64] = {0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+                            12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+                            35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+                            58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+struct HuffmanTable {
+  bool     defined = false;
+  uint16_t fast[1 << FAST_BITS];  // code length << 8 | symbol for codes up to FAST_BITS long, 0 for longer ones
+  int16_t  fastAc[1 << FAST_BITS];  // AC only: value << 8 | run << 4 | total bits when code and magnitude both fit
+  int32_t  maxCode[17];           // largest code of each length, -1 when there is none
+  int32_t  valueOffset[17];       // index of the first symbol of each length minus the first code
+  uint8_t  symbols[256];
+};
+
+struct Component {
+  uint8_t  id;
+  int      h, v;
+  int      quantTable;
+  int      dcTable, acTable;
+  uint32_t width, height;  // samples covered by the image
+  uint32_t stride, rows;   // plane size, padded to whole MCUs
+};
+
+struct Frame {
+  uint32_t       width = 0, height = 0;
+  int            componentCount = 0;
+  Component      components[MAX_COMPONENTS];
+  int            hmax = 1, vmax = 1;
+  uint32_t       mcusPerLine = 0, mcusPerColumn = 0;
+  uint32_t       restartInterval = 0;
+  bool           rgb             = false;  // Adobe transform 0, the components are stored as RGB
+  uint16_t       quant[4][64];             // zigzag order
+  bool           quantDefined[4] = {};
+  HuffmanTable   dc[4], ac[4];
+  const uint8_t* scanBegin = nullptr;  // first byte of entropy coded data
+  const uint8_t* end       = nullptr;
+};
+
+// MSB first bit reader over entropy coded data, stuffed zero bytes are skipped and markers read as zeros
+struct BitReader {
+  const uint8_t* position;
+  const uint8_t* end;
+  uint64_t       buffer = 0;
+  int            bits   = 0;
+
+  void refill() {
+    // common case: the next bytes hold no 0xFF, append as many whole bytes as fit in one go
+    if (end - position >= 8) {
+      uint64_t word = 0;
+      for (int i = 0; i < 8; i++) {
+        word = word << 8 | position[i];
+      }
+      int      bytes    = (64 - bits) >> 3;
+      uint64_t unused   = bytes == 8 ? 0 : ~0ull >> (8 * bytes);
+      uint64_t inverted = ~word | unused;
+      if (!((inverted - 0x0101010101010101ull) & ~inverted & 0x8080808080808080ull)) {
+        buffer |= (word & ~unused) >> bits;
+        bits += 8 * bytes;
+        position += bytes;
+        return;
+      }
+    }
+
+    while (bits <= 56) {
+      uint64_t byte = 0;
+      if (position < end) {
+        if (*position != 0xFF) {
+          byte = *position++;
+        } else if (position + 1 < end && position[1] == 0x00) {
+          byte = 0xFF;
+          position += 2;
+        }
+      }
+      buffer |= byte << (56 - bits);
+      bits += 8;
+    }
+  }
+
+  uint32_t peek(int count) const {
+    return static_cast<uint32_t>(buffer >> (64 - count));
+  }
+
+  void consume(int count) {
+    buffer <<= count;
+    bits -= count;
+  }
+};
+
+// where a job starts decoding: the reader and DC predictors at its first MCU
+struct Segment {
+  BitReader reader;
+  int       dcPredictors[MAX_COMPONENTS];
+  uint32_t  firstMcu;
+  uint32_t  mcuCount;
+};
+
+inline uint16_t readU16(const uint8_t* p) {
+  return static_cast<uint16_t>(p[0] << 8 | p[1]);
+}
+
+bool buildHuffmanTable(HuffmanTable& table, const uint8_t* counts, const uint8_t* symbols) {
+  std::memset(table.fast, 0, sizeof(table.fast));
+  int32_t code = 0, index = 0;
+  for (int length = 1; length <= 16; length++) {
+    table.valueOffset[length] = index - code;
+    for (int i = 0; i < counts[length - 1]; i++, index++, code++) {
+      if (code >= (1 << length)) {
+        return false;
+      }
+      table.symbols[index] = symbols[index];
+      if (length <= FAST_BITS) {
+        int first = code << (FAST_BITS - length);
+        for (int j = 0; j < 1 << (FAST_BITS - length); j++) {
+          table.fast[first + j] = static_cast<uint16_t>(length << 8 | symbols[index]);
+        }
+      }
+    }
+    table.maxCode[length] = counts[length - 1] ? code - 1 : -1;
+    code <<= 1;
+  }
+
+  // a short code followed by a short magnitude decodes in a single lookup
+  for (int i = 0; i < 1 << FAST_BITS; i++) {
+    table.fastAc[i] = 0;
+    int length      = table.fast[i] >> 8;
+    int run         = (table.fast[i] >> 4) & 15;
+    int size        = table.fast[i] & 15;
+    if (length == 0 || size == 0 || length + size > FAST_BITS) {
+      continue;
+    }
+    int32_t magnitude = (i << length & ((1 << FAST_BITS) - 1)) >> (FAST_BITS - size);
+    int32_t value     = magnitude < (1 << (size - 1)) ? magnitude - (1 << size) + 1 : magnitude;
+    if (value >= -128 && value <= 127) {
+      table.fastAc[i] = static_cast<int16_t>(value * 256 + run * 16 + length + size);
+    }
+  }
+
+  table.defined = true;
+  return true;
+}
+
+// -1 for a code that is not in the table
+inline int decodeSymbol(BitReader& reader, const HuffmanTable& table) {
+  if (reader.bits < 32) {
+    reader.refill();
+  }
+  uint16_t entry = table.fast[reader.peek(FAST_BITS)];
+  if (entry) {
+    reader.consume(entry >> 8);
+    return entry & 0xFF;
+  }
+
+  uint32_t code = reader.peek(16);
+  for (int length = FAST_BITS + 1; length <= 16; length++) {
+    int32_t prefix = static_cast<int32_t>(code >> (16 - length));
+    if (prefix <= table.maxCode[length]) {
+      reader.consume(length);
+      return table.symbols[table.valueOffset[length] + prefix];
+    }
+  }
+  return -1;
+}
+
+// reads a size bit magnitude and sign extends it, decodeSymbol left at least 16 bits in the buffer
+inline int receiveExtend(BitReader& reader, int size) {
+  int32_t value = static_cast<int32_t>(reader.peek(size));
+  reader.consume(size);
+  return value < (1 << (size - 1)) ? value - (1 << size) + 1 : value;
+}
+
+// valid 8 bit data stays within 11 bits plus sign, clamping keeps corrupt data from overflowing the IDCT
+inline int32_t dequantize(int32_t value, uint16_t quant) {
+  return std::clamp(value * quant, -2048, 2047);
+}
+
+// coefficients must be zeroed, they come out dequantized in natural order
+bool decodeBlock(BitReader& reader, const HuffmanTable& dcTable, const HuffmanTable& acTable, const uint16_t* quant,
+                 int& dcPredictor, int32_t* coefficients, bool& hasAc) {
+  int size = decodeSymbol(reader, dcTable);
+  if (size < 0 || size > 15) {
+    return false;
+  }
+  if (size > 0) {
+    dcPredictor = std::clamp(dcPredictor + receiveExtend(reader, size), -32768, 32767);
+  }
+  coefficients[0] = dequantize(dcPredictor, quant[0]);
+
+  for (int k = 1; k < 64;) {
+    if (reader.bits < 32) {
+      reader.refill();
+    }
+    int32_t fast = acTable.fastAc[reader.peek(FAST_BITS)];
+    if (fast) {
+      k += (fast >> 4) & 15;
+      if (k > 63) {
+        return false;
+      }
+      reader.consume(fast & 15);
+      coefficients[ZIGZAG[k]] = dequantize(fast >> 8, quant[k]);
+      hasAc                   = true;
+      k++;
+      continue;
+    }
+
+    int symbol = decodeSymbol(reader, acTable);
+    if (symbol < 0) {
+      return false;
+    }
+    int run = symbol >> 4;
+    size    = symbol & 15;
+    if (size == 0) {
+      if (run != 15) {
+        break;  // end of block
+      }
+      k += 16;
+      continue;
+    }
+    k += run;
+    if (k > 63) {
+      return false;
+    }
+    coefficients[ZIGZAG[k]] = dequantize(receiveExtend(reader, size), quant[k]);
+    hasAc                   = true;
+    k++;
+  }
+  return true;
+}
+
+// the islow integer IDCT from libjpeg: 13 bit constants, 2 extra bits of precision between the passes
+const int     CONST_BITS      = 13;
+const int     PASS1_BITS      = 2;
+const int32_t FIX_0_298631336 = 2446;
+const int32_t FIX_0_390180644 = 3196;
+const int32_t FIX_0_541196100 = 4433;
+const int32_t FIX_0_765366865 = 6270;
+const int32_t FIX_0_899976223 = 7373;
+const int32_t FIX_1_175875602 = 9633;
+const int32_t FIX_1_501321110 = 12299;
+const int32_t FIX_1_847759065 = 15137;
+const int32_t FIX_1_961570560 = 16069;
+const int32_t FIX_2_053119869 = 16819;
+const int32_t FIX_2_562915447 = 20995;
+const int32_t FIX_3_072711026 = 25172;
+
+// one dimensional 8 point IDCT, output k is (result + bias) >> shift
+inline void idct8(const int32_t* in, int inStep, int32_t* out, int outStep, int shift, int32_t bias) {
+  int32_t z2   = in[2 * inStep];
+  int32_t z3   = in[6 * inStep];
+  int32_t z1   = (z2 + z3) * FIX_0_541196100;
+  int32_t tmp2 = z1 - z3 * FIX_1_847759065;
+  int32_t tmp3 = z1 + z2 * FIX_0_765366865;
+  int32_t tmp0 = (in[0] + in[4 * inStep]) * (1 << CONST_BITS);
+  int32_t tmp1 = (in[0] - in[4 * inStep]) * (1 << CONST_BITS);
+
+  int32_t tmp10 = tmp0 + tmp3 + bias;
+  int32_t tmp13 = tmp0 - tmp3 + bias;
+  int32_t tmp11 = tmp1 + tmp2 + bias;
+  int32_t tmp12 = tmp1 - tmp2 + bias;
+
+  int32_t odd0 = in[7 * inStep];
+  int32_t odd1 = in[5 * inStep];
+  int32_t odd2 = in[3 * inStep];
+  int32_t odd3 = in[1 * inStep];
+
+  z1         = odd0 + odd3;
+  z2         = odd1 + odd2;
+  z3         = odd0 + odd2;
+  int32_t z4 = odd1 + odd3;
+  int32_t z5 = (z3 + z4) * FIX_1_175875602;
+
+  odd0 *= FIX_0_298631336;
+  odd1 *= FIX_2_053119869;
+  odd2 *= FIX_3_072711026;
+  odd3 *= FIX_1_501321110;
+  z1 *= -FIX_0_899976223;
+  z2 *= -FIX_2_562915447;
+  z3 = z3 * -FIX_1_961570560 + z5;
+  z4 = z4 * -FIX_0_390180644 + z5;
+
+  odd0 += z1 + z3;
+  odd1 += z2 + z4;
+  odd2 += z2 + z3;
+  odd3 += z1 + z4;
+
+  out[0 * outStep] = (tmp10 + odd3) >> shift;
+  out[7 * outStep] = (tmp10 - odd3) >> shift;
+  out[1 * outStep] = (tmp11 + odd2) >> shift;
+  out[6 * outStep] = (tmp11 - odd2) >> shift;
+  out[2 * outStep] = (tmp12 + odd1) >> shift;
+  out[5 * outStep] = (tmp12 - odd1) >> shift;
+  out[3 * outStep] = (tmp13 + odd0) >> shift;
+  out[4 * outStep] = (tmp13 - odd0) >> shift;
+}
+
+inline uint8_t clampSample(int32_t value) {
+  return static_cast<uint8_t>(std::clamp(value, 0, 255));
+}
+
+void inverseDct(const int32_t* coefficients, uint8_t* out, size_t stride) {
+  int32_t workspace[64];
+
+  const int columnShift = CONST_BITS - PASS1_BITS;
+  for (int column = 0; column < 8; column++) {
+    const int32_t* in = coefficients + column;
+    if (!in[8] && !in[16] && !in[24] && !in[32] && !in[40] && !in[48] && !in[56]) {
+      for (int i = 0; i < 8; i++) {
+        workspace[column + 8 * i] = in[0] * (1 << PASS1_BITS);
+      }
+      continue;
+    }
+    idct8(in, 8, workspace + column, 8, columnShift, 1 << (columnShift - 1));
+  }
+
+  // the second pass also removes the factor 8 of the two passes and undoes the level shift
+  const int rowShift = CONST_BITS + PASS1_BITS + 3;
+  int32_t   row[8];
+  for (int y = 0; y < 8; y++) {
+    idct8(workspace + 8 * y, 1, row, 1, rowShift, (1 << (rowShift - 1)) + (128 << rowShift));
+    for (int x = 0; x < 8; x++) {
+      out[y * stride + x] = clampSample(row[x]);
+    }
+  }
+}
+
+// decodes one MCU, its blocks are only transformed and stored when planes is not null
+bool decodeMcu(const Frame& frame, BitReader& reader, int* dcPredictors, uint32_t mcu, uint8_t* const* planes) {
+  uint32_t mcuX = mcu % frame.mcusPerLine;
+  uint32_t mcuY = mcu / frame.mcusPerLine;
+
+  for (int c = 0; c < frame.componentCount; c++) {
+    const Component& component = frame.components[c];
+    for (int by = 0; by < component.v; by++) {
+      for (int bx = 0; bx < component.h; bx++) {
+        int32_t coefficients[64] = {};
+        bool    hasAc            = false;
+        if (!decodeBlock(reader, frame.dc[component.dcTable], frame.ac[component.acTable],
+                         frame.quant[component.quantTable], dcPredictors[c], coefficients, hasAc)) {
+          return false;
+        }
+        if (!planes) {
+          continue;
+        }
+
+        size_t   x   = (static_cast<size_t>(mcuX) * component.h + bx) * 8;
+        size_t   y   = (static_cast<size_t>(mcuY) * component.v + by) * 8;
+        uint8_t* out = planes[c] + y * component.stride + x;
+        if (hasAc) {
+          inverseDct(coefficients, out, component.stride);
+        } else {
+          // flat block, the IDCT reduces to the rounded average
+          uint8_t value = clampSample(128 + ((coefficients[0] + 4) >> 3));
+          for (int row = 0; row < 8; row++) {
+            std::memset(out + row * component.stride, value, 8);
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
+
+bool parseFrame(const uint8_t* segment, size_t length, Frame& frame) {
+  if (frame.componentCount != 0 || length < 6 || segment[0] != 8) {
+    return false;
+  }
+  frame.height         = readU16(segment + 1);
+  frame.width          = readU16(segment + 3);
+  frame.componentCount = segment[5];
+  if (frame.width == 0 || frame.height == 0 || (frame.componentCount != 1 && frame.componentCount != 3) ||
+      length < 6 + 3 * static_cast<size_t>(frame.componentCount)) {
+    return false;  // a zero height needs the DNL marker, which nobody writes
+  }
+
+  for (int c = 0; c < frame.componentCount; c++) {
+    const uint8_t* entry     = segment + 6 + 3 * c;
+    Component&     component = frame.components[c];
+    component.id             = entry[0];
+    component.h              = entry[1] >> 4;
+    component.v              = entry[1] & 15;
+    component.quantTable     = entry[2];
+    if (component.h < 1 || component.h > 4 || component.v < 1 || component.v > 4 || component.quantTable > 3) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool parseHuffmanTables(const uint8_t* segment, size_t length, Frame& frame) {
+  while (length > 0) {
+    if (length < 17) {
+      return false;
+    }
+    int tableClass = segment[0] >> 4;
+    int tableId    = segment[0] & 15;
+    if (tableClass > 1 || tableId > 3) {
+      return false;
+    }
+
+    size_t total = 0;
+    for (int i = 0; i < 16; i++) {
+      total += segment[1 + i];
+    }
+    if (total > 256 || length < 17 + total) {
+      return false;
+    }
+
+    HuffmanTable& table = tableClass == 0 ? frame.dc[tableId] : frame.ac[tableId];
+    if (!buildHuffmanTable(table, segment + 1, segment + 17)) {
+      return false;
+    }
+    segment += 17 + total;
+    length -= 17 + total;
+  }
+  return true;
+}
+
+bool parseQuantTables(const uint8_t* segment, size_t length, Frame& frame) {
+  while (length > 0) {
+    // 16 bit tables are only allowed with 12 bit samples
+    int tableId = segment[0] & 15;
+    if (segment[0] >> 4 != 0 || tableId > 3 || length < 65) {
+      return false;
+    }
+    for (int k = 0; k < 64; k++) {
+      frame.quant[tableId][k] = segment[1 + k];
+    }
+    frame.quantDefined[tableId] = true;
+    segment += 65;
+    length -= 65;
+  }
+  return true;
+}
+
+// only the single interleaved scan of a baseline image is supported, it has to list the components in frame order
+bool parseScan(const uint8_t* segment, size_t length, Frame& frame) {
+  if (frame.componentCount == 0 || length < 1 || segment[0] != frame.componentCount ||
+      length < 4 + 2 * static_cast<size_t>(frame.componentCount)) {
+    return false;
+  }
+
+  for (int c = 0; c < frame.componentCount; c++) {
+    Component& component = frame.components[c];
+    if (segment[1 + 2 * c] != component.id) {
+      return false;
+    }
+    component.dcTable = segment[2 + 2 * c] >> 4;
+    component.acTable = segment[2 + 2 * c] & 15;
+    if (component.dcTable > 3 || component.acTable > 3 || !frame.dc[component.dcTable].defined ||
+        !frame.ac[component.acTable].defined || !frame.quantDefined[component.quantTable]) {
+      return false;
+    }
+  }
+
+  const uint8_t* spectral = segment + 1 + 2 * frame.componentCount;
+  if (spectral[0] != 0 || spectral[1] != 63 || spectral[2] != 0) {
+    return false;
+  }
+
+  // a single component scan is not interleaved, its MCU is one block whatever the sampling factors say
+  if (frame.componentCount == 1) {
+    frame.components[0].h = 1;
+    frame.components[0].v = 1;
+  }
+  for (int c = 0; c < frame.componentCount; c++) {
+    frame.hmax = std::max(frame.hmax, frame.components[c].h);
+    frame.vmax = std::max(frame.vmax, frame.components[c].v);
+  }
+  frame.mcusPerLine   = (frame.width + 8 * frame.hmax - 1) / (8 * frame.hmax);
+  frame.mcusPerColumn = (frame.height + 8 * frame.vmax - 1) / (8 * frame.vmax);
+
+  for (int c = 0; c < frame.componentCount; c++) {
+    Component& component = frame.components[c];
+    if (frame.hmax % component.h != 0 || frame.vmax % component.v != 0) {
+      return false;
+    }
+    component.width  = (frame.width * component.h + frame.hmax - 1) / frame.hmax;
+    component.height = (frame.height * component.v + frame.vmax - 1) / frame.vmax;
+    component.stride = frame.mcusPerLine * component.h * 8;
+    component.rows   = frame.mcusPerColumn * component.v * 8;
+  }
+  return true;
+}
+
+// parses every marker segment up to the start of scan, false for streams decodeJpeg does not handle
+bool parseHeaders(const uint8_t* data, size_t size, Frame& frame) {
+  if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+    return false;
+  }
+
+  const uint8_t* end      = data + size;
+  const uint8_t* position = data + 2;
+  frame.end               = end;
+  while (true) {
+    // markers may be preceded by any number of fill bytes
+    if (position >= end || *position != 0xFF) {
+      return false;
+    }
+    while (position < end && *position == 0xFF) {
+      position++;
+    }
+    if (end - position < 3) {
+      return false;
+    }
+
+    uint8_t marker = *position++;
+    if (marker == 0xD9) {
+      return false;  // no scan at all
+    }
+    size_t length = readU16(position);
+    if (length < 2 || static_cast<size_t>(end - position) < length) {
+      return false;
+    }
+    const uint8_t* segment       = position + 2;
+    size_t         segmentLength = length - 2;
+    position += length;
+
+    bool valid = true;
+    switch (marker) {
+      case 0xC0:  // baseline
+      case 0xC1:  // extended sequential, Huffman coded
+        valid = parseFrame(segment, segmentLength, frame);
+        break;
+      case 0xC4:
+        valid = parseHuffmanTables(segment, segmentLength, frame);
+        break;
+      case 0xDB:
+        valid = parseQuantTables(segment, segmentLength, frame);
+        break;
+      case 0xDD:
+        valid = segmentLength >= 2;
+        if (valid) {
+          frame.restartInterval = readU16(segment);
+        }
+        break;
+      case 0xEE:
+        // Adobe transform 0 means the three components are RGB rather than YCbCr
+        if (segmentLength >= 12 && std::memcmp(segment, "Adobe", 5) == 0) {
+          frame.rgb = segment[11] == 0;
+        }
+        break;
+      case 0xDA:
+        frame.scanBegin = position;
+        return parseScan(segment, segmentLength, frame);
+      default:
+        // progressive, lossless, hierarchical and arithmetic coded frames; APPn, COM and the rest are skipped
+        valid = marker < 0xC2 || marker > 0xCF;
+        break;
+    }
+    if (!valid) {
+      return false;
+    }
+  }
+}
+
+// one segment per restart interval, false when the markers do not match the interval
+bool findRestartSegments(const Frame& frame, std::vector<Segment>& segments) {
+  uint32_t mcuCount = frame.mcusPerLine * frame.mcusPerColumn;
+  uint32_t expected = (mcuCount + frame.restartInterval - 1) / frame.restartInterval;
+
+  const uint8_t* begin    = frame.scanBegin;
+  const uint8_t* position = frame.scanBegin;
+  while (segments.size() < expected) {
+    const uint8_t* marker = static_cast<const uint8_t*>(std::memchr(position, 0xFF, frame.end - position));
+    bool           last   = !marker || marker + 1 >= frame.end || marker[1] < 0xD0 || marker[1] > 0xD7;
+    if (marker && marker + 1 < frame.end && (marker[1] == 0x00 || marker[1] == 0xFF)) {
+      position = marker + 1;  // stuffed byte or fill byte
+      continue;
+    }
+
+    Segment segment  = {};
+    segment.reader   = {begin, marker ? marker : frame.end};
+    segment.firstMcu = static_cast<uint32_t>(segments.size()) * frame.restartInterval;
+    segment.mcuCount = std::min(frame.restartInterval, mcuCount - segment.firstMcu);
+    segments.push_back(segment);
+
+    if (last) {
+      break;
+    }
+    begin = position = marker + 2;
+  }
+  return segments.size() == expected;
+}
+
+// sequential Huffman pass that records the reader state at the start of every MCU row
+bool indexMcuRows(const Frame& frame, std::vector<Segment>& segments) {
+  Segment current = {};
+  current.reader  = {frame.scanBegin, frame.end};
+  segments.reserve(frame.mcusPerColumn);
+
+  for (uint32_t row = 0; row < frame.mcusPerColumn; row++) {
+    current.firstMcu = row * frame.mcusPerLine;
+    current.mcuCount = frame.mcusPerLine;
+    segments.push_back(current);
+    for (uint32_t mcu = current.firstMcu; mcu < current.firstMcu + current.mcuCount; mcu++) {
+      if (!decodeMcu(frame, current.reader, current.dcPredictors, mcu, nullptr)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/*
+One full resolution row of a component, either straight out of its plane or built in scratch. Chroma subsampled by
+two is interpolated with the triangle filter libjpeg calls fancy upsampling, 3/4 of the nearest sample and 1/4 of the
+next nearest; other factors are replicated.
+*/
+const uint8_t* upsampleRow(const Frame& frame, const Component& component, const uint8_t* plane, uint32_t y,
+                           int16_t* columns, uint8_t* scratch) {
+  uint32_t sx = frame.hmax / component.h;
+  uint32_t sy = frame.vmax / component.v;
+
+  uint32_t       row  = y / sy;
+  const uint8_t* near = plane + static_cast<size_t>(row) * component.stride;
+  if (sx == 1 && sy == 1) {
+    return near;
+  }
+
+  // vertical pass into 16 bit columns, scaled by 4 when interpolating
+  const uint8_t* far   = near;
+  int            shift = 0;
+  if (sy == 2) {
+    uint32_t farRow = (y & 1) ? std::min(row + 1, component.height - 1) : (row > 0 ? row - 1 : 0);
+    far             = plane + static_cast<size_t>(farRow) * component.stride;
+    shift           = 2;
+  }
+
+  uint32_t i = 0;
+#ifdef JPEG_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 8 <= component.width; i += 8) {
+    __m128i nearSamples = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(near + i)), zero);
+    __m128i farSamples  = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(far + i)), zero);
+    __m128i sum         = nearSamples;
+    if (sy == 2) {
+      sum = _mm_add_epi16(_mm_add_epi16(nearSamples, nearSamples), _mm_add_epi16(nearSamples, farSamples));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(columns + i), sum);
+  }
+#endif
+  for (; i < component.width; i++) {
+    columns[i] = static_cast<int16_t>(sy == 2 ? 3 * near[i] + far[i] : near[i]);
+  }
+
+  if (sx != 2) {
+    int32_t half = shift > 0 ? 1 << (shift - 1) : 0;
+    for (uint32_t x = 0; x < frame.width; x += sx) {
+      uint8_t value = static_cast<uint8_t>((columns[x / sx] + half) >> shift);
+      for (uint32_t j = x; j < std::min(x + sx, frame.width); j++) {
+        scratch[j] = value;
+      }
+    }
+    return scratch;
+  }
+
+  // horizontal pass, output pixels 2i and 2i + 1 lean towards columns i - 1 and i + 1
+  shift += 2;
+  int32_t  half = 1 << (shift - 1);
+  uint32_t last = component.width - 1;
+  auto     pair = [&](uint32_t c) {
+    int32_t center = 3 * columns[c] + half;
+    scratch[2 * c] = static_cast<uint8_t>((center + columns[c > 0 ? c - 1 : 0]) >> shift);
+    if (2 * c + 1 < frame.width) {
+      scratch[2 * c + 1] = static_cast<uint8_t>((center + columns[c < last ? c + 1 : last]) >> shift);
+    }
+  };
+
+  pair(0);
+  i = 1;
+#ifdef JPEG_SSE2
+  const __m128i bias  = _mm_set1_epi16(static_cast<int16_t>(half));
+  const __m128i count = _mm_cvtsi32_si128(shift);
+  for (; i + 8 <= last; i += 8) {
+    __m128i center = _mm_loadu_si128(reinterpret_cast<const __m128i*>(columns + i));
+    __m128i left   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(columns + i - 1));
+    __m128i right  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(columns + i + 1));
+    center         = _mm_add_epi16(_mm_add_epi16(center, _mm_add_epi16(center, center)), bias);
+    __m128i even   = _mm_sra_epi16(_mm_add_epi16(center, left), count);
+    __m128i odd    = _mm_sra_epi16(_mm_add_epi16(center, right), count);
+    __m128i pixels = _mm_packus_epi16(_mm_unpacklo_epi16(even, odd), _mm_unpackhi_epi16(even, odd));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(scratch + 2 * i), pixels);
+  }
+#endif
+  for (; i <= last; i++) {
+    pair(i);
+  }
+  return scratch;
+}
+
+// JFIF YCbCr to RGBA, the scalar tail rounds exactly like the SSE2 loop
+void convertYCbCr(const uint8_t* luma, const uint8_t* cb, const uint8_t* cr, uint32_t width, uint8_t* out) {
+  uint32_t x = 0;
+#ifdef JPEG_SSE2
+  const __m128i signFlip = _mm_set1_epi8(static_cast<char>(0x80));
+  const __m128i alpha    = _mm_set1_epi16(255);
+  const __m128i zero     = _mm_setzero_si128();
+  const __m128i crToR    = _mm_set1_epi16(static_cast<int16_t>(CR_TO_R));
+  const __m128i crToG    = _mm_set1_epi16(static_cast<int16_t>(CR_TO_G));
+  const __m128i cbToG    = _mm_set1_epi16(static_cast<int16_t>(CB_TO_G));
+  const __m128i cbToB    = _mm_set1_epi16(static_cast<int16_t>(CB_TO_B));
+  for (; x + 8 <= width; x += 8) {
+    // luma becomes y * 16 + 8 and chroma (c - 128) * 256, mulhi then leaves 4 fractional bits
+    __m128i y   = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(luma + x));
+    __m128i u   = _mm_xor_si128(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(cb + x)), signFlip);
+    __m128i v   = _mm_xor_si128(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(cr + x)), signFlip);
+    __m128i yw  = _mm_srli_epi16(_mm_unpacklo_epi8(signFlip, y), 4);
+    __m128i cbw = _mm_unpacklo_epi8(zero, u);
+    __m128i crw = _mm_unpacklo_epi8(zero, v);
+
+    __m128i r = _mm_add_epi16(yw, _mm_mulhi_epi16(crw, crToR));
+    __m128i g = _mm_add_epi16(_mm_add_epi16(yw, _mm_mulhi_epi16(cbw, cbToG)), _mm_mulhi_epi16(crw, crToG));
+    __m128i b = _mm_add_epi16(yw, _mm_mulhi_epi16(cbw, cbToB));
+
+    __m128i rb = _mm_packus_epi16(_mm_srai_epi16(r, 4), _mm_srai_epi16(b, 4));  // r0..r7 b0..b7
+    __m128i ga = _mm_packus_epi16(_mm_srai_epi16(g, 4), alpha);                  // g0..g7 a0..a7
+    __m128i rg = _mm_unpacklo_epi8(rb, ga);
+    __m128i ba = _mm_unpackhi_epi8(rb, ga);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * x), _mm_unpacklo_epi16(rg, ba));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * x + 16), _mm_unpackhi_epi16(rg, ba));
+  }
+#endif
+  for (; x < width; x++) {
+    int32_t yw     = luma[x] * 16 + 8;
+    int32_t cbw    = (cb[x] - 128) * 256;
+    int32_t crw    = (cr[x] - 128) * 256;
+    out[4 * x + 0] = clampSample((yw + ((crw * CR_TO_R) >> 16)) >> 4);
+    out[4 * x + 1] = clampSample((yw + ((cbw * CB_TO_G) >> 16) + ((crw * CR_TO_G) >> 16)) >> 4);
+    out[4 * x + 2] = clampSample((yw + ((cbw * CB_TO_B) >> 16)) >> 4);
+    out[4 * x + 3] = 255;
+  }
+}
+
+// rows are assembled in a local buffer and copied out whole, destination may be write combined
+void convertRows(const Frame& frame, uint8_t* const* planes, uint32_t firstRow, uint32_t lastRow,
+                 uint8_t* destination) {
+  uint32_t             width = frame.width;
+  std::vector<int16_t> columns(width);
+  std::vector<uint8_t> scratch(static_cast<size_t>(width) * frame.componentCount);
+  std::vector<uint8_t> pixels(static_cast<size_t>(width) * 4);
+
+  for (uint32_t y = firstRow; y < lastRow; y++) {
+    const uint8_t* samples[MAX_COMPONENTS];
+    for (int c = 0; c < frame.componentCount; c++) {
+      samples[c] = upsampleRow(frame, frame.components[c], planes[c], y, columns.data(), scratch.data() + c * width);
+    }
+
+    uint8_t* out = pixels.data();
+    if (frame.componentCount == 1) {
+      for (uint32_t x = 0; x < width; x++) {
+        out[4 * x + 0] = samples[0][x];
+        out[4 * x + 1] = samples[0][x];
+        out[4 * x + 2] = samples[0][x];
+        out[4 * x + 3] = 255;
+      }
+    } else if (frame.rgb) {
+      for (uint32_t x = 0; x < width; x++) {
+        out[4 * x + 0] = samples[0][x];
+        out[4 * x + 1] = samples[1][x];
+        out[4 * x + 2] = samples[2][x];
+        out[4 * x + 3] = 255;
+      }
+    } else {
+      convertYCbCr(samples[0], samples[1], samples[2], width, out);
+    }
+    std::memcpy(destination + static_cast<size_t>(y) * width * 4, pixels.data(), pixels.size());
+  }
+}
+
+}  // namespace
+
+bool readJpegInfo(const uint8_t* data, size_t size, uint32_t& width, uint32_t& height) {
+  std::unique_ptr<Frame> frame(new Frame);
+  if (!parseHeaders(data, size, *frame)) {
+    return false;
+  }
+  width  = frame->width;
+  height = frame->height;
+  return true;
+}
+
+bool decodeJpeg(const uint8_t* data, size_t size, uint8_t* destination, unsigned int threadCount) {
+  std::unique_ptr<Frame> frame(new Frame);
+  if (!parseHeaders(data, size, *frame)) {
+    return false;
+  }
+
+  std::vector<Segment> segments;
+  bool valid = frame->restartInterval ? findRestartSegments(*frame, segments) : indexMcuRows(*frame, segments);
+  if (!valid) {
+    return false;
+  }
+
+  // every block lands in its component plane at the component's own resolution, left uninitialized on purpose
+  std::unique_ptr<uint8_t[]> planeStorage[MAX_COMPONENTS];
+  uint8_t*                   planes[MAX_COMPONENTS];
+  for (int c = 0; c < frame->componentCount; c++) {
+    const Component& component = frame->components[c];
+    planeStorage[c].reset(new uint8_t[static_cast<size_t>(component.stride) * component.rows]);
+    planes[c] = planeStorage[c].get();
+  }
+
+  std::atomic<bool> failed(false);
+  parallelFor(segments.size(), [&](size_t s) {
+    Segment segment = segments[s];
+    for (uint32_t mcu = segment.firstMcu; mcu < segment.firstMcu + segment.mcuCount && !failed; mcu++) {
+      if (!decodeMcu(*frame, segment.reader, segment.dcPredictors, mcu, planes)) {
+        failed = true;
+      }
+    }
+  }, threadCount);
+  if (failed) {
+    return false;
+  }
+
+  size_t bands = (frame->height + BAND_ROWS - 1) / BAND_ROWS;
+  parallelFor(bands, [&](size_t band) {
+    uint32_t firstRow = static_cast<uint32_t>(band) * BAND_ROWS;
+    uint32_t lastRow  = std::min(firstRow + BAND_ROWS, frame->height);
+    convertRows(*frame, planes, firstRow, lastRow, destination);
+  }, threadCount);
+  return true;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Reads the size of a JPEG that decodeJpeg can handle: baseline or extended Huffman coded, 8 bit, grayscale or YCbCr
+// in a single interleaved scan. Returns false for anything else (progressive, arithmetic coded, CMYK, multi scan ...)
+// so the caller can fall back to stb_image.
+bool readJpegInfo(const uint8_t* data, size_t size, uint32_t& width, uint32_t& height);
+
+/*
+Decodes a JPEG accepted by readJpegInfo into width x height RGBA8 pixels with alpha 255.
+
+The entropy coded data is split at restart markers when the encoder wrote them. Without them a sequential Huffman pass
+records where every MCU row starts instead, the second pass then decodes, dequantizes and inverse transforms the rows
+again in parallel. Upsampling and color conversion run in row bands. Both stages use threadCount threads (0 = all
+cores). destination is only ever written, row by row, so it may point straight into mapped staging memory.
+
+Returns false when the entropy coded data cannot be decoded, destination is then left partially written.
+*/
+bool decodeJpeg(const uint8_t* data, size_t size, uint8_t* destination, unsigned int threadCount = 0);
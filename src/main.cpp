@@ -1,12 +1,29 @@
-
 #include <iostream>
+#include <stdexcept>
+#include <string>
 
+#include "./benchmark.h"
 #include "./hellotriangleapp.h"
 
-int main() {
-  HelloTriangleApp app;
-
+int main(int argc, char* argv[]) {
   try {
+    if (argc == 3 && std::string(argv[1]) == "--benchmark") {
+      return runBenchmark(argv[2]);
+    }
+
+    HelloTriangleApp app;
+    for (int i = 1; i + 1 < argc; i += 2) {
+      std::string option = argv[i];
+      if (option == "--frame-csv") {
+        app.setFrameStatsCsv(argv[i + 1]);
+      } else if (option == "--headless") {
+        app.setHeadless(static_cast<uint32_t>(std::stoul(argv[i + 1])));
+      } else if (option == "--objects") {
+        app.setObjectCount(static_cast<uint32_t>(std::stoul(argv[i + 1])));
+      } else {
+        throw std::invalid_argument("unknown option: " + option);
+      }
+    }
     app.run();
   } catch (const std::exception& e) {
     std::cerr << e.what() << std::endl;
@@ -0,0 +1,152 @@
+#include "./mappedfile.h"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& filename) {
+  if (!open(filename)) {
+    throw std::runtime_error("failed to open file " + filename + "!");
+  }
+}
+
+MappedFile::~MappedFile() {
+  close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+  *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+  if (this != &other) {
+    close();
+    std::swap(_data, other._data);
+    std::swap(_size, other._size);
+    std::swap(_open, other._open);
+#ifdef _WIN32
+    std::swap(_file, other._file);
+    std::swap(_mapping, other._mapping);
+#endif
+  }
+  return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& filename) {
+  close();
+
+  HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize)) {
+    CloseHandle(file);
+    return false;
+  }
+
+  _file = file;
+  _size = static_cast<size_t>(fileSize.QuadPart);
+  _open = true;
+
+  // empty files cannot be mapped
+  if (_size == 0) {
+    return true;
+  }
+
+  _mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (_mapping == nullptr) {
+    close();
+    return false;
+  }
+
+  _data = static_cast<const char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+  if (_data == nullptr) {
+    close();
+    return false;
+  }
+
+  WIN32_MEMORY_RANGE_ENTRY range = {const_cast<char*>(_data), _size};
+  PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+
+  return true;
+}
+
+void MappedFile::close() {
+  if (_data) UnmapViewOfFile(_data);
+  if (_mapping) CloseHandle(_mapping);
+  if (_file) CloseHandle(_file);
+
+  _data    = nullptr;
+  _mapping = nullptr;
+  _file    = nullptr;
+  _size    = 0;
+  _open    = false;
+}
+
+#else
+
+bool MappedFile::open(const std::string& filename) {
+  close();
+
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0) {
+    ::close(fd);
+    return false;
+  }
+
+  _size = static_cast<size_t>(fileStat.st_size);
+  _open = true;
+
+  // empty files cannot be mapped
+  if (_size == 0) {
+    ::close(fd);
+    return true;
+  }
+
+  void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping keeps its own reference to the file
+  ::close(fd);
+
+  if (data == MAP_FAILED) {
+    close();
+    return false;
+  }
+
+  madvise(data, _size, MADV_SEQUENTIAL);
+  madvise(data, _size, MADV_WILLNEED);
+
+  _data = static_cast<const char*>(data);
+  return true;
+}
+
+void MappedFile::close() {
+  if (_data) {
+    munmap(const_cast<char*>(_data), _size);
+  }
+
+  _data = nullptr;
+  _size = 0;
+  _open = false;
+}
+
+#endif
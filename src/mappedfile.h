@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/*
+Read-only memory mapping of a whole file. The mapping is hinted for sequential access so the kernel reads ahead and
+the data is parsed straight from the page cache instead of being copied into heap buffers first.
+*/
+class MappedFile {
+ public:
+  MappedFile() = default;
+  explicit MappedFile(const std::string& filename);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+
+  // returns false if the file cannot be opened or mapped
+  bool open(const std::string& filename);
+  void close();
+
+  bool isOpen() const {
+    return _open;
+  }
+
+  const char* data() const {
+    return _data;
+  }
+
+  size_t size() const {
+    return _size;
+  }
+
+ private:
+  const char* _data = nullptr;
+  size_t      _size = 0;
+  bool        _open = false;
+
+#ifdef _WIN32
+  void* _file    = nullptr;
+  void* _mapping = nullptr;
+#endif
+};
@@ -0,0 +1,186 @@
+#include "./meshcache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "./parallel.h"
+
+namespace {
+
+const char     MESH_CACHE_MAGIC[8]  = {'V', 'K', 'H', 'T', 'M', 'E', 'S', 'H'};
+const uint32_t MESH_CACHE_VERSION   = 3;  // 2: optimized index order, 3: LOD table
+const size_t   MESH_CACHE_ALIGNMENT = 64;
+const size_t   INDEX_CHECK_CHUNK    = 1 << 20;  // indices one job of the range check scans
+
+struct MeshCacheHeader {
+  char                 magic[8];
+  uint32_t             version;
+  uint32_t             vertexStride;
+  SourceKey            source;
+  uint64_t             vertexCount;
+  uint64_t             vertexOffset;
+  uint64_t             indexCount;
+  uint64_t             indexOffset;
+  uint64_t             lodCount;
+  uint64_t             lodOffset;
+};
+
+size_t alignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// offset + count * elementSize <= fileSize without overflowing, the header fields are untrusted
+bool sectionFits(uint64_t offset, uint64_t count, size_t elementSize, size_t fileSize) {
+  return offset % alignof(uint64_t) == 0 && offset <= fileSize && count <= (fileSize - offset) / elementSize;
+}
+
+// the LOD table covers whole triangles of the index array and starts with the full mesh
+bool validLods(const MeshLod* lods, uint64_t lodCount, uint64_t indexCount) {
+  if (lodCount == 0 || lods[0].firstIndex != 0 || lods[0].indexCount != indexCount) {
+    return false;
+  }
+  for (uint64_t l = 0; l < lodCount; l++) {
+    if (lods[l].firstIndex % 3 != 0 || lods[l].indexCount % 3 != 0 ||
+        uint64_t(lods[l].firstIndex) + lods[l].indexCount > indexCount) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// every index names a cached vertex, meshlet building and the GPU trust them; cheap next to the content hash
+bool indicesInRange(const uint32_t* indices, size_t indexCount, uint64_t vertexCount) {
+  size_t            chunkCount = (indexCount + INDEX_CHECK_CHUNK - 1) / INDEX_CHECK_CHUNK;
+  std::vector<char> inRange(chunkCount, 1);
+  parallelFor(chunkCount, [&](size_t chunk) {
+    size_t end = std::min(indexCount, (chunk + 1) * INDEX_CHECK_CHUNK);
+    for (size_t i = chunk * INDEX_CHECK_CHUNK; i < end; i++) {
+      if (indices[i] >= vertexCount) {
+        inRange[chunk] = 0;
+        return;
+      }
+    }
+  });
+  return std::all_of(inRange.begin(), inRange.end(), [](char chunkInRange) { return chunkInRange != 0; });
+}
+
+const MeshCacheHeader* headerOf(const MappedFile& file) {
+  return reinterpret_cast<const MeshCacheHeader*>(file.data());
+}
+
+}  // namespace
+
+std::string MeshCache::cachePath() const {
+  return _sourcePath + ".meshcache";
+}
+
+bool MeshCache::open(const std::string& sourcePath) {
+  _sourcePath = sourcePath;
+  _valid      = false;
+  _file.close();
+
+  MappedFile source;
+  if (!source.open(sourcePath)) {
+    return false;
+  }
+
+  _key = makeSourceKey(sourcePath, source);
+
+  if (!_file.open(cachePath()) || _file.size() < sizeof(MeshCacheHeader)) {
+    _file.close();
+    return false;
+  }
+
+  MeshCacheHeader header;
+  memcpy(&header, _file.data(), sizeof(header));
+
+  bool valid = memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) == 0 &&
+               header.version == MESH_CACHE_VERSION && header.vertexStride == sizeof(Vertex) &&
+               sameSourceKey(header.source, _key) &&
+               sectionFits(header.vertexOffset, header.vertexCount, sizeof(Vertex), _file.size()) &&
+               sectionFits(header.indexOffset, header.indexCount, sizeof(uint32_t), _file.size()) &&
+               sectionFits(header.lodOffset, header.lodCount, sizeof(MeshLod), _file.size());
+
+  // a truncated or corrupt cache is a miss and gets rebuilt, the contents are checked as well as the sections
+  valid = valid && validLods(reinterpret_cast<const MeshLod*>(_file.data() + header.lodOffset), header.lodCount,
+                             header.indexCount);
+  valid = valid && indicesInRange(reinterpret_cast<const uint32_t*>(_file.data() + header.indexOffset),
+                                  static_cast<size_t>(header.indexCount), header.vertexCount);
+
+  if (!valid) {
+    _file.close();
+    return false;
+  }
+
+  _valid = true;
+  return true;
+}
+
+bool MeshCache::write(const Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+                      const MeshLod* lods, size_t lodCount) {
+  MeshCacheHeader header = {};
+  memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+  header.version      = MESH_CACHE_VERSION;
+  header.vertexStride = sizeof(Vertex);
+  header.source       = _key;
+  header.vertexCount  = vertexCount;
+  header.vertexOffset = alignUp(sizeof(header), MESH_CACHE_ALIGNMENT);
+  header.indexCount   = indexCount;
+  header.indexOffset  = alignUp(header.vertexOffset + vertexCount * sizeof(Vertex), MESH_CACHE_ALIGNMENT);
+  header.lodCount     = lodCount;
+  header.lodOffset    = alignUp(header.indexOffset + indexCount * sizeof(uint32_t), MESH_CACHE_ALIGNMENT);
+
+  // write to a temporary file first so a crash never leaves a truncated cache behind
+  std::string tempPath = cachePath() + ".tmp";
+  {
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      return false;
+    }
+
+    const char padding[MESH_CACHE_ALIGNMENT] = {};
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(padding, header.vertexOffset - sizeof(header));
+    file.write(reinterpret_cast<const char*>(vertices), vertexCount * sizeof(Vertex));
+    file.write(padding, header.indexOffset - (header.vertexOffset + vertexCount * sizeof(Vertex)));
+    file.write(reinterpret_cast<const char*>(indices), indexCount * sizeof(uint32_t));
+    file.write(padding, header.lodOffset - (header.indexOffset + indexCount * sizeof(uint32_t)));
+    file.write(reinterpret_cast<const char*>(lods), lodCount * sizeof(MeshLod));
+
+    if (!file.good()) {
+      return false;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(tempPath, cachePath(), error);
+  return !error;
+}
+
+const Vertex* MeshCache::vertices() const {
+  return _valid ? reinterpret_cast<const Vertex*>(_file.data() + headerOf(_file)->vertexOffset) : nullptr;
+}
+
+size_t MeshCache::vertexCount() const {
+  return _valid ? static_cast<size_t>(headerOf(_file)->vertexCount) : 0;
+}
+
+const uint32_t* MeshCache::indices() const {
+  return _valid ? reinterpret_cast<const uint32_t*>(_file.data() + headerOf(_file)->indexOffset) : nullptr;
+}
+
+size_t MeshCache::indexCount() const {
+  return _valid ? static_cast<size_t>(headerOf(_file)->indexCount) : 0;
+}
+
+const MeshLod* MeshCache::lods() const {
+  return _valid ? reinterpret_cast<const MeshLod*>(_file.data() + headerOf(_file)->lodOffset) : nullptr;
+}
+
+size_t MeshCache::lodCount() const {
+  return _valid ? static_cast<size_t>(headerOf(_file)->lodCount) : 0;
+}
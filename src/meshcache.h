@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "./mappedfile.h"
+#include "./meshsimplifier.h"
+#include "./sourcekey.h"
+#include "./vertex.h"
+
+/*
+Binary cache of the deduplicated vertex and index arrays and the LOD table built from a model file, stored next to
+the model as <model>.meshcache. A cache is only used when its version, the source path, size, modification time and
+content hash all match and its sections, LOD table and indices are consistent; its arrays are then read straight out
+of the mapping.
+*/
+class MeshCache {
+ public:
+  // maps the cache belonging to sourcePath, returns false when it is missing or stale
+  bool open(const std::string& sourcePath);
+
+  // writes a fresh cache for the source passed to open(), returns false on I/O errors
+  bool write(const Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+             const MeshLod* lods, size_t lodCount);
+
+  bool isValid() const {
+    return _valid;
+  }
+
+  const Vertex* vertices() const;
+  size_t        vertexCount() const;
+
+  const uint32_t* indices() const;
+  size_t          indexCount() const;
+
+  // index ranges of the levels of detail inside indices()
+  const MeshLod* lods() const;
+  size_t         lodCount() const;
+
+ private:
+  std::string _sourcePath;
+  SourceKey   _key   = {};  // computed by open() and reused by write()
+  MappedFile  _file;
+  bool        _valid = false;
+
+  std::string cachePath() const;
+};
@@ -0,0 +1,163 @@
+#include "./meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "./parallel.h"
+
+namespace {
+
+const uint32_t NOT_IN_MESHLET = UINT32_MAX;
+
+void computeBounds(Meshlet& meshlet, const Vertex* vertices, const uint32_t* indices) {
+  const uint32_t* first = indices + meshlet.firstIndex;
+  const uint32_t* last  = first + meshlet.indexCount;
+
+  // bounding box center, tight enough for 64 vertices
+  glm::vec3 minimum = vertices[*first].pos, maximum = minimum;
+  for (const uint32_t* index = first; index != last; index++) {
+    minimum = glm::min(minimum, vertices[*index].pos);
+    maximum = glm::max(maximum, vertices[*index].pos);
+  }
+  meshlet.center = (minimum + maximum) * 0.5f;
+  meshlet.radius = 0.0f;
+  for (const uint32_t* index = first; index != last; index++) {
+    meshlet.radius = std::max(meshlet.radius, glm::length(vertices[*index].pos - meshlet.center));
+  }
+
+  // normal cone: the axis is the area weighted average normal, the cutoff follows from the widest deviation
+  glm::vec3 normalSum(0.0f);
+  for (const uint32_t* index = first; index != last; index += 3) {
+    const glm::vec3& p0 = vertices[index[0]].pos;
+    normalSum += glm::cross(vertices[index[1]].pos - p0, vertices[index[2]].pos - p0);
+  }
+
+  float axisLength   = glm::length(normalSum);
+  meshlet.coneAxis   = axisLength > 0.0f ? normalSum / axisLength : glm::vec3(0.0f, 0.0f, 1.0f);
+  meshlet.coneCutoff = 1.0f;
+  if (axisLength <= 0.0f) return;
+
+  float minimumDot = 1.0f;
+  for (const uint32_t* index = first; index != last; index += 3) {
+    const glm::vec3& p0     = vertices[index[0]].pos;
+    glm::vec3        normal = glm::cross(vertices[index[1]].pos - p0, vertices[index[2]].pos - p0);
+    float            length = glm::length(normal);
+    if (length > 0.0f) {
+      minimumDot = std::min(minimumDot, glm::dot(normal / length, meshlet.coneAxis));
+    }
+  }
+
+  // a cone of 90 degrees or more can always be seen from the front
+  if (minimumDot > 0.0f) {
+    meshlet.coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+  }
+}
+
+}  // namespace
+
+std::vector<Meshlet> buildMeshlets(const Vertex* vertices, size_t vertexCount, const uint32_t* indices,
+                                   size_t indexCount) {
+  std::vector<Meshlet>  meshlets;
+  std::vector<uint32_t> owner(vertexCount, NOT_IN_MESHLET);
+
+  Meshlet current         = {};
+  size_t  meshletVertices = 0;
+
+  for (size_t i = 0; i + 2 < indexCount; i += 3) {
+    auto meshletId = static_cast<uint32_t>(meshlets.size());
+
+    size_t newVertices = 0;
+    for (size_t k = 0; k < 3; k++) {
+      bool repeated = (k > 0 && indices[i + k] == indices[i]) || (k > 1 && indices[i + k] == indices[i + 1]);
+      if (owner[indices[i + k]] != meshletId && !repeated) newVertices++;
+    }
+
+    if (meshletVertices + newVertices > MESHLET_MAX_VERTICES || current.indexCount / 3 == MESHLET_MAX_TRIANGLES) {
+      meshlets.push_back(current);
+      meshletId++;
+
+      current            = {};
+      current.firstIndex = static_cast<uint32_t>(i);
+      meshletVertices    = 0;
+    }
+
+    for (size_t k = 0; k < 3; k++) {
+      if (owner[indices[i + k]] != meshletId) {
+        owner[indices[i + k]] = meshletId;
+        meshletVertices++;
+      }
+    }
+    current.indexCount += 3;
+  }
+
+  if (current.indexCount > 0) {
+    meshlets.push_back(current);
+  }
+
+  parallelFor(meshlets.size(), [&](size_t m) { computeBounds(meshlets[m], vertices, indices); });
+
+  return meshlets;
+}
+
+CullingView makeCullingView(const glm::mat4& model, const glm::mat4& view, const glm::mat4& proj) {
+  glm::mat4 modelView = view * model;
+  glm::mat4 clip      = proj * modelView;
+
+  auto row = [&](int r) { return glm::vec4(clip[0][r], clip[1][r], clip[2][r], clip[3][r]); };
+
+  // Gribb/Hartmann plane extraction for a [0, 1] depth range
+  CullingView result;
+  result.planes[0] = row(3) + row(0);
+  result.planes[1] = row(3) - row(0);
+  result.planes[2] = row(3) + row(1);
+  result.planes[3] = row(3) - row(1);
+  result.planes[4] = row(2);
+  result.planes[5] = row(3) - row(2);
+
+  for (auto& plane : result.planes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+
+  result.eye = glm::vec3(glm::inverse(modelView) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+  return result;
+}
+
+bool isMeshletVisible(const Meshlet& meshlet, const CullingView& view) {
+  for (const auto& plane : view.planes) {
+    if (glm::dot(glm::vec3(plane), meshlet.center) + plane.w < -meshlet.radius) {
+      return false;
+    }
+  }
+
+  glm::vec3 toCenter = meshlet.center - view.eye;
+  return glm::dot(toCenter, meshlet.coneAxis) < meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius;
+}
+
+size_t cullMeshlets(const Meshlet* meshlets, size_t meshletCount, const CullingView& view,
+                    VkDrawIndexedIndirectCommand* commands) {
+  // commands usually points into write combined memory, so it is only ever written
+  VkDrawIndexedIndirectCommand pending = {};
+  pending.instanceCount                = 1;
+
+  size_t count = 0;
+  for (size_t m = 0; m < meshletCount; m++) {
+    const Meshlet& meshlet = meshlets[m];
+    if (!isMeshletVisible(meshlet, view)) continue;
+
+    if (pending.indexCount > 0 && pending.firstIndex + pending.indexCount == meshlet.firstIndex) {
+      pending.indexCount += meshlet.indexCount;
+      continue;
+    }
+
+    if (pending.indexCount > 0) {
+      commands[count++] = pending;
+    }
+    pending.firstIndex = meshlet.firstIndex;
+    pending.indexCount = meshlet.indexCount;
+  }
+
+  if (pending.indexCount > 0) {
+    commands[count++] = pending;
+  }
+  return count;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "./vertex.h"
+
+const size_t MESHLET_MAX_VERTICES  = 64;
+const size_t MESHLET_MAX_TRIANGLES = 124;
+
+/*
+A run of consecutive triangles in the index buffer, so every meshlet can be drawn as one indexed draw without
+rewriting the indices. Bounds are in model space.
+*/
+struct Meshlet {
+  uint32_t firstIndex;
+  uint32_t indexCount;
+
+  glm::vec3 center;
+  float     radius;
+
+  // back facing for every eye with dot(center - eye, coneAxis) >= coneCutoff * length(center - eye) + radius,
+  // a cutoff of 1 never culls
+  glm::vec3 coneAxis;
+  float     coneCutoff;
+};
+
+// Splits the triangle list greedily in index order, run optimizeVertexCache first for compact meshlets.
+std::vector<Meshlet> buildMeshlets(const Vertex* vertices, size_t vertexCount, const uint32_t* indices,
+                                   size_t indexCount);
+
+// Frustum planes and eye position in model space, valid for rigid model transforms only.
+struct CullingView {
+  glm::vec4 planes[6];  // xyz points inwards, normalized
+  glm::vec3 eye;
+};
+
+CullingView makeCullingView(const glm::mat4& model, const glm::mat4& view, const glm::mat4& proj);
+
+bool isMeshletVisible(const Meshlet& meshlet, const CullingView& view);
+
+/*
+Writes one indexed indirect draw per run of visible meshlets, adjacent meshlets share a draw since their index
+ranges are contiguous. Returns the number of commands written, at most meshletCount.
+*/
+size_t cullMeshlets(const Meshlet* meshlets, size_t meshletCount, const CullingView& view,
+                    VkDrawIndexedIndirectCommand* commands);
@@ -0,0 +1,269 @@
+#include "./meshoptimizer.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+const uint32_t NO_VERTEX = UINT32_MAX;
+
+// triangles using every vertex, in compressed row layout
+struct TriangleAdjacency {
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> triangles;
+  std::vector<uint32_t> liveCounts;
+};
+
+TriangleAdjacency buildAdjacency(const std::vector<uint32_t>& indices, size_t vertexCount) {
+  TriangleAdjacency adjacency;
+  adjacency.liveCounts.assign(vertexCount, 0);
+  adjacency.offsets.assign(vertexCount + 1, 0);
+  adjacency.triangles.resize(indices.size());
+
+  for (uint32_t index : indices) {
+    adjacency.liveCounts[index]++;
+  }
+  for (size_t v = 0; v < vertexCount; v++) {
+    adjacency.offsets[v + 1] = adjacency.offsets[v] + adjacency.liveCounts[v];
+  }
+
+  std::vector<uint32_t> cursor(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+  for (size_t i = 0; i < indices.size(); i++) {
+    adjacency.triangles[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+  }
+
+  return adjacency;
+}
+
+}  // namespace
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                                    unsigned int cacheSize) {
+  std::vector<uint32_t> timestamps(vertexCount, 0);
+  std::vector<bool>     referenced(vertexCount, false);
+
+  // a vertex is in the FIFO when fewer than cacheSize misses happened since it was loaded
+  uint32_t time       = cacheSize + 1;
+  size_t   misses     = 0;
+  size_t   uniqueUsed = 0;
+  for (size_t i = 0; i < indexCount; i++) {
+    uint32_t index = indices[i];
+    if (time - timestamps[index] > cacheSize) {
+      timestamps[index] = time++;
+      misses++;
+    }
+    if (!referenced[index]) {
+      referenced[index] = true;
+      uniqueUsed++;
+    }
+  }
+
+  VertexCacheStats stats;
+  stats.acmr = indexCount > 0 ? static_cast<float>(misses) / static_cast<float>(indexCount / 3) : 0.0f;
+  stats.atvr = uniqueUsed > 0 ? static_cast<float>(misses) / static_cast<float>(uniqueUsed) : 0.0f;
+  return stats;
+}
+
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>* clusters,
+                         unsigned int cacheSize) {
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0) return;
+
+  TriangleAdjacency adjacency = buildAdjacency(indices, vertexCount);
+
+  std::vector<uint32_t> timestamps(vertexCount, 0);
+  std::vector<bool>     emitted(triangleCount, false);
+  std::vector<uint32_t> deadEnds;
+  std::vector<uint32_t> candidates;
+  std::vector<uint32_t> result;
+  result.reserve(indices.size());
+
+  uint32_t time       = cacheSize + 1;
+  uint32_t scanCursor = 0;
+  uint32_t fanning    = indices[0];
+
+  if (clusters) {
+    clusters->assign(1, 0);
+  }
+
+  while (fanning != NO_VERTEX) {
+    candidates.clear();
+
+    // emit every live triangle around the fanning vertex
+    for (uint32_t k = adjacency.offsets[fanning]; k < adjacency.offsets[fanning + 1]; k++) {
+      uint32_t triangle = adjacency.triangles[k];
+      if (emitted[triangle]) continue;
+
+      for (int corner = 0; corner < 3; corner++) {
+        uint32_t v = indices[3 * triangle + corner];
+        result.push_back(v);
+        deadEnds.push_back(v);
+        candidates.push_back(v);
+        adjacency.liveCounts[v]--;
+
+        if (time - timestamps[v] > cacheSize) {
+          timestamps[v] = time++;
+        }
+      }
+      emitted[triangle] = true;
+    }
+
+    // continue with the candidate that stays in the cache longest while its remaining fan still fits
+    uint32_t next     = NO_VERTEX;
+    int      priority = -1;
+    for (uint32_t v : candidates) {
+      if (adjacency.liveCounts[v] == 0) continue;
+
+      int candidatePriority = 0;
+      if (time - timestamps[v] + 2 * adjacency.liveCounts[v] <= cacheSize) {
+        candidatePriority = static_cast<int>(time - timestamps[v]);
+      }
+      if (candidatePriority > priority) {
+        priority = candidatePriority;
+        next     = v;
+      }
+    }
+
+    if (next == NO_VERTEX) {
+      // dead end: back up through recently emitted vertices, then scan for any vertex with live triangles
+      while (!deadEnds.empty() && next == NO_VERTEX) {
+        uint32_t v = deadEnds.back();
+        deadEnds.pop_back();
+        if (adjacency.liveCounts[v] > 0) next = v;
+      }
+      while (scanCursor < vertexCount && next == NO_VERTEX) {
+        if (adjacency.liveCounts[scanCursor] > 0) next = scanCursor;
+        scanCursor++;
+      }
+
+      if (clusters && next != NO_VERTEX) {
+        clusters->push_back(static_cast<uint32_t>(result.size() / 3));
+      }
+    }
+
+    fanning = next;
+  }
+
+  indices.swap(result);
+}
+
+void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices,
+                      const std::vector<uint32_t>& clusters, float threshold, unsigned int cacheSize) {
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0) return;
+
+  // soft boundaries: cut a cluster wherever its running ACMR drops below the threshold
+  std::vector<uint32_t> timestamps(vertices.size(), 0);
+  std::vector<uint32_t> splits;
+  uint32_t              time = cacheSize + 1;
+
+  auto triangleMisses = [&](size_t triangle) {
+    unsigned int misses = 0;
+    for (int corner = 0; corner < 3; corner++) {
+      uint32_t v = indices[3 * triangle + corner];
+      if (time - timestamps[v] > cacheSize) {
+        timestamps[v] = time++;
+        misses++;
+      }
+    }
+    return misses;
+  };
+
+  for (size_t c = 0; c < clusters.size(); c++) {
+    size_t begin = clusters[c];
+    size_t end   = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+    if (begin >= end) continue;
+
+    time += cacheSize + 1;
+    size_t clusterMisses = 0;
+    for (size_t t = begin; t < end; t++) {
+      clusterMisses += triangleMisses(t);
+    }
+    float clusterThreshold = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - begin);
+
+    time += cacheSize + 1;
+    splits.push_back(static_cast<uint32_t>(begin));
+    size_t runningMisses = 0, runningTriangles = 0;
+    for (size_t t = begin; t < end; t++) {
+      runningMisses += triangleMisses(t);
+      runningTriangles++;
+
+      if (t + 1 < end && static_cast<float>(runningMisses) / static_cast<float>(runningTriangles) <= clusterThreshold) {
+        // the next cluster may be drawn after any other one, so it starts with a cold cache
+        splits.push_back(static_cast<uint32_t>(t + 1));
+        runningMisses = runningTriangles = 0;
+        time += cacheSize + 1;
+      }
+    }
+  }
+
+  glm::vec3 meshCenter(0.0f);
+  for (const auto& vertex : vertices) {
+    meshCenter += vertex.pos;
+  }
+  meshCenter /= static_cast<float>(std::max<size_t>(1, vertices.size()));
+
+  // area weighted centroid and normal of every cluster
+  std::vector<float> sortKeys(splits.size());
+  for (size_t c = 0; c < splits.size(); c++) {
+    size_t begin = splits[c];
+    size_t end   = c + 1 < splits.size() ? splits[c + 1] : triangleCount;
+
+    glm::vec3 centroid(0.0f), normal(0.0f);
+    float     area = 0.0f;
+    for (size_t t = begin; t < end; t++) {
+      const glm::vec3& p0 = vertices[indices[3 * t + 0]].pos;
+      const glm::vec3& p1 = vertices[indices[3 * t + 1]].pos;
+      const glm::vec3& p2 = vertices[indices[3 * t + 2]].pos;
+
+      glm::vec3 n            = glm::cross(p1 - p0, p2 - p0);
+      float     triangleArea = glm::length(n);
+      centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+      normal += n;
+      area += triangleArea;
+    }
+
+    if (area > 0.0f) centroid /= area;
+    float normalLength = glm::length(normal);
+    if (normalLength > 0.0f) normal /= normalLength;
+
+    sortKeys[c] = glm::dot(centroid - meshCenter, normal);
+  }
+
+  std::vector<uint32_t> order(splits.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+  std::vector<uint32_t> result;
+  result.reserve(indices.size());
+  for (uint32_t c : order) {
+    size_t begin = splits[c];
+    size_t end   = c + 1 < splits.size() ? splits[c + 1] : triangleCount;
+    result.insert(result.end(), indices.begin() + 3 * begin, indices.begin() + 3 * end);
+  }
+
+  indices.swap(result);
+}
+
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+  std::vector<uint32_t> remap(vertices.size(), NO_VERTEX);
+  std::vector<Vertex>   result;
+  result.reserve(vertices.size());
+
+  for (uint32_t& index : indices) {
+    if (remap[index] == NO_VERTEX) {
+      remap[index] = static_cast<uint32_t>(result.size());
+      result.push_back(vertices[index]);
+    }
+    index = remap[index];
+  }
+
+  vertices.swap(result);
+}
+
+void optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+  std::vector<uint32_t> clusters;
+  optimizeVertexCache(indices, vertices.size(), &clusters);
+  optimizeOverdraw(indices, vertices, clusters);
+  optimizeVertexFetch(vertices, indices);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "./vertex.h"
+
+// FIFO size of the post-transform cache simulated by the optimizer and by analyzeVertexCache
+const unsigned int VERTEX_CACHE_SIZE = 16;
+
+struct VertexCacheStats {
+  float acmr = 0.0f;  // transformed vertices per triangle, 0.5 is the optimum for large regular meshes
+  float atvr = 0.0f;  // transformed vertices per referenced vertex, 1.0 is the optimum
+};
+
+// Simulates a FIFO post-transform cache over the triangle list.
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                                    unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+/*
+Reorders triangles for post-transform cache locality (Tipsify, Sander et al. 2007). The start of every cluster the
+walk had to restart from a dead end is appended to clusters when it is given, optimizeOverdraw sorts those.
+*/
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>* clusters = nullptr,
+                         unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+/*
+Splits the clusters of optimizeVertexCache further where that costs at most threshold times their ACMR, then sorts
+them front to back by how much they face away from the mesh center, so outer surfaces are drawn first from most
+view directions.
+*/
+void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices,
+                      const std::vector<uint32_t>& clusters, float threshold = 1.05f,
+                      unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+// Reorders vertices by first use in the index buffer and remaps the indices, unreferenced vertices are dropped.
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+// Runs the three passes above in order.
+void optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
@@ -0,0 +1,326 @@
+#include "./meshsimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "./meshoptimizer.h"
+
+namespace {
+
+const uint32_t NO_VERTEX = UINT32_MAX;
+
+// a chain level has to drop at least this share of the previous level's triangles
+const float MIN_LOD_REDUCTION = 0.1f;
+
+// symmetric 4x4 error quadric, error(p) = p^T A p + 2 b^T p + c
+struct Quadric {
+  float a00, a01, a02, a11, a12, a22;
+  float b0, b1, b2;
+  float c;
+};
+
+void addPlane(Quadric& q, const glm::vec3& n, float d) {
+  q.a00 += n.x * n.x;
+  q.a01 += n.x * n.y;
+  q.a02 += n.x * n.z;
+  q.a11 += n.y * n.y;
+  q.a12 += n.y * n.z;
+  q.a22 += n.z * n.z;
+  q.b0 += n.x * d;
+  q.b1 += n.y * d;
+  q.b2 += n.z * d;
+  q.c += d * d;
+}
+
+void addQuadric(Quadric& q, const Quadric& other) {
+  q.a00 += other.a00;
+  q.a01 += other.a01;
+  q.a02 += other.a02;
+  q.a11 += other.a11;
+  q.a12 += other.a12;
+  q.a22 += other.a22;
+  q.b0 += other.b0;
+  q.b1 += other.b1;
+  q.b2 += other.b2;
+  q.c += other.c;
+}
+
+float evaluate(const Quadric& q, const glm::vec3& p) {
+  float error = q.a00 * p.x * p.x + 2.0f * q.a01 * p.x * p.y + 2.0f * q.a02 * p.x * p.z + q.a11 * p.y * p.y +
+                2.0f * q.a12 * p.y * p.z + q.a22 * p.z * p.z + 2.0f * (q.b0 * p.x + q.b1 * p.y + q.b2 * p.z) + q.c;
+  return std::max(error, 0.0f);
+}
+
+// triangles around every position, in compressed row layout
+struct PositionAdjacency {
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> triangles;
+};
+
+void buildAdjacency(PositionAdjacency& adjacency, const std::vector<uint32_t>& indices,
+                    const std::vector<uint32_t>& canonical) {
+  adjacency.offsets.assign(canonical.size() + 1, 0);
+  for (uint32_t index : indices) {
+    adjacency.offsets[canonical[index] + 1]++;
+  }
+  std::partial_sum(adjacency.offsets.begin(), adjacency.offsets.end(), adjacency.offsets.begin());
+
+  adjacency.triangles.resize(indices.size());
+  std::vector<uint32_t> cursor(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+  for (size_t i = 0; i < indices.size(); i++) {
+    adjacency.triangles[cursor[canonical[indices[i]]]++] = static_cast<uint32_t>(i / 3);
+  }
+}
+
+struct Collapse {
+  uint32_t from;  // canonical positions
+  uint32_t to;
+  float    cost;
+};
+
+}  // namespace
+
+float simplifyMesh(std::vector<uint32_t>& destination, const Vertex* vertices, size_t vertexCount,
+                   const uint32_t* indices, size_t indexCount, size_t targetIndexCount) {
+  destination.assign(indices, indices + indexCount);
+  if (indexCount <= targetIndexCount || indexCount == 0) return 0.0f;
+
+  // work in the unit cube so float quadrics stay precise
+  glm::vec3 minimum = vertices[indices[0]].pos, maximum = minimum;
+  for (size_t i = 0; i < indexCount; i++) {
+    minimum = glm::min(minimum, vertices[indices[i]].pos);
+    maximum = glm::max(maximum, vertices[indices[i]].pos);
+  }
+  glm::vec3 extent = maximum - minimum;
+  float     scale  = 1.0f / std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-12f));
+
+  std::vector<glm::vec3> positions(vertexCount);
+  for (size_t v = 0; v < vertexCount; v++) {
+    positions[v] = (vertices[v].pos - minimum) * scale;
+  }
+
+  // vertices sharing a position (UV seams) map to one canonical vertex, wedges counts the referenced ones
+  std::vector<bool> referenced(vertexCount, false);
+  for (size_t i = 0; i < indexCount; i++) {
+    referenced[indices[i]] = true;
+  }
+
+  std::vector<uint32_t> order(vertexCount);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    const glm::vec3& pa = vertices[a].pos;
+    const glm::vec3& pb = vertices[b].pos;
+    if (pa.x != pb.x) return pa.x < pb.x;
+    if (pa.y != pb.y) return pa.y < pb.y;
+    if (pa.z != pb.z) return pa.z < pb.z;
+    return a < b;
+  });
+
+  std::vector<uint32_t> canonical(vertexCount);
+  std::vector<uint32_t> wedges(vertexCount, 0);
+  for (size_t k = 0; k < vertexCount; k++) {
+    uint32_t v    = order[k];
+    bool     same = k > 0 && vertices[order[k - 1]].pos == vertices[v].pos;
+    canonical[v]  = same ? canonical[order[k - 1]] : v;
+    if (referenced[v]) wedges[canonical[v]]++;
+  }
+
+  auto isDegenerate = [&](const uint32_t* triangle) {
+    uint32_t c0 = canonical[triangle[0]], c1 = canonical[triangle[1]], c2 = canonical[triangle[2]];
+    return c0 == c1 || c1 == c2 || c0 == c2;
+  };
+
+  auto removeDegenerates = [&]() {
+    size_t write = 0;
+    for (size_t i = 0; i < destination.size(); i += 3) {
+      if (isDegenerate(&destination[i])) continue;
+      std::copy(destination.begin() + i, destination.begin() + i + 3, destination.begin() + write);
+      write += 3;
+    }
+    destination.resize(write);
+  };
+
+  removeDegenerates();
+
+  PositionAdjacency adjacency;
+  buildAdjacency(adjacency, destination, canonical);
+
+  // seams and open borders stay locked, an edge a->b is on a border when no triangle has b->a
+  std::vector<bool> locked(vertexCount, false);
+  for (size_t v = 0; v < vertexCount; v++) {
+    locked[v] = wedges[v] > 1;
+  }
+  for (size_t t = 0; t < destination.size() / 3; t++) {
+    for (int k = 0; k < 3; k++) {
+      uint32_t a = canonical[destination[3 * t + k]];
+      uint32_t b = canonical[destination[3 * t + (k + 1) % 3]];
+
+      bool opposite = false;
+      for (uint32_t j = adjacency.offsets[b]; j < adjacency.offsets[b + 1] && !opposite; j++) {
+        const uint32_t* other = &destination[3 * adjacency.triangles[j]];
+        for (int e = 0; e < 3 && !opposite; e++) {
+          opposite = canonical[other[e]] == b && canonical[other[(e + 1) % 3]] == a;
+        }
+      }
+      if (!opposite) {
+        locked[a] = true;
+        locked[b] = true;
+      }
+    }
+  }
+
+  std::vector<Quadric> quadrics(vertexCount, Quadric{});
+  for (size_t i = 0; i < destination.size(); i += 3) {
+    const glm::vec3& p0     = positions[destination[i + 0]];
+    glm::vec3        normal = glm::cross(positions[destination[i + 1]] - p0, positions[destination[i + 2]] - p0);
+    float            length = glm::length(normal);
+    if (length <= 0.0f) continue;
+
+    normal /= length;
+    float d = -glm::dot(normal, p0);
+    for (int k = 0; k < 3; k++) {
+      addPlane(quadrics[canonical[destination[i + k]]], normal, d);
+    }
+  }
+
+  std::vector<uint32_t> remap(vertexCount);
+  std::vector<bool>     touched(vertexCount);
+  std::vector<Collapse> collapses;
+  float                 maxError = 0.0f;
+
+  while (destination.size() > targetIndexCount) {
+    buildAdjacency(adjacency, destination, canonical);
+
+    // cheapest direction of every interior edge, each edge is seen from both of its triangles so keep a < b
+    collapses.clear();
+    for (size_t i = 0; i < destination.size(); i += 3) {
+      for (int k = 0; k < 3; k++) {
+        uint32_t a = canonical[destination[i + k]];
+        uint32_t b = canonical[destination[i + (k + 1) % 3]];
+        if (a > b || (locked[a] && locked[b])) continue;
+
+        float costAB = locked[a] ? INFINITY : evaluate(quadrics[a], positions[b]);
+        float costBA = locked[b] ? INFINITY : evaluate(quadrics[b], positions[a]);
+        collapses.push_back(costAB <= costBA ? Collapse{a, b, costAB} : Collapse{b, a, costBA});
+      }
+    }
+    if (collapses.empty()) break;
+
+    std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+    std::iota(remap.begin(), remap.end(), 0);
+    std::fill(touched.begin(), touched.end(), false);
+
+    size_t trianglesToRemove = (destination.size() - targetIndexCount) / 3;
+    size_t trianglesRemoved  = 0;
+    size_t applied           = 0;
+
+    for (const Collapse& collapse : collapses) {
+      if (trianglesRemoved >= trianglesToRemove) break;
+      if (touched[collapse.from] || touched[collapse.to]) continue;
+
+      // the moved vertex has a single wedge; the target wedge has to be the same in every shared triangle
+      uint32_t fromVertex = NO_VERTEX, toVertex = NO_VERTEX;
+      size_t   shared     = 0;
+      bool     valid      = true;
+      for (uint32_t j = adjacency.offsets[collapse.from]; j < adjacency.offsets[collapse.from + 1] && valid; j++) {
+        const uint32_t* triangle = &destination[3 * adjacency.triangles[j]];
+
+        int fromCorner = -1, toCorner = -1;
+        for (int k = 0; k < 3; k++) {
+          if (canonical[triangle[k]] == collapse.from) fromCorner = k;
+          if (canonical[triangle[k]] == collapse.to) toCorner = k;
+        }
+        fromVertex = triangle[fromCorner];
+
+        if (toCorner >= 0) {
+          valid    = toVertex == NO_VERTEX || toVertex == triangle[toCorner];
+          toVertex = triangle[toCorner];
+          shared++;
+          continue;
+        }
+
+        // triangles that survive must not flip
+        glm::vec3 before[3], after[3];
+        for (int k = 0; k < 3; k++) {
+          before[k] = positions[triangle[k]];
+          after[k]  = k == fromCorner ? positions[collapse.to] : before[k];
+        }
+        glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+        glm::vec3 normalAfter  = glm::cross(after[1] - after[0], after[2] - after[0]);
+        valid = glm::dot(normalBefore, normalAfter) > 0.0f;
+      }
+      if (!valid || toVertex == NO_VERTEX) continue;
+
+      remap[fromVertex] = toVertex;
+      addQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+      maxError = std::max(maxError, collapse.cost);
+
+      // the one ring has been validated against static neighbors, keep it static for the rest of the pass
+      for (uint32_t j = adjacency.offsets[collapse.from]; j < adjacency.offsets[collapse.from + 1]; j++) {
+        const uint32_t* triangle = &destination[3 * adjacency.triangles[j]];
+        for (int k = 0; k < 3; k++) {
+          touched[canonical[triangle[k]]] = true;
+        }
+      }
+
+      trianglesRemoved += shared;
+      applied++;
+    }
+
+    if (applied == 0) break;
+
+    for (uint32_t& index : destination) {
+      index = remap[index];
+    }
+    for (size_t v = 0; v < vertexCount; v++) {
+      if (remap[v] != v) canonical[v] = canonical[remap[v]];
+    }
+    removeDegenerates();
+  }
+
+  return std::sqrt(maxError) / scale;
+}
+
+void buildLodChain(const Vertex* vertices, size_t vertexCount, std::vector<uint32_t>& indices,
+                   std::vector<MeshLod>& lods, size_t maxLods) {
+  lods.clear();
+  lods.push_back({0, static_cast<uint32_t>(indices.size()), 0.0f});
+
+  std::vector<uint32_t> source(indices.begin(), indices.end());
+  std::vector<uint32_t> simplified;
+
+  while (lods.size() < maxLods) {
+    const MeshLod& previous = lods.back();
+    size_t         target   = source.size() / 6 * 3;
+
+    float error = simplifyMesh(simplified, vertices, vertexCount, source.data(), source.size(), target);
+    if (simplified.empty() || static_cast<float>(simplified.size()) > (1.0f - MIN_LOD_REDUCTION) * source.size()) {
+      break;
+    }
+
+    optimizeVertexCache(simplified, vertexCount);
+
+    // every level is simplified from the previous one, so the errors add up
+    MeshLod lod;
+    lod.firstIndex = static_cast<uint32_t>(indices.size());
+    lod.indexCount = static_cast<uint32_t>(simplified.size());
+    lod.error      = previous.error + error;
+
+    indices.insert(indices.end(), simplified.begin(), simplified.end());
+    lods.push_back(lod);
+    source.swap(simplified);
+  }
+}
+
+size_t selectLod(const MeshLod* lods, size_t lodCount, float distance, float projectionScale, float maxPixelError) {
+  // the camera is inside the bounds, errors grow with the level so the first miss ends the search
+  if (distance <= 0.0f) return 0;
+
+  size_t selected = 0;
+  for (size_t l = 1; l < lodCount && lods[l].error * projectionScale / distance <= maxPixelError; l++) {
+    selected = l;
+  }
+  return selected;
+}
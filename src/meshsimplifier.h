@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "./vertex.h"
+
+// One level of detail, all levels index the same vertex buffer.
+struct MeshLod {
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  float    error;  // upper bound of the deviation from the full mesh in model units
+};
+
+/*
+Quadric error metric edge collapse (Garland and Heckbert 1997) towards targetIndexCount. Vertices only move onto
+existing vertices, so the result indexes the same vertex buffer. Vertices on open borders and UV seams are kept in
+place so the texture layout does not tear. Returns the error of the result in model units.
+*/
+float simplifyMesh(std::vector<uint32_t>& destination, const Vertex* vertices, size_t vertexCount,
+                   const uint32_t* indices, size_t indexCount, size_t targetIndexCount);
+
+/*
+Appends up to maxLods - 1 simplified levels, each with half the triangles of the previous one, to indices. lods
+receives the full mesh as level 0 followed by the generated levels. The chain stops early once a level no longer
+shrinks noticeably.
+*/
+void buildLodChain(const Vertex* vertices, size_t vertexCount, std::vector<uint32_t>& indices,
+                   std::vector<MeshLod>& lods, size_t maxLods = 6);
+
+/*
+Picks the coarsest level whose error, projected at distance, stays within maxPixelError. projectionScale converts a
+size at distance 1 into pixels, 0.5 * viewportHeight * proj[1][1] for a perspective projection.
+*/
+size_t selectLod(const MeshLod* lods, size_t lodCount, float distance, float projectionScale, float maxPixelError);
@@ -0,0 +1,278 @@
+#include "./mipmap.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "./parallel.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIPMAP_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const size_t   MAX_TAPS        = 8;
+const uint32_t BAND_ROWS       = 32;
+const int      ENCODE_LUT_BITS = 12;
+const int      ENCODE_LUT_SIZE = 1 << ENCODE_LUT_BITS;
+
+// 2:1 separable kernel, destination pixel x reads source pixels 2x + first ... 2x + first + taps - 1
+struct Kernel {
+  int   first;
+  int   taps;
+  float weights[MAX_TAPS];
+};
+
+float sinc(float x) {
+  const float pi = 3.14159265f;
+  return x == 0.0f ? 1.0f : std::sin(pi * x) / (pi * x);
+}
+
+// zeroth order modified Bessel function of the first kind
+float besselI0(float x) {
+  float sum = 1.0f, term = 1.0f;
+  for (int k = 1; k < 16; k++) {
+    term *= (x * x) / (4.0f * k * k);
+    sum += term;
+  }
+  return sum;
+}
+
+Kernel makeKernel(MipFilter filter) {
+  Kernel kernel = {};
+  if (filter == MipFilter::Box) {
+    kernel.first      = 0;
+    kernel.taps       = 2;
+    kernel.weights[0] = 0.5f;
+    kernel.weights[1] = 0.5f;
+    return kernel;
+  }
+
+  // the destination center lies between source pixels 2x and 2x + 1, so the taps sit at -3.5 ... 3.5
+  const float alpha  = 4.0f;
+  const float radius = 4.0f;
+  kernel.first       = -3;
+  kernel.taps        = 8;
+
+  float sum = 0.0f;
+  for (int k = 0; k < kernel.taps; k++) {
+    float x           = kernel.first + k - 0.5f;
+    float window      = besselI0(alpha * std::sqrt(std::max(0.0f, 1.0f - (x / radius) * (x / radius)))) / besselI0(alpha);
+    kernel.weights[k] = sinc(x * 0.5f) * window;
+    sum += kernel.weights[k];
+  }
+  for (int k = 0; k < kernel.taps; k++) {
+    kernel.weights[k] /= sum;
+  }
+  return kernel;
+}
+
+float srgbToLinear(float value) {
+  return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+float linearToSrgb(float value) {
+  return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+struct ColorTables {
+  float   decode[256];              // sRGB byte to linear
+  uint8_t encode[ENCODE_LUT_SIZE];  // linear quantized to 12 bits to sRGB byte
+
+  ColorTables() {
+    for (int i = 0; i < 256; i++) {
+      decode[i] = srgbToLinear(i / 255.0f);
+    }
+    for (int i = 0; i < ENCODE_LUT_SIZE; i++) {
+      encode[i] = static_cast<uint8_t>(linearToSrgb(i / float(ENCODE_LUT_SIZE - 1)) * 255.0f + 0.5f);
+    }
+  }
+};
+
+const ColorTables& colorTables() {
+  static const ColorTables tables;
+  return tables;
+}
+
+void decodeRow(const uint8_t* source, uint32_t width, float* destination) {
+  const ColorTables& tables = colorTables();
+  for (uint32_t i = 0; i < width * 4; i += 4) {
+    destination[i + 0] = tables.decode[source[i + 0]];
+    destination[i + 1] = tables.decode[source[i + 1]];
+    destination[i + 2] = tables.decode[source[i + 2]];
+    destination[i + 3] = source[i + 3] * (1.0f / 255.0f);
+  }
+}
+
+void encodeRow(const float* source, uint32_t width, uint8_t* destination, bool simd) {
+  const ColorTables& tables = colorTables();
+  const float        scale  = static_cast<float>(ENCODE_LUT_SIZE - 1);
+
+#ifdef MIPMAP_SSE2
+  if (simd) {
+    // the Kaiser lobes overshoot, clamp before indexing; alpha is scaled to 255 and rounded directly
+    const __m128 zero       = _mm_setzero_ps();
+    const __m128 one        = _mm_set1_ps(1.0f);
+    const __m128 pixelScale = _mm_setr_ps(scale, scale, scale, 255.0f);
+    alignas(16) int32_t quantized[4];
+    for (uint32_t x = 0; x < width; x++) {
+      __m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(source + 4 * x), zero), one);
+      _mm_store_si128(reinterpret_cast<__m128i*>(quantized), _mm_cvtps_epi32(_mm_mul_ps(value, pixelScale)));
+      destination[4 * x + 0] = tables.encode[quantized[0]];
+      destination[4 * x + 1] = tables.encode[quantized[1]];
+      destination[4 * x + 2] = tables.encode[quantized[2]];
+      destination[4 * x + 3] = static_cast<uint8_t>(quantized[3]);
+    }
+    return;
+  }
+#endif
+
+  for (uint32_t i = 0; i < width * 4; i += 4) {
+    for (int c = 0; c < 3; c++) {
+      float value        = std::clamp(source[i + c], 0.0f, 1.0f);
+      destination[i + c] = tables.encode[std::lrint(value * scale)];
+    }
+    destination[i + 3] = static_cast<uint8_t>(std::lrint(std::clamp(source[i + 3], 0.0f, 1.0f) * 255.0f));
+  }
+}
+
+// source pixels past the edges are clamped to the edge
+void filterRow(const float* source, uint32_t sourceWidth, uint32_t width, const Kernel& kernel, float* destination,
+               bool simd) {
+  auto clampX = [&](int x) { return static_cast<uint32_t>(std::clamp(x, 0, static_cast<int>(sourceWidth) - 1)); };
+
+#ifdef MIPMAP_SSE2
+  if (simd) {
+    // one RGBA pixel per register
+    for (uint32_t x = 0; x < width; x++) {
+      int    first = 2 * static_cast<int>(x) + kernel.first;
+      __m128 sum   = _mm_setzero_ps();
+      for (int k = 0; k < kernel.taps; k++) {
+        __m128 pixel = _mm_loadu_ps(source + 4 * clampX(first + k));
+        sum          = _mm_add_ps(sum, _mm_mul_ps(pixel, _mm_set1_ps(kernel.weights[k])));
+      }
+      _mm_storeu_ps(destination + 4 * x, sum);
+    }
+    return;
+  }
+#endif
+
+  for (uint32_t x = 0; x < width; x++) {
+    int   first  = 2 * static_cast<int>(x) + kernel.first;
+    float sum[4] = {};
+    for (int k = 0; k < kernel.taps; k++) {
+      const float* pixel = source + 4 * clampX(first + k);
+      for (int c = 0; c < 4; c++) {
+        sum[c] += pixel[c] * kernel.weights[k];
+      }
+    }
+    std::copy(sum, sum + 4, destination + 4 * x);
+  }
+}
+
+// weighted sum of kernel.taps rows of count floats
+void filterColumn(const float* const* rows, size_t count, const Kernel& kernel, float* destination, bool simd) {
+  size_t i = 0;
+
+#ifdef __AVX2__
+  if (simd) {
+    for (; i + 8 <= count; i += 8) {
+      __m256 sum = _mm256_setzero_ps();
+      for (int k = 0; k < kernel.taps; k++) {
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(rows[k] + i), _mm256_set1_ps(kernel.weights[k])));
+      }
+      _mm256_storeu_ps(destination + i, sum);
+    }
+  }
+#endif
+#ifdef MIPMAP_SSE2
+  if (simd) {
+    for (; i + 4 <= count; i += 4) {
+      __m128 sum = _mm_setzero_ps();
+      for (int k = 0; k < kernel.taps; k++) {
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[k] + i), _mm_set1_ps(kernel.weights[k])));
+      }
+      _mm_storeu_ps(destination + i, sum);
+    }
+  }
+#endif
+
+  for (; i < count; i++) {
+    float sum = 0.0f;
+    for (int k = 0; k < kernel.taps; k++) {
+      sum += rows[k][i] * kernel.weights[k];
+    }
+    destination[i] = sum;
+  }
+}
+
+void downsampleBand(const uint8_t* source, const MipLevel& sourceLevel, uint8_t* destination, const MipLevel& level,
+                    uint32_t firstRow, uint32_t lastRow, const Kernel& kernel, bool simd) {
+  auto clampY = [&](int y) { return std::clamp(y, 0, static_cast<int>(sourceLevel.height) - 1); };
+
+  // every source row the band touches is decoded and filtered horizontally once
+  int    firstSourceRow = clampY(2 * static_cast<int>(firstRow) + kernel.first);
+  int    lastSourceRow  = clampY(2 * static_cast<int>(lastRow - 1) + kernel.first + kernel.taps - 1);
+  size_t rowFloats      = static_cast<size_t>(level.width) * 4;
+
+  std::vector<float> decoded(static_cast<size_t>(sourceLevel.width) * 4);
+  std::vector<float> filtered(rowFloats * (lastSourceRow - firstSourceRow + 1));
+  std::vector<float> result(rowFloats);
+
+  for (int y = firstSourceRow; y <= lastSourceRow; y++) {
+    decodeRow(source + static_cast<size_t>(y) * sourceLevel.width * 4, sourceLevel.width, decoded.data());
+    filterRow(decoded.data(), sourceLevel.width, level.width, kernel, filtered.data() + (y - firstSourceRow) * rowFloats,
+              simd);
+  }
+
+  const float* rows[MAX_TAPS];
+  for (uint32_t y = firstRow; y < lastRow; y++) {
+    for (int k = 0; k < kernel.taps; k++) {
+      rows[k] = filtered.data() + (clampY(2 * static_cast<int>(y) + kernel.first + k) - firstSourceRow) * rowFloats;
+    }
+    filterColumn(rows, rowFloats, kernel, result.data(), simd);
+    encodeRow(result.data(), level.width, destination + static_cast<size_t>(y) * level.width * 4, simd);
+  }
+}
+
+}  // namespace
+
+std::vector<MipLevel> computeMipLayout(uint32_t width, uint32_t height, uint32_t mipLevels) {
+  std::vector<MipLevel> levels;
+  size_t                offset = 0;
+  for (uint32_t i = 0; i < mipLevels; i++) {
+    MipLevel level;
+    level.width  = width;
+    level.height = height;
+    level.offset = offset;
+    level.size   = static_cast<size_t>(width) * height * 4;
+    levels.push_back(level);
+
+    offset += level.size;
+    width  = std::max(width / 2, 1u);
+    height = std::max(height / 2, 1u);
+  }
+  return levels;
+}
+
+void generateMipChain(uint8_t* chain, const std::vector<MipLevel>& levels, MipFilter filter, bool simd,
+                      unsigned int threadCount) {
+  Kernel kernel = makeKernel(filter);
+
+  for (size_t i = 1; i < levels.size(); i++) {
+    const MipLevel& sourceLevel = levels[i - 1];
+    const MipLevel& level       = levels[i];
+
+    size_t bands = (level.height + BAND_ROWS - 1) / BAND_ROWS;
+    parallelFor(bands, [&](size_t band) {
+      uint32_t firstRow = static_cast<uint32_t>(band) * BAND_ROWS;
+      uint32_t lastRow  = std::min(firstRow + BAND_ROWS, level.height);
+      downsampleBand(chain + sourceLevel.offset, sourceLevel, chain + level.offset, level, firstRow, lastRow, kernel,
+                     simd);
+    }, threadCount);
+  }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class MipFilter {
+  // 2x2 average, matches what a linear blit does for even sizes
+  Box,
+  // 8 tap Kaiser windowed sinc, sharper and with less aliasing than the box
+  Kaiser,
+};
+
+// One level of a tightly packed RGBA8 mip chain.
+struct MipLevel {
+  uint32_t width;
+  uint32_t height;
+  size_t   offset;  // bytes from the start of the chain
+  size_t   size;
+};
+
+// Layout of mipLevels levels starting at width x height, each size is half the previous one rounded down.
+std::vector<MipLevel> computeMipLayout(uint32_t width, uint32_t height, uint32_t mipLevels);
+
+inline size_t mipChainSize(const std::vector<MipLevel>& levels) {
+  return levels.empty() ? 0 : levels.back().offset + levels.back().size;
+}
+
+/*
+Fills levels 1 to n of an RGBA8 chain whose level 0 is already in place. Color channels are sRGB and filtered in
+linear space, alpha is filtered as is. Every level is split into row bands over threadCount threads (0 = all cores);
+the separable filter runs SSE2 kernels, or AVX2 when the build enables it, unless simd is false.
+*/
+void generateMipChain(uint8_t* chain, const std::vector<MipLevel>& levels, MipFilter filter = MipFilter::Box,
+                      bool simd = true, unsigned int threadCount = 0);
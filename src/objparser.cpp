@@ -0,0 +1,372 @@
+#include "./objparser.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <sstream>
+
+#include "./mappedfile.h"
+#include "./parallel.h"
+
+namespace {
+
+// chunks smaller than this are not worth a thread
+const size_t MIN_CHUNK_SIZE = 1 << 20;
+
+struct ShapeMarker {
+  std::string name;
+  size_t      firstTriangle;  // chunk-local
+};
+
+struct ObjChunk {
+  const char* begin;
+  const char* end;
+
+  // filled by the counting pass
+  size_t lineCount     = 0;
+  size_t vertexCount   = 0;
+  size_t texcoordCount = 0;
+  size_t normalCount   = 0;
+
+  // global offsets, known before the parsing pass
+  size_t firstLine     = 0;
+  size_t firstVertex   = 0;
+  size_t firstTexcoord = 0;
+  size_t firstNormal   = 0;
+  size_t firstTriangle = 0;
+
+  // filled by the parsing pass
+  std::vector<tinyobj::index_t> indices;  // three per triangle
+  std::vector<ShapeMarker>      shapes;
+  std::string                   error;
+};
+
+struct ShapeRange {
+  std::string name;
+  size_t      firstTriangle;
+  size_t      triangleCount;
+};
+
+inline bool isSpace(char c) {
+  return c == ' ' || c == '\t';
+}
+
+inline const char* skipSpace(const char* p, const char* end) {
+  while (p < end && isSpace(*p)) p++;
+  return p;
+}
+
+inline const char* lineEnd(const char* p, const char* end) {
+  const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+  return newline ? newline : end;
+}
+
+// keyword at p followed by whitespace
+inline bool isKeyword(const char* p, const char* end, const char* keyword, size_t length) {
+  return static_cast<size_t>(end - p) > length && strncmp(p, keyword, length) == 0 && isSpace(p[length]);
+}
+
+bool parseFloat(const char*& p, const char* end, float& value) {
+  p = skipSpace(p, end);
+  if (p < end && *p == '+') p++;
+
+  auto result = std::from_chars(p, end, value);
+  if (result.ec != std::errc()) {
+    return false;
+  }
+  p = result.ptr;
+  return true;
+}
+
+bool parseInt(const char*& p, const char* end, int& value) {
+  auto result = std::from_chars(p, end, value);
+  if (result.ec != std::errc()) {
+    return false;
+  }
+  p = result.ptr;
+  return true;
+}
+
+// OBJ indices are 1-based, negative values are relative to the current element count; either way they have to name
+// an element defined before the face
+inline bool fixIndex(int idx, size_t count, int& result) {
+  if (idx > 0) {
+    result = idx - 1;
+  } else if (idx < 0) {
+    result = static_cast<int>(count) + idx;
+  } else {
+    return false;
+  }
+  return result >= 0 && static_cast<size_t>(result) < count;
+}
+
+// parses "v", "v/vt", "v//vn" or "v/vt/vn"
+bool parseTriple(const char*& p, const char* end, size_t vertexCount, size_t texcoordCount, size_t normalCount,
+                 tinyobj::index_t& index) {
+  index.vertex_index   = -1;
+  index.texcoord_index = -1;
+  index.normal_index   = -1;
+
+  int value;
+  if (!parseInt(p, end, value) || !fixIndex(value, vertexCount, index.vertex_index)) {
+    return false;
+  }
+  if (p == end || *p != '/') {
+    return true;
+  }
+  p++;
+  if (p < end && *p != '/') {
+    if (!parseInt(p, end, value) || !fixIndex(value, texcoordCount, index.texcoord_index)) {
+      return false;
+    }
+  }
+  if (p == end || *p != '/') {
+    return true;
+  }
+  p++;
+  return parseInt(p, end, value) && fixIndex(value, normalCount, index.normal_index);
+}
+
+void countChunk(ObjChunk& chunk) {
+  for (const char* line = chunk.begin; line < chunk.end;) {
+    const char* end = lineEnd(line, chunk.end);
+    const char* p   = skipSpace(line, end);
+
+    if (end - p > 1 && p[0] == 'v') {
+      if (isSpace(p[1])) {
+        chunk.vertexCount++;
+      } else if (end - p > 2 && isSpace(p[2])) {
+        if (p[1] == 't') chunk.texcoordCount++;
+        if (p[1] == 'n') chunk.normalCount++;
+      }
+    }
+
+    chunk.lineCount++;
+    line = end + 1;
+  }
+}
+
+void parseChunk(ObjChunk& chunk, tinyobj::attrib_t& attrib) {
+  size_t vertexCount   = chunk.firstVertex;
+  size_t texcoordCount = chunk.firstTexcoord;
+  size_t normalCount   = chunk.firstNormal;
+  size_t lineNumber    = chunk.firstLine;
+
+  std::vector<tinyobj::index_t> polygon;
+
+  auto fail = [&](const char* what) {
+    std::stringstream ss;
+    ss << "failed to parse " << what << " in line " << lineNumber << "\n";
+    chunk.error = ss.str();
+  };
+
+  for (const char* line = chunk.begin; line < chunk.end;) {
+    const char* end  = lineEnd(line, chunk.end);
+    const char* next = end + 1;
+    const char* p    = skipSpace(line, end);
+    lineNumber++;
+
+    // trim '\r' of CRLF files
+    if (end > p && end[-1] == '\r') end--;
+
+    if (isKeyword(p, end, "v", 1)) {
+      p += 2;
+      float* pos   = &attrib.vertices[3 * vertexCount];
+      float* color = &attrib.colors[3 * vertexCount];
+      if (!parseFloat(p, end, pos[0]) || !parseFloat(p, end, pos[1]) || !parseFloat(p, end, pos[2])) {
+        return fail("vertex");
+      }
+      float r, g, b;
+      if (parseFloat(p, end, r) && parseFloat(p, end, g) && parseFloat(p, end, b)) {
+        color[0] = r;
+        color[1] = g;
+        color[2] = b;
+      } else {
+        color[0] = color[1] = color[2] = 1.0f;
+      }
+      vertexCount++;
+    } else if (isKeyword(p, end, "vt", 2)) {
+      p += 3;
+      float* uv = &attrib.texcoords[2 * texcoordCount];
+      if (!parseFloat(p, end, uv[0])) {
+        return fail("texcoord");
+      }
+      if (!parseFloat(p, end, uv[1])) {
+        uv[1] = 0.0f;
+      }
+      texcoordCount++;
+    } else if (isKeyword(p, end, "vn", 2)) {
+      p += 3;
+      float* normal = &attrib.normals[3 * normalCount];
+      if (!parseFloat(p, end, normal[0]) || !parseFloat(p, end, normal[1]) || !parseFloat(p, end, normal[2])) {
+        return fail("normal");
+      }
+      normalCount++;
+    } else if (isKeyword(p, end, "f", 1)) {
+      p = skipSpace(p + 2, end);
+      polygon.clear();
+      while (p < end) {
+        tinyobj::index_t index;
+        if (!parseTriple(p, end, vertexCount, texcoordCount, normalCount, index)) {
+          return fail("face");
+        }
+        polygon.push_back(index);
+        p = skipSpace(p, end);
+      }
+
+      // faces with less than three vertices are dropped, just like LoadObj does
+      for (size_t k = 2; k < polygon.size(); k++) {
+        chunk.indices.push_back(polygon[0]);
+        chunk.indices.push_back(polygon[k - 1]);
+        chunk.indices.push_back(polygon[k]);
+      }
+    } else if (isKeyword(p, end, "o", 1) || isKeyword(p, end, "g", 1)) {
+      p = skipSpace(p + 2, end);
+      const char* nameEnd = end;
+      while (nameEnd > p && isSpace(nameEnd[-1])) nameEnd--;
+      chunk.shapes.push_back({std::string(p, nameEnd), chunk.indices.size() / 3});
+    }
+
+    line = next;
+  }
+}
+
+std::vector<ObjChunk> splitChunks(const char* data, size_t size, unsigned int threadCount) {
+  size_t chunkCount = std::max<size_t>(1, std::min<size_t>(size / MIN_CHUNK_SIZE, threadCount * 4));
+  size_t chunkSize  = size / chunkCount;
+
+  std::vector<ObjChunk> chunks;
+  const char*           end   = data + size;
+  const char*           begin = data;
+  while (begin < end) {
+    const char* split = std::min(begin + chunkSize, end);
+    if (split < end) {
+      split = lineEnd(split, end);
+      split = std::min(split + 1, end);
+    }
+
+    ObjChunk chunk;
+    chunk.begin = begin;
+    chunk.end   = split;
+    chunks.push_back(std::move(chunk));
+    begin = split;
+  }
+  return chunks;
+}
+
+std::vector<ShapeRange> collectShapes(const std::vector<ObjChunk>& chunks, size_t triangleCount) {
+  std::vector<ShapeRange> ranges;
+
+  std::string name;
+  size_t      first = 0;
+  for (const auto& chunk : chunks) {
+    for (const auto& marker : chunk.shapes) {
+      size_t start = chunk.firstTriangle + marker.firstTriangle;
+      if (start > first) {
+        ranges.push_back({name, first, start - first});
+      }
+      name  = marker.name;
+      first = start;
+    }
+  }
+  if (triangleCount > first) {
+    ranges.push_back({name, first, triangleCount - first});
+  }
+
+  return ranges;
+}
+
+}  // namespace
+
+bool loadObjParallel(tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes, std::string* warn,
+                     std::string* err, const std::string& filename, unsigned int threadCount) {
+  if (threadCount == 0) {
+    threadCount = workerThreadCount();
+  }
+
+  MappedFile file;
+  if (!file.open(filename)) {
+    if (err) {
+      *err += "Cannot open file [" + filename + "]\n";
+    }
+    return false;
+  }
+
+  std::vector<ObjChunk> chunks = splitChunks(file.data(), file.size(), threadCount);
+
+  // pass 1: count elements per chunk so every chunk can write its vertices in place
+  parallelFor(
+      chunks.size(), [&](size_t i) { countChunk(chunks[i]); }, threadCount);
+
+  size_t lines = 0, vertices = 0, texcoords = 0, normals = 0;
+  for (auto& chunk : chunks) {
+    chunk.firstLine     = lines;
+    chunk.firstVertex   = vertices;
+    chunk.firstTexcoord = texcoords;
+    chunk.firstNormal   = normals;
+    lines += chunk.lineCount;
+    vertices += chunk.vertexCount;
+    texcoords += chunk.texcoordCount;
+    normals += chunk.normalCount;
+  }
+
+  attrib->vertices.resize(3 * vertices);
+  attrib->colors.resize(3 * vertices);
+  attrib->texcoords.resize(2 * texcoords);
+  attrib->normals.resize(3 * normals);
+  attrib->vertex_weights.clear();
+  attrib->texcoord_ws.clear();
+
+  // pass 2: parse, faces are resolved against the global element counts
+  parallelFor(
+      chunks.size(), [&](size_t i) { parseChunk(chunks[i], *attrib); }, threadCount);
+
+  size_t triangles = 0;
+  for (auto& chunk : chunks) {
+    if (!chunk.error.empty()) {
+      if (err) {
+        *err += chunk.error;
+      }
+      return false;
+    }
+    chunk.firstTriangle = triangles;
+    triangles += chunk.indices.size() / 3;
+  }
+
+  if (warn && triangles == 0) {
+    *warn += "no faces found in [" + filename + "]\n";
+  }
+
+  std::vector<ShapeRange> ranges = collectShapes(chunks, triangles);
+
+  shapes->clear();
+  shapes->resize(ranges.size());
+  for (size_t s = 0; s < ranges.size(); s++) {
+    tinyobj::shape_t& shape = (*shapes)[s];
+    shape.name              = ranges[s].name;
+    shape.mesh.indices.resize(3 * ranges[s].triangleCount);
+    shape.mesh.num_face_vertices.assign(ranges[s].triangleCount, 3);
+    shape.mesh.material_ids.assign(ranges[s].triangleCount, -1);
+    shape.mesh.smoothing_group_ids.assign(ranges[s].triangleCount, 0);
+  }
+
+  // merge: every chunk copies its triangles into the shapes it overlaps
+  parallelFor(
+      chunks.size(), [&](size_t i) {
+        const ObjChunk& chunk = chunks[i];
+        size_t          first = chunk.firstTriangle;
+        size_t          last  = first + chunk.indices.size() / 3;
+
+        for (size_t s = 0; s < ranges.size(); s++) {
+          size_t begin = std::max(first, ranges[s].firstTriangle);
+          size_t end   = std::min(last, ranges[s].firstTriangle + ranges[s].triangleCount);
+          if (begin >= end) continue;
+
+          std::copy(chunk.indices.begin() + 3 * (begin - first), chunk.indices.begin() + 3 * (end - first),
+                    (*shapes)[s].mesh.indices.begin() + 3 * (begin - ranges[s].firstTriangle));
+        }
+      },
+      threadCount);
+
+  return true;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "./tiny_obj_loader.h"
+
+/*
+Multithreaded replacement for tinyobj::LoadObj covering the records our models use (v, vt, vn, f, o, g).
+The file is memory mapped and split into line-aligned chunks which are parsed in place on all cores, the result is
+merged into attrib_t/shape_t like LoadObj with triangulation enabled. Material statements are ignored, every face gets
+material id -1.
+
+Polygons are fan-triangulated from their first corner, LoadObj ear-clips them instead. Both give the same triangles
+for triangles and convex planar polygons only; a non-convex or non-planar polygon comes out as different, possibly
+overlapping triangles here, so only models with convex faces load the same as through LoadObj.
+*/
+bool loadObjParallel(tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes, std::string* warn,
+                     std::string* err, const std::string& filename, unsigned int threadCount = 0);
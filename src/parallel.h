@@ -0,0 +1,57 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+inline unsigned int workerThreadCount() {
+  unsigned int count = std::thread::hardware_concurrency();
+  return count > 0 ? count : 1;
+}
+
+// Runs job(i) for every i in [0, jobCount) spread over at most threadCount threads (0 = all cores).
+// The calling thread takes part in the work; the first exception thrown by a job is rethrown here.
+template <typename Job>
+void parallelFor(size_t jobCount, Job&& job, unsigned int threadCount = 0) {
+  if (threadCount == 0) {
+    threadCount = workerThreadCount();
+  }
+  size_t threads = std::min<size_t>(threadCount, jobCount);
+
+  if (threads <= 1) {
+    for (size_t i = 0; i < jobCount; i++) {
+      job(i);
+    }
+    return;
+  }
+
+  std::vector<std::exception_ptr> errors(threads);
+  auto                            worker = [&](size_t t) {
+    try {
+      for (size_t i = t; i < jobCount; i += threads) {
+        job(i);
+      }
+    } catch (...) {
+      errors[t] = std::current_exception();
+    }
+  };
+
+  std::vector<std::thread> pool;
+  pool.reserve(threads - 1);
+  for (size_t t = 1; t < threads; t++) {
+    pool.emplace_back(worker, t);
+  }
+  worker(0);
+
+  for (auto& thread : pool) {
+    thread.join();
+  }
+
+  for (const auto& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
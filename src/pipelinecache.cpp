@@ -0,0 +1,97 @@
+#include "./pipelinecache.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "./mappedfile.h"
+
+namespace {
+
+// VkPipelineCacheHeaderVersionOne, spelled out because older SDK headers do not have it
+struct CacheHeader {
+  uint32_t headerSize;
+  uint32_t headerVersion;
+  uint32_t vendorID;
+  uint32_t deviceID;
+  uint8_t  pipelineCacheUUID[VK_UUID_SIZE];
+};
+
+bool matchesDevice(const MappedFile& file, const VkPhysicalDeviceProperties& properties) {
+  CacheHeader header;
+  if (file.size() < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, file.data(), sizeof(header));
+
+  return header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE && header.headerSize >= sizeof(header) &&
+         header.headerSize <= file.size() && header.vendorID == properties.vendorID &&
+         header.deviceID == properties.deviceID &&
+         memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+}  // namespace
+
+void PipelineCache::init(VkPhysicalDevice physicalDevice, VkDevice device, const std::string& path) {
+  _device      = device;
+  _path        = path;
+  _loadedBytes = 0;
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+  // a cache of another GPU or driver version starts out empty and is overwritten on exit
+  MappedFile file;
+  bool       valid = file.open(path) && matchesDevice(file, properties);
+  if (file.isOpen() && !valid) {
+    std::cout << "ignoring " << path << ", it was written for another device or driver" << std::endl;
+  }
+
+  VkPipelineCacheCreateInfo cacheInfo = {};
+  cacheInfo.sType                     = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cacheInfo.initialDataSize           = valid ? file.size() : 0;
+  cacheInfo.pInitialData              = valid ? file.data() : nullptr;
+
+  if (vkCreatePipelineCache(_device, &cacheInfo, nullptr, &_cache) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline cache!");
+  }
+  _loadedBytes = cacheInfo.initialDataSize;
+}
+
+bool PipelineCache::save() {
+  size_t size = 0;
+  if (vkGetPipelineCacheData(_device, _cache, &size, nullptr) != VK_SUCCESS) {
+    return false;
+  }
+  std::vector<char> data(size);
+  if (vkGetPipelineCacheData(_device, _cache, &size, data.data()) != VK_SUCCESS) {
+    return false;
+  }
+
+  // write to a temporary file first so a crash never leaves a truncated cache behind
+  std::string tempPath = _path + ".tmp";
+  {
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      return false;
+    }
+
+    file.write(data.data(), size);
+    if (!file.good()) {
+      return false;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(tempPath, _path, error);
+  return !error;
+}
+
+void PipelineCache::destroy() {
+  vkDestroyPipelineCache(_device, _cache, nullptr);
+  _cache = VK_NULL_HANDLE;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <string>
+
+/*
+VkPipelineCache kept on disk between runs, so pipelines are only compiled by the driver the first time. The blob is
+only handed to the driver when its header names this vendor, device and pipelineCacheUUID; drivers are required to
+reject anything else, but a stale or truncated blob is a crash on some of them. One cache serves every pipeline
+creation of the run, save() writes it to a temporary file that replaces the old one only once it is complete.
+*/
+class PipelineCache {
+ public:
+  // creates the cache, seeded from path when the file there matches the device
+  void init(VkPhysicalDevice physicalDevice, VkDevice device, const std::string& path);
+  // returns false on I/O errors, the old file is kept then
+  bool save();
+  void destroy();
+
+  VkPipelineCache handle() const {
+    return _cache;
+  }
+
+  // bytes taken over from disk, 0 when the cache started out empty
+  size_t loadedBytes() const {
+    return _loadedBytes;
+  }
+
+ private:
+  VkDevice        _device = VK_NULL_HANDLE;
+  VkPipelineCache _cache  = VK_NULL_HANDLE;
+  std::string     _path;
+  size_t          _loadedBytes = 0;
+};
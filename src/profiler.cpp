@@ -0,0 +1,179 @@
+#include "./profiler.h"
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+constexpr size_t CHUNK_ZONES = 4096;
+// a thread stops recording after a million zones, about 24 MB, instead of growing for as long as the app runs
+constexpr size_t MAX_CHUNKS = 256;
+
+struct Zone {
+  const char* name;
+  int64_t     start;
+  int64_t     end;
+};
+
+// written by the owning thread only; count is published after the zone it covers, next after the chunk is linked
+struct Chunk {
+  Zone                zones[CHUNK_ZONES];
+  std::atomic<size_t> count{0};
+  std::atomic<Chunk*> next{nullptr};
+};
+
+struct ThreadBuffer {
+  Chunk                    first;
+  Chunk*                   last       = &first;  // owning thread only
+  size_t                   chunkCount = 1;       // owning thread only
+  std::atomic<size_t>      dropped{0};
+  std::atomic<const char*> name{nullptr};
+  uint32_t                 id = 0;
+
+  ~ThreadBuffer() {
+    Chunk* chunk = first.next.load();
+    while (chunk != nullptr) {
+      Chunk* next = chunk->next.load();
+      delete chunk;
+      chunk = next;
+    }
+  }
+};
+
+struct Registry {
+  std::mutex                                 mutex;
+  std::vector<std::unique_ptr<ThreadBuffer>> threads;  // kept after their threads exit
+  std::unordered_set<std::string>            names;    // node based, the strings never move
+};
+
+// zones are placed relative to program start
+const int64_t epoch = profileTimestamp();
+
+Registry& registry() {
+  static Registry instance;
+  return instance;
+}
+
+// the only lock a recording thread ever takes, once
+ThreadBuffer& threadBuffer() {
+  thread_local ThreadBuffer* buffer = nullptr;
+  if (buffer == nullptr) {
+    Registry&                   reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.threads.push_back(std::make_unique<ThreadBuffer>());
+    buffer     = reg.threads.back().get();
+    buffer->id = static_cast<uint32_t>(reg.threads.size());
+  }
+  return *buffer;
+}
+
+// names may come from file names, control characters have to be escaped or the viewers reject the trace
+void writeJsonString(std::ofstream& file, const char* text) {
+  const char hexDigits[] = "0123456789abcdef";
+
+  file << '"';
+  for (const char* c = text; *c != '\0'; c++) {
+    unsigned char value = static_cast<unsigned char>(*c);
+    if (value < 0x20) {
+      file << "\\u00" << hexDigits[value >> 4] << hexDigits[value & 0xf];
+      continue;
+    }
+    if (*c == '"' || *c == '\\') {
+      file << '\\';
+    }
+    file << *c;
+  }
+  file << '"';
+}
+
+}  // namespace
+
+void recordProfileZone(const char* name, int64_t start, int64_t end) {
+  ThreadBuffer& buffer = threadBuffer();
+  Chunk*        chunk  = buffer.last;
+  size_t        count  = chunk->count.load(std::memory_order_relaxed);
+
+  if (count == CHUNK_ZONES) {
+    if (buffer.chunkCount == MAX_CHUNKS) {
+      buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    Chunk* next = new Chunk;
+    chunk->next.store(next, std::memory_order_release);
+    buffer.last = chunk = next;
+    buffer.chunkCount++;
+    count = 0;
+  }
+
+  chunk->zones[count] = {name, start, end};
+  chunk->count.store(count + 1, std::memory_order_release);
+}
+
+void setProfileThreadName(const char* name) {
+  threadBuffer().name.store(name, std::memory_order_release);
+}
+
+const char* internProfileName(const std::string& name) {
+  Registry&                   reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  return reg.names.insert(name).first->c_str();
+}
+
+size_t writeChromeTrace(const std::string& filename) {
+  std::ofstream file(filename, std::ios::trunc);
+  if (!file) {
+    throw std::runtime_error("failed to open trace file!");
+  }
+
+  Registry&                   reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  file.setf(std::ios::fixed);
+  file.precision(3);
+
+  size_t zoneCount = 0;
+  bool   first     = true;
+  for (const std::unique_ptr<ThreadBuffer>& thread : reg.threads) {
+    const char* name = thread->name.load(std::memory_order_acquire);
+    if (name != nullptr) {
+      file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->id
+           << ",\"args\":{\"name\":";
+      writeJsonString(file, name);
+      file << "}}";
+      first = false;
+    }
+
+    // zones of a thread are in the order they ended, the viewers sort them
+    for (const Chunk* chunk = &thread->first; chunk != nullptr; chunk = chunk->next.load(std::memory_order_acquire)) {
+      size_t count = chunk->count.load(std::memory_order_acquire);
+      for (size_t i = 0; i < count; i++) {
+        const Zone& zone = chunk->zones[i];
+        file << (first ? "" : ",") << "\n{\"name\":";
+        writeJsonString(file, zone.name);
+        file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread->id << ",\"ts\":" << (zone.start - epoch) / 1000.0
+             << ",\"dur\":" << (zone.end - zone.start) / 1000.0 << "}";
+        first = false;
+      }
+      zoneCount += count;
+    }
+
+    size_t dropped = thread->dropped.load(std::memory_order_relaxed);
+    if (dropped > 0) {
+      file << (first ? "" : ",") << "\n{\"name\":\"" << dropped
+           << " zones dropped\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":" << thread->id << ",\"ts\":0}";
+      first = false;
+    }
+  }
+  file << "\n]}\n";
+
+  if (!file) {
+    throw std::runtime_error("failed to write trace file!");
+  }
+  return zoneCount;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+Scoped zones for a timeline of startup and frames. Every thread records into a buffer of its own without taking a
+lock; buffers only grow by whole chunks, so writeChromeTrace can read them while the threads keep recording. Zone
+names are not copied and have to outlive the profiler: string literals, __func__ or internProfileName().
+
+The trace is written in Chrome's JSON trace event format, which chrome://tracing and ui.perfetto.dev both open.
+*/
+
+// ns on the steady clock, the epoch is subtracted when the trace is written
+inline int64_t profileTimestamp() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void recordProfileZone(const char* name, int64_t start, int64_t end);
+
+// shown instead of the thread id, name has to outlive the profiler like zone names
+void setProfileThreadName(const char* name);
+
+// a copy of name that lives as long as the profiler, for names built at runtime
+const char* internProfileName(const std::string& name);
+
+// returns the number of zones written; the buffers are kept, a later call writes everything again
+size_t writeChromeTrace(const std::string& filename);
+
+class ProfileZone {
+ public:
+  explicit ProfileZone(const char* name) : _name(name), _start(profileTimestamp()) {}
+  ~ProfileZone() {
+    recordProfileZone(_name, _start, profileTimestamp());
+  }
+
+  ProfileZone(const ProfileZone&) = delete;
+  ProfileZone& operator=(const ProfileZone&) = delete;
+
+ private:
+  const char* _name;
+  int64_t     _start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+// times the rest of the enclosing scope
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
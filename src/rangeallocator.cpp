@@ -0,0 +1,244 @@
+#include "./rangeallocator.h"
+
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+uint32_t lowestBit(uint64_t value) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, value);
+  return index;
+#else
+  return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+}
+
+uint32_t highestBit(uint64_t value) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return index;
+#else
+  return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+}
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+}  // namespace
+
+RangeAllocator::RangeAllocator(uint64_t size) : _size(size) {
+  for (auto& lists : _freeLists) {
+    std::fill(std::begin(lists), std::end(lists), INVALID);
+  }
+  if (size > 0) {
+    insertFree(createRange(0, size));
+  }
+}
+
+uint32_t RangeAllocator::createRange(uint64_t offset, uint64_t size) {
+  uint32_t index;
+  if (!_unusedRanges.empty()) {
+    index = _unusedRanges.back();
+    _unusedRanges.pop_back();
+  } else {
+    index = static_cast<uint32_t>(_ranges.size());
+    _ranges.emplace_back();
+  }
+  _ranges[index] = {offset, size, INVALID, INVALID, INVALID, INVALID, false};
+  return index;
+}
+
+void RangeAllocator::releaseRange(uint32_t index) {
+  _unusedRanges.push_back(index);
+}
+
+// sizes below SUBDIVISION_COUNT get a list each in level 0, larger ones split their power of two into equal lists
+void RangeAllocator::mapSize(uint64_t size, uint32_t& level, uint32_t& list) {
+  if (size < SUBDIVISION_COUNT) {
+    level = 0;
+    list  = static_cast<uint32_t>(size);
+    return;
+  }
+  uint32_t bit = highestBit(size);
+  level        = bit - SUBDIVISION_BITS + 1;
+  list         = static_cast<uint32_t>(size >> (bit - SUBDIVISION_BITS)) & (SUBDIVISION_COUNT - 1);
+}
+
+void RangeAllocator::insertFree(uint32_t index) {
+  uint32_t level, list;
+  mapSize(_ranges[index].size, level, list);
+
+  Range& range       = _ranges[index];
+  range.free         = true;
+  range.previousFree = INVALID;
+  range.nextFree     = _freeLists[level][list];
+  if (range.nextFree != INVALID) {
+    _ranges[range.nextFree].previousFree = index;
+  }
+  _freeLists[level][list] = index;
+  _listBitmaps[level] |= 1u << list;
+  _levelBitmap |= uint64_t(1) << level;
+  _freeRangeCount++;
+}
+
+void RangeAllocator::removeFree(uint32_t index) {
+  uint32_t level, list;
+  mapSize(_ranges[index].size, level, list);
+
+  Range& range = _ranges[index];
+  if (range.previousFree != INVALID) {
+    _ranges[range.previousFree].nextFree = range.nextFree;
+  } else {
+    _freeLists[level][list] = range.nextFree;
+  }
+  if (range.nextFree != INVALID) {
+    _ranges[range.nextFree].previousFree = range.previousFree;
+  }
+  if (_freeLists[level][list] == INVALID) {
+    _listBitmaps[level] &= ~(1u << list);
+    if (_listBitmaps[level] == 0) {
+      _levelBitmap &= ~(uint64_t(1) << level);
+    }
+  }
+  range.free = false;
+  _freeRangeCount--;
+}
+
+// searching for size + alignment - 1 guarantees the aligned range fits wherever the free range starts
+uint32_t RangeAllocator::findFree(uint64_t size, uint64_t alignment) const {
+  uint64_t padded = size + alignment - 1;
+
+  // round up to the next list boundary so every range in the chosen list fits
+  uint32_t roundedLevel, roundedList;
+  mapSize(padded, roundedLevel, roundedList);
+  if (padded >= SUBDIVISION_COUNT) {
+    uint64_t step = uint64_t(1) << (highestBit(padded) - SUBDIVISION_BITS);
+    if (padded <= UINT64_MAX - (step - 1)) {
+      mapSize(padded + step - 1, roundedLevel, roundedList);
+    } else {
+      roundedLevel = LEVEL_COUNT;
+    }
+  }
+
+  if (roundedLevel < LEVEL_COUNT) {
+    uint32_t lists = _listBitmaps[roundedLevel] & (~0u << roundedList);
+    if (lists == 0 && roundedLevel + 1 < LEVEL_COUNT) {
+      uint64_t levels = _levelBitmap & (~uint64_t(0) << (roundedLevel + 1));
+      if (levels != 0) {
+        roundedLevel = lowestBit(levels);
+        lists        = _listBitmaps[roundedLevel];
+      }
+    }
+    if (lists != 0) {
+      return _freeLists[roundedLevel][lowestBit(lists)];
+    }
+  }
+
+  // the list size itself maps to may still hold a range that fits once aligned, e.g. one of exactly size
+  uint32_t level, list;
+  mapSize(size, level, list);
+  for (uint32_t index = _freeLists[level][list]; index != INVALID; index = _ranges[index].nextFree) {
+    const Range& range = _ranges[index];
+    if (alignUp(range.offset, alignment) - range.offset + size <= range.size) {
+      return index;
+    }
+  }
+  return INVALID;
+}
+
+uint32_t RangeAllocator::allocate(uint64_t size, uint64_t alignment) {
+  size      = std::max<uint64_t>(size, 1);
+  alignment = std::max<uint64_t>(alignment, 1);
+
+  uint32_t index = findFree(size, alignment);
+  if (index == INVALID) {
+    return INVALID;
+  }
+  removeFree(index);
+
+  // the padding in front becomes a free range of its own, the previous neighbour is never free
+  uint64_t padding = alignUp(_ranges[index].offset, alignment) - _ranges[index].offset;
+  if (padding > 0) {
+    uint32_t front          = createRange(_ranges[index].offset, padding);
+    _ranges[front].previous = _ranges[index].previous;
+    _ranges[front].next     = index;
+    if (_ranges[front].previous != INVALID) {
+      _ranges[_ranges[front].previous].next = front;
+    }
+    _ranges[index].previous = front;
+    _ranges[index].offset += padding;
+    _ranges[index].size -= padding;
+    insertFree(front);
+  }
+
+  if (_ranges[index].size > size) {
+    uint32_t back          = createRange(_ranges[index].offset + size, _ranges[index].size - size);
+    _ranges[back].previous = index;
+    _ranges[back].next     = _ranges[index].next;
+    if (_ranges[back].next != INVALID) {
+      _ranges[_ranges[back].next].previous = back;
+    }
+    _ranges[index].next = back;
+    _ranges[index].size = size;
+    insertFree(back);
+  }
+
+  _usedBytes += size;
+  _allocationCount++;
+  return index;
+}
+
+void RangeAllocator::free(uint32_t handle) {
+  _usedBytes -= _ranges[handle].size;
+  _allocationCount--;
+
+  uint32_t index    = handle;
+  uint32_t previous = _ranges[index].previous;
+  if (previous != INVALID && _ranges[previous].free) {
+    removeFree(previous);
+    _ranges[previous].size += _ranges[index].size;
+    _ranges[previous].next = _ranges[index].next;
+    if (_ranges[index].next != INVALID) {
+      _ranges[_ranges[index].next].previous = previous;
+    }
+    releaseRange(index);
+    index = previous;
+  }
+
+  uint32_t next = _ranges[index].next;
+  if (next != INVALID && _ranges[next].free) {
+    removeFree(next);
+    _ranges[index].size += _ranges[next].size;
+    _ranges[index].next = _ranges[next].next;
+    if (_ranges[next].next != INVALID) {
+      _ranges[_ranges[next].next].previous = index;
+    }
+    releaseRange(next);
+  }
+
+  insertFree(index);
+}
+
+uint64_t RangeAllocator::largestFreeRange() const {
+  if (_levelBitmap == 0) {
+    return 0;
+  }
+
+  // the highest non-empty list holds the largest range, its members differ in size only below the list granularity
+  uint32_t level   = highestBit(_levelBitmap);
+  uint64_t largest = 0;
+  uint32_t index   = _freeLists[level][highestBit(_listBitmaps[level])];
+  while (index != INVALID) {
+    largest = std::max(largest, _ranges[index].size);
+    index   = _ranges[index].nextFree;
+  }
+  return largest;
+}
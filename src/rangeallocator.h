@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/*
+Two level segregated fit (TLSF) allocator over the offsets [0, size). Free ranges sit in lists bucketed by their
+highest set bit and the SUBDIVISION_BITS bits below it, two bitmaps find the first list whose ranges are all large
+enough in constant time. A freed range merges with free neighbours right away, so two free ranges are never adjacent.
+Only offsets are managed, the memory itself lives elsewhere.
+*/
+class RangeAllocator {
+ public:
+  static constexpr uint32_t INVALID = UINT32_MAX;
+
+  explicit RangeAllocator(uint64_t size);
+
+  // returns a handle to a range whose offset is a multiple of alignment (a power of two), INVALID when nothing fits
+  uint32_t allocate(uint64_t size, uint64_t alignment);
+  void     free(uint32_t handle);
+
+  uint64_t offset(uint32_t handle) const {
+    return _ranges[handle].offset;
+  }
+
+  uint64_t size() const {
+    return _size;
+  }
+
+  uint64_t usedBytes() const {
+    return _usedBytes;
+  }
+
+  uint32_t allocationCount() const {
+    return _allocationCount;
+  }
+
+  uint32_t freeRangeCount() const {
+    return _freeRangeCount;
+  }
+
+  uint64_t largestFreeRange() const;
+
+ private:
+  static constexpr uint32_t SUBDIVISION_BITS  = 5;
+  static constexpr uint32_t SUBDIVISION_COUNT = 1 << SUBDIVISION_BITS;
+  static constexpr uint32_t LEVEL_COUNT       = 64 - SUBDIVISION_BITS + 1;
+
+  struct Range {
+    uint64_t offset;
+    uint64_t size;
+    uint32_t previous;      // physical neighbours
+    uint32_t next;
+    uint32_t previousFree;  // links of the free list the range is in
+    uint32_t nextFree;
+    bool     free;
+  };
+
+  uint64_t              _size;
+  std::vector<Range>    _ranges;
+  std::vector<uint32_t> _unusedRanges;
+  uint64_t              _levelBitmap              = 0;
+  uint32_t              _listBitmaps[LEVEL_COUNT] = {};
+  uint32_t              _freeLists[LEVEL_COUNT][SUBDIVISION_COUNT];
+  uint64_t              _usedBytes       = 0;
+  uint32_t              _allocationCount = 0;
+  uint32_t              _freeRangeCount  = 0;
+
+  static void mapSize(uint64_t size, uint32_t& level, uint32_t& list);
+
+  uint32_t createRange(uint64_t offset, uint64_t size);
+  void     releaseRange(uint32_t index);
+  void     insertFree(uint32_t index);
+  void     removeFree(uint32_t index);
+  uint32_t findFree(uint64_t size, uint64_t alignment) const;
+};
@@ -0,0 +1,42 @@
+#include "./sourcekey.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <vector>
+
+#include "./hash.h"
+#include "./parallel.h"
+
+namespace {
+
+const size_t HASH_CHUNK_SIZE = 4 << 20;
+
+// hashes fixed-size chunks in parallel and combines the chunk hashes
+uint64_t hashContents(const char* data, size_t size) {
+  std::vector<uint64_t> chunkHashes((size + HASH_CHUNK_SIZE - 1) / HASH_CHUNK_SIZE);
+
+  parallelFor(chunkHashes.size(), [&](size_t i) {
+    size_t offset  = i * HASH_CHUNK_SIZE;
+    chunkHashes[i] = hash64(data + offset, std::min(HASH_CHUNK_SIZE, size - offset));
+  });
+
+  return hash64(chunkHashes.data(), chunkHashes.size() * sizeof(uint64_t), size);
+}
+
+}  // namespace
+
+SourceKey makeSourceKey(const std::string& path, const MappedFile& source) {
+  std::error_code error;
+  auto            modified = std::filesystem::last_write_time(path, error);
+
+  SourceKey key;
+  key.pathHash    = hash64(path.data(), path.size());
+  key.size        = source.size();
+  key.modified    = error ? 0 : static_cast<int64_t>(modified.time_since_epoch().count());
+  key.contentHash = hashContents(source.data(), source.size());
+  return key;
+}
+
+bool sameSourceKey(const SourceKey& a, const SourceKey& b) {
+  return a.pathHash == b.pathHash && a.size == b.size && a.modified == b.modified && a.contentHash == b.contentHash;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "./mappedfile.h"
+
+// Identifies the source file a cache was built from: path, size, modification time and content hash.
+struct SourceKey {
+  uint64_t pathHash;
+  uint64_t size;
+  int64_t  modified;
+  uint64_t contentHash;
+};
+
+// the contents are hashed in fixed-size chunks across all cores
+SourceKey makeSourceKey(const std::string& path, const MappedFile& source);
+
+bool sameSourceKey(const SourceKey& a, const SourceKey& b);
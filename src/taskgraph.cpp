@@ -0,0 +1,155 @@
+#include "./taskgraph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "./parallel.h"
+#include "./profiler.h"
+
+// left by an exception before finish(), the workers still run what does not depend on a failed task
+TaskGraph::~TaskGraph() {
+  for (std::thread& worker : _workers) {
+    worker.join();
+  }
+}
+
+TaskGraph::TaskId TaskGraph::add(std::string name, std::initializer_list<TaskId> dependencies,
+                                 std::function<void()> work) {
+  TaskId id = _tasks.size();
+
+  Task task;
+  task.profileName  = internProfileName(name);
+  task.name         = std::move(name);
+  task.work         = std::move(work);
+  task.dependencies = dependencies;
+  task.pending      = dependencies.size();
+
+  for (TaskId dependency : dependencies) {
+    if (dependency >= id) {
+      throw std::invalid_argument("task dependencies have to be added first!");
+    }
+    _tasks[dependency].dependents.push_back(id);
+  }
+
+  _tasks.push_back(std::move(task));
+  return id;
+}
+
+void TaskGraph::start(unsigned int threadCount) {
+  if (threadCount == 0) {
+    threadCount = workerThreadCount();
+  }
+  threadCount = static_cast<unsigned int>(std::min<size_t>(threadCount, std::max<size_t>(_tasks.size(), 1)));
+
+  for (TaskId id = 0; id < _tasks.size(); id++) {
+    if (_tasks[id].pending == 0) {
+      _ready.push_back(id);
+    }
+  }
+
+  _threadCount = threadCount;
+  _startTime   = std::chrono::high_resolution_clock::now();
+  for (unsigned int t = 0; t < threadCount; t++) {
+    _workers.emplace_back(&TaskGraph::work, this);
+  }
+}
+
+void TaskGraph::wait(TaskId task) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _taskFinished.wait(lock, [&] { return _tasks[task].finished; });
+
+  if (_tasks[task].failed) {
+    std::rethrow_exception(_error);
+  }
+}
+
+void TaskGraph::finish() {
+  for (std::thread& worker : _workers) {
+    worker.join();
+  }
+  _workers.clear();
+
+  if (_error) {
+    std::rethrow_exception(_error);
+  }
+}
+
+float TaskGraph::elapsed() const {
+  auto now = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<float, std::chrono::milliseconds::period>(now - _startTime).count();
+}
+
+void TaskGraph::work() {
+  setProfileThreadName("task graph worker");
+
+  std::unique_lock<std::mutex> lock(_mutex);
+  for (;;) {
+    _readyChanged.wait(lock, [&] { return !_ready.empty() || _finishedCount == _tasks.size(); });
+    if (_ready.empty()) {
+      return;
+    }
+
+    // oldest first, tasks become ready roughly in the order they were declared
+    TaskId id = _ready.front();
+    _ready.erase(_ready.begin());
+    Task& task = _tasks[id];
+
+    bool dependencyFailed = std::any_of(task.dependencies.begin(), task.dependencies.end(),
+                                        [&](TaskId dependency) { return _tasks[dependency].failed; });
+
+    task.start = elapsed();
+    if (!dependencyFailed) {
+      lock.unlock();
+      std::exception_ptr error;
+      try {
+        PROFILE_ZONE(task.profileName);
+        task.work();
+      } catch (...) {
+        error = std::current_exception();
+      }
+      lock.lock();
+
+      task.ran = true;
+      if (error) {
+        task.failed = true;
+        if (!_error) {
+          _error = error;
+        }
+      }
+    } else {
+      task.failed = true;
+    }
+    task.end      = elapsed();
+    task.finished = true;
+    _finishedCount++;
+
+    for (TaskId dependent : task.dependents) {
+      if (--_tasks[dependent].pending == 0) {
+        _ready.push_back(dependent);
+      }
+    }
+
+    _readyChanged.notify_all();
+    _taskFinished.notify_all();
+  }
+}
+
+TaskGraph::TaskTiming TaskGraph::timing(TaskId task) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  const Task&                 t = _tasks[task];
+  return {t.name, t.start, t.end - t.start, t.ran};
+}
+
+std::vector<TaskGraph::TaskId> TaskGraph::criticalPath(TaskId task) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  std::vector<TaskId> path = {task};
+  while (!_tasks[path.back()].dependencies.empty()) {
+    const std::vector<TaskId>& dependencies = _tasks[path.back()].dependencies;
+    path.push_back(*std::max_element(dependencies.begin(), dependencies.end(),
+                                     [&](TaskId a, TaskId b) { return _tasks[a].end < _tasks[b].end; }));
+  }
+
+  std::reverse(path.begin(), path.end());
+  return path;
+}
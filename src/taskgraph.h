@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+Runs tasks on a pool of worker threads as soon as the tasks they depend on have finished. Every task is timed, so
+after a run the chain of tasks that decided when a given task could finish, its critical path, can be read back.
+
+Tasks are added before start(). A task that throws fails, tasks depending on it fail without running; wait() and
+finish() rethrow the first exception. wait() may be called from any thread that is not a worker, finish() from the
+one that called start().
+*/
+class TaskGraph {
+ public:
+  using TaskId = size_t;
+
+  struct TaskTiming {
+    std::string name;
+    float       start;     // ms since start()
+    float       duration;  // ms
+    bool        ran;       // false when a dependency failed
+  };
+
+  ~TaskGraph();
+
+  TaskId add(std::string name, std::initializer_list<TaskId> dependencies, std::function<void()> work);
+
+  // spawns min(threadCount, tasks) workers, 0 = all cores
+  void start(unsigned int threadCount = 0);
+
+  // blocks until task has finished
+  void wait(TaskId task);
+  // blocks until every task has finished and joins the workers
+  void finish();
+
+  size_t taskCount() const {
+    return _tasks.size();
+  }
+
+  unsigned int threadCount() const {
+    return _threadCount;
+  }
+
+  TaskTiming timing(TaskId task) const;
+
+  // from the first task to task, each one the dependency that finished last; only valid for finished tasks
+  std::vector<TaskId> criticalPath(TaskId task) const;
+
+ private:
+  struct Task {
+    std::string           name;
+    const char*           profileName;
+    std::function<void()> work;
+    std::vector<TaskId>   dependencies;
+    std::vector<TaskId>   dependents;
+    size_t                pending  = 0;  // dependencies not finished yet
+    bool                  finished = false;
+    bool                  failed   = false;
+    bool                  ran      = false;
+    float                 start    = 0.0f;
+    float                 end      = 0.0f;
+  };
+
+  std::vector<Task>        _tasks;
+  std::vector<TaskId>      _ready;
+  size_t                   _finishedCount = 0;
+  std::exception_ptr       _error;
+  std::vector<std::thread> _workers;
+  unsigned int             _threadCount = 0;
+
+  std::chrono::high_resolution_clock::time_point _startTime;
+
+  mutable std::mutex      _mutex;
+  std::condition_variable _readyChanged;
+  std::condition_variable _taskFinished;
+
+  void  work();
+  float elapsed() const;
+};
@@ -0,0 +1,264 @@
+#include "./texturecache.h"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+const uint8_t  KTX2_IDENTIFIER[12]   = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+const char     KTX2_WRITER_KEY[]     = "KTXwriter";
+const char     KTX2_WRITER[]         = "vk-hello-triangle";
+const char     SOURCE_KEY[]          = "VKHT.source";  // entries are sorted by key, this one follows KTXwriter
+const uint32_t TEXTURE_CACHE_VERSION = 1;
+
+// data format descriptor values from the Khronos Data Format Specification
+const uint32_t KHR_DF_VERSION_1_3     = 2;
+const uint32_t KHR_DF_MODEL_BC1A      = 128;
+const uint32_t KHR_DF_MODEL_BC7       = 134;
+const uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+const uint32_t KHR_DF_TRANSFER_SRGB   = 2;
+
+struct Ktx2Header {
+  uint8_t  identifier[12];
+  uint32_t vkFormat;
+  uint32_t typeSize;
+  uint32_t pixelWidth;
+  uint32_t pixelHeight;
+  uint32_t pixelDepth;
+  uint32_t layerCount;
+  uint32_t faceCount;
+  uint32_t levelCount;
+  uint32_t supercompressionScheme;
+  uint32_t dfdByteOffset;
+  uint32_t dfdByteLength;
+  uint32_t kvdByteOffset;
+  uint32_t kvdByteLength;
+  uint64_t sgdByteOffset;
+  uint64_t sgdByteLength;
+};
+static_assert(sizeof(Ktx2Header) == 80, "KTX2 header must not be padded");
+
+struct Ktx2Level {
+  uint64_t byteOffset;
+  uint64_t byteLength;
+  uint64_t uncompressedByteLength;
+};
+
+// value of the SOURCE_KEY entry
+struct TextureCacheSource {
+  uint32_t  version;
+  uint32_t  format;
+  SourceKey source;
+};
+
+size_t alignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+VkFormat vkFormatOf(BlockFormat format) {
+  return format == BlockFormat::BC1 ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC7_SRGB_BLOCK;
+}
+
+// basic descriptor block with a single sample covering the whole 4x4 block
+std::vector<uint32_t> dataFormatDescriptor(BlockFormat format) {
+  uint32_t model = format == BlockFormat::BC1 ? KHR_DF_MODEL_BC1A : KHR_DF_MODEL_BC7;
+  uint32_t bytes = static_cast<uint32_t>(blockBytes(format));
+
+  std::vector<uint32_t> words = {
+      0,                                                                     // total size, filled in below
+      0,                                                                     // Khronos vendor, basic descriptor
+      KHR_DF_VERSION_1_3 | (40u << 16),                                      // block size 24 + 16 per sample
+      model | (KHR_DF_PRIMARIES_BT709 << 8) | (KHR_DF_TRANSFER_SRGB << 16),  // straight alpha
+      3 | (3 << 8),                                                          // 4x4 texels, stored as size - 1
+      bytes,                                                                 // bytes in plane 0
+      0,                                                                     // planes 4 to 7
+      (bytes * 8 - 1) << 16,                                                 // sample at bit 0, color channel
+      0,                                                                     // sample position
+      0,                                                                     // sample lower
+      0xFFFFFFFF,                                                            // sample upper
+  };
+  words[0] = static_cast<uint32_t>(words.size() * sizeof(uint32_t));
+  return words;
+}
+
+void appendKeyValue(std::vector<uint8_t>& kvd, const char* key, const void* value, size_t valueSize) {
+  uint32_t length = static_cast<uint32_t>(strlen(key) + 1 + valueSize);
+  size_t   offset = kvd.size();
+  kvd.resize(alignUp(offset + sizeof(length) + length, 4));
+  memcpy(kvd.data() + offset, &length, sizeof(length));
+  memcpy(kvd.data() + offset + sizeof(length), key, strlen(key) + 1);
+  memcpy(kvd.data() + offset + sizeof(length) + strlen(key) + 1, value, valueSize);
+}
+
+// finds the value of key in the key/value data, returns nullptr when it is missing
+const uint8_t* findValue(const uint8_t* kvd, size_t kvdSize, const char* key, size_t& valueSize) {
+  size_t keySize = strlen(key) + 1;
+  size_t offset  = 0;
+  while (offset + sizeof(uint32_t) <= kvdSize) {
+    uint32_t length;
+    memcpy(&length, kvd + offset, sizeof(length));
+    offset += sizeof(length);
+    if (length > kvdSize - offset) {
+      return nullptr;
+    }
+    if (length >= keySize && memcmp(kvd + offset, key, keySize) == 0) {
+      valueSize = length - keySize;
+      return kvd + offset + keySize;
+    }
+    offset = alignUp(offset + length, 4);
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+std::string TextureCache::cachePath() const {
+  return _sourcePath + (_format == BlockFormat::BC1 ? ".bc1.ktx2" : ".bc7.ktx2");
+}
+
+bool TextureCache::open(const std::string& sourcePath, BlockFormat format) {
+  _sourcePath = sourcePath;
+  _format     = format;
+  _valid      = false;
+  _levels.clear();
+  _file.close();
+
+  MappedFile source;
+  if (!source.open(sourcePath)) {
+    return false;
+  }
+  _key = makeSourceKey(sourcePath, source);
+
+  if (!_file.open(cachePath()) || _file.size() < sizeof(Ktx2Header)) {
+    _file.close();
+    return false;
+  }
+
+  Ktx2Header header;
+  memcpy(&header, _file.data(), sizeof(header));
+
+  bool valid = memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0 &&
+               header.vkFormat == static_cast<uint32_t>(vkFormatOf(format)) && header.typeSize == 1 &&
+               header.pixelDepth == 0 && header.layerCount == 0 && header.faceCount == 1 && header.levelCount > 0 &&
+               header.supercompressionScheme == 0 &&
+               sizeof(header) + header.levelCount * sizeof(Ktx2Level) <= _file.size() &&
+               static_cast<size_t>(header.kvdByteOffset) + header.kvdByteLength <= _file.size();
+
+  // the key/value data has to carry the key of this exact source
+  if (valid) {
+    size_t         valueSize = 0;
+    const uint8_t* value     = findValue(data() + header.kvdByteOffset, header.kvdByteLength, SOURCE_KEY, valueSize);
+
+    TextureCacheSource cached = {};
+    if (value && valueSize == sizeof(cached)) {
+      memcpy(&cached, value, sizeof(cached));
+    }
+    valid = cached.version == TEXTURE_CACHE_VERSION && cached.format == static_cast<uint32_t>(format) &&
+            sameSourceKey(cached.source, _key);
+  }
+
+  uint32_t width  = header.pixelWidth;
+  uint32_t height = header.pixelHeight;
+  for (uint32_t i = 0; valid && i < header.levelCount; i++) {
+    Ktx2Level level;
+    memcpy(&level, _file.data() + sizeof(header) + i * sizeof(Ktx2Level), sizeof(level));
+
+    MipLevel mip;
+    mip.width  = width;
+    mip.height = height;
+    mip.offset = static_cast<size_t>(level.byteOffset);
+    mip.size   = static_cast<size_t>(level.byteLength);
+    _levels.push_back(mip);
+
+    valid  = level.byteLength == compressedSize(width, height, format) && level.byteOffset <= _file.size() &&
+             level.byteLength <= _file.size() - level.byteOffset;
+    width  = std::max(width / 2, 1u);
+    height = std::max(height / 2, 1u);
+  }
+
+  if (!valid) {
+    _levels.clear();
+    _file.close();
+    return false;
+  }
+
+  _valid = true;
+  return true;
+}
+
+bool TextureCache::write(const std::vector<MipLevel>& levels, const uint8_t* data) {
+  if (levels.empty()) {
+    return false;
+  }
+
+  std::vector<uint32_t> dfd = dataFormatDescriptor(_format);
+
+  TextureCacheSource source = {};
+  source.version            = TEXTURE_CACHE_VERSION;
+  source.format             = static_cast<uint32_t>(_format);
+  source.source             = _key;
+
+  std::vector<uint8_t> kvd;
+  appendKeyValue(kvd, KTX2_WRITER_KEY, KTX2_WRITER, sizeof(KTX2_WRITER));
+  appendKeyValue(kvd, SOURCE_KEY, &source, sizeof(source));
+
+  Ktx2Header header = {};
+  memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+  header.vkFormat      = static_cast<uint32_t>(vkFormatOf(_format));
+  header.typeSize      = 1;
+  header.pixelWidth    = levels[0].width;
+  header.pixelHeight   = levels[0].height;
+  header.faceCount     = 1;
+  header.levelCount    = static_cast<uint32_t>(levels.size());
+  header.dfdByteOffset = static_cast<uint32_t>(sizeof(header) + levels.size() * sizeof(Ktx2Level));
+  header.dfdByteLength = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+  header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+  header.kvdByteLength = static_cast<uint32_t>(kvd.size());
+
+  // KTX2 stores the smallest level first, each aligned to the block size
+  size_t                 alignment = blockBytes(_format);
+  std::vector<Ktx2Level> index(levels.size());
+  size_t                 offset = header.kvdByteOffset + header.kvdByteLength;
+  for (size_t i = levels.size(); i-- > 0;) {
+    offset                          = alignUp(offset, alignment);
+    index[i].byteOffset             = offset;
+    index[i].byteLength             = levels[i].size;
+    index[i].uncompressedByteLength = levels[i].size;
+    offset += levels[i].size;
+  }
+
+  // write to a temporary file first so a crash never leaves a truncated cache behind
+  std::string tempPath = cachePath() + ".tmp";
+  {
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      return false;
+    }
+
+    const char padding[16] = {};
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(Ktx2Level));
+    file.write(reinterpret_cast<const char*>(dfd.data()), dfd.size() * sizeof(uint32_t));
+    file.write(reinterpret_cast<const char*>(kvd.data()), kvd.size());
+
+    size_t position = header.kvdByteOffset + header.kvdByteLength;
+    for (size_t i = levels.size(); i-- > 0;) {
+      file.write(padding, index[i].byteOffset - position);
+      file.write(reinterpret_cast<const char*>(data + levels[i].offset), levels[i].size);
+      position = index[i].byteOffset + levels[i].size;
+    }
+
+    if (!file.good()) {
+      return false;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(tempPath, cachePath(), error);
+  return !error;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "./blockcompression.h"
+#include "./mappedfile.h"
+#include "./mipmap.h"
+#include "./sourcekey.h"
+
+/*
+KTX2 file holding every block compressed mip level of a texture, stored next to it as <texture>.bc1.ktx2 or
+<texture>.bc7.ktx2. The key of the source texture is kept in a key/value entry, a cache is only used when it matches
+and the levels are then uploaded straight out of the mapping. The files are plain KTX2 with an sRGB data format
+descriptor, so external tools can open them too.
+*/
+class TextureCache {
+ public:
+  // maps the cache belonging to sourcePath, returns false when it is missing or stale
+  bool open(const std::string& sourcePath, BlockFormat format);
+
+  // writes a fresh cache for the source passed to open(); levels run from the full size down and their offsets are
+  // relative to data. Returns false on I/O errors.
+  bool write(const std::vector<MipLevel>& levels, const uint8_t* data);
+
+  bool isValid() const {
+    return _valid;
+  }
+
+  // level offsets are relative to data(), level 0 is the full size
+  const std::vector<MipLevel>& levels() const {
+    return _levels;
+  }
+
+  const uint8_t* data() const {
+    return reinterpret_cast<const uint8_t*>(_file.data());
+  }
+
+ private:
+  std::string           _sourcePath;
+  BlockFormat           _format = BlockFormat::BC7;
+  SourceKey             _key    = {};  // computed by open() and reused by write()
+  MappedFile            _file;
+  std::vector<MipLevel> _levels;
+  bool                  _valid = false;
+
+  std::string cachePath() const;
+};
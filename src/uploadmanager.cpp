@@ -0,0 +1,232 @@
+#include "./uploadmanager.h"
+
+#include <stdexcept>
+
+#include "./profiler.h"
+
+namespace {
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+void UploadManager::init(VkDevice device, VkQueue queue, uint32_t queueFamily, GpuAllocator& allocator,
+                         VkDeviceSize ringSize) {
+  _device    = device;
+  _queue     = queue;
+  _allocator = &allocator;
+
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType                   = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.queueFamilyIndex        = queueFamily;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+  if (vkCreateCommandPool(_device, &poolInfo, nullptr, &_commandPool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create upload command pool!");
+  }
+
+  VkCommandBufferAllocateInfo allocInfo = {};
+  allocInfo.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.commandPool                 = _commandPool;
+  allocInfo.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount          = 1;
+
+  VkFenceCreateInfo fenceInfo = {};
+  fenceInfo.sType             = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+  for (Batch& batch : _batches) {
+    if (vkAllocateCommandBuffers(_device, &allocInfo, &batch.commandBuffer) != VK_SUCCESS ||
+        vkCreateFence(_device, &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create upload batches!");
+    }
+  }
+
+  _ringSize = ringSize;
+  _ring     = createStagingBuffer(ringSize, _ringMemory);
+}
+
+void UploadManager::destroy() {
+  finish();
+
+  for (Batch& batch : _batches) {
+    vkDestroyFence(_device, batch.fence, nullptr);
+  }
+  vkDestroyCommandPool(_device, _commandPool, nullptr);
+
+  vkDestroyBuffer(_device, _ring, nullptr);
+  _allocator->free(_ringMemory);
+}
+
+VkBuffer UploadManager::createStagingBuffer(VkDeviceSize size, GpuAllocation& allocation) {
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size               = size;
+  bufferInfo.usage              = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  bufferInfo.sharingMode        = VK_SHARING_MODE_EXCLUSIVE;
+
+  VkBuffer buffer;
+  if (vkCreateBuffer(_device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create staging buffer!");
+  }
+
+  VkMemoryRequirements memRequirements;
+  vkGetBufferMemoryRequirements(_device, buffer, &memRequirements);
+
+  allocation = _allocator->allocate(memRequirements,
+                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, false);
+  vkBindBufferMemory(_device, buffer, allocation.memory, allocation.offset);
+  return buffer;
+}
+
+StagingRange UploadManager::stage(VkDeviceSize size, VkDeviceSize alignment) {
+  _stagedBytes += size;
+
+  StagingRange range;
+  if (size > _ringSize) {
+    GpuAllocation allocation;
+    range.buffer = createStagingBuffer(size, allocation);
+    range.data   = static_cast<uint8_t*>(allocation.mapped);
+
+    commandBuffer();
+    _batches[_current].buffers.push_back(range.buffer);
+    _batches[_current].allocations.push_back(allocation);
+    return range;
+  }
+
+  for (;;) {
+    // nothing staged is in use any more, start over at the beginning of the ring
+    if (_tail == _head) {
+      _head = alignUp(_head, _ringSize);
+      _tail = _head;
+    }
+
+    // a range never wraps around the end of the ring, the rest of the lap is skipped instead
+    uint64_t start = alignUp(_head, alignment);
+    if (start % _ringSize + size > _ringSize) {
+      start = alignUp(start, _ringSize);
+    }
+    if (start + size - _tail <= _ringSize) {
+      _head        = start + size;
+      range.buffer = _ring;
+      range.offset = start % _ringSize;
+      range.data   = static_cast<uint8_t*>(_ringMemory.mapped) + range.offset;
+      break;
+    }
+
+    // the ring is full, the batch being recorded holds space too and can only give it back once submitted
+    submit();
+    retire(true);
+  }
+
+  commandBuffer();
+  return range;
+}
+
+VkCommandBuffer UploadManager::commandBuffer() {
+  Batch& batch = _batches[_current];
+  if (!_recording) {
+    // batches are reused round robin, the oldest one in flight is the one up next
+    if (_submitted.size() == BATCH_COUNT) {
+      retire(true);
+    }
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkResetCommandBuffer(batch.commandBuffer, 0);
+    if (vkBeginCommandBuffer(batch.commandBuffer, &beginInfo) != VK_SUCCESS) {
+      throw std::runtime_error("failed to begin recording upload command buffer!");
+    }
+    _recording = true;
+  }
+  return batch.commandBuffer;
+}
+
+void UploadManager::submit(VkSemaphore signalSemaphore, VkSemaphore waitSemaphore, VkPipelineStageFlags waitStage) {
+  if (!_recording && signalSemaphore == VK_NULL_HANDLE && waitSemaphore == VK_NULL_HANDLE) {
+    return;
+  }
+  PROFILE_ZONE("upload submit");
+  Batch& batch = _batches[_current];
+  commandBuffer();
+
+  // vertex input, index reads and shader reads in later submissions all see the copies
+  VkMemoryBarrier barrier = {};
+  barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask   = VK_ACCESS_MEMORY_READ_BIT;
+  vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1,
+                       &barrier, 0, nullptr, 0, nullptr);
+
+  if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record upload command buffer!");
+  }
+
+  VkSubmitInfo submitInfo       = {};
+  submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers    = &batch.commandBuffer;
+  if (signalSemaphore != VK_NULL_HANDLE) {
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores    = &signalSemaphore;
+  }
+  if (waitSemaphore != VK_NULL_HANDLE) {
+    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pWaitSemaphores    = &waitSemaphore;
+    submitInfo.pWaitDstStageMask  = &waitStage;
+  }
+
+  vkResetFences(_device, 1, &batch.fence);
+  if (vkQueueSubmit(_queue, 1, &submitInfo, batch.fence) != VK_SUCCESS) {
+    throw std::runtime_error("failed to submit upload command buffer!");
+  }
+
+  batch.ringEnd = _head;
+  _submitted.push_back(_current);
+  _current   = (_current + 1) % BATCH_COUNT;
+  _recording = false;
+  _batchCount++;
+
+  retire(false);
+}
+
+void UploadManager::finish() {
+  submit();
+  while (!_submitted.empty()) {
+    retire(true);
+  }
+}
+
+// hands back the staging of completed batches in submission order; with wait the oldest one is waited for first
+void UploadManager::retire(bool wait) {
+  while (!_submitted.empty()) {
+    Batch& batch = _batches[_submitted.front()];
+    if (vkGetFenceStatus(_device, batch.fence) != VK_SUCCESS) {
+      if (!wait) {
+        return;
+      }
+      {
+        PROFILE_ZONE("upload fence wait");
+        vkWaitForFences(_device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+      }
+      _fenceWaitCount++;
+      wait = false;
+    }
+
+    _tail = batch.ringEnd;
+    release(batch);
+    _submitted.pop_front();
+  }
+}
+
+void UploadManager::release(Batch& batch) {
+  for (size_t i = 0; i < batch.buffers.size(); i++) {
+    vkDestroyBuffer(_device, batch.buffers[i], nullptr);
+    _allocator->free(batch.allocations[i]);
+  }
+  batch.buffers.clear();
+  batch.allocations.clear();
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "./gpuallocator.h"
+
+// Staging memory handed out by UploadManager::stage, copy from buffer at offset.
+struct StagingRange {
+  VkBuffer     buffer = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  uint8_t*     data   = nullptr;  // mapped, host coherent
+};
+
+/*
+Batches uploads into one command buffer instead of a submit and vkQueueWaitIdle per copy. Staging space comes from a
+persistently mapped ring buffer; every batch remembers how far into the ring it staged and its fence hands that space
+back once the GPU is done with it. Requests larger than the whole ring get a staging buffer of their own that is
+released with the batch.
+
+stage() may submit the current batch to make room, so fetch commandBuffer() after staging and record the copy right
+away. Each batch ends with a barrier that makes its transfer writes visible to everything submitted after it on the
+same queue, submit() therefore never has to wait for the GPU.
+*/
+class UploadManager {
+ public:
+  static constexpr uint32_t BATCH_COUNT = 4;
+
+  void init(VkDevice device, VkQueue queue, uint32_t queueFamily, GpuAllocator& allocator,
+            VkDeviceSize ringSize = VkDeviceSize(32) << 20);
+
+  // waits for every batch and frees the ring
+  void destroy();
+
+  StagingRange    stage(VkDeviceSize size, VkDeviceSize alignment = 16);
+  VkCommandBuffer commandBuffer();  // the batch being recorded, begun on first use
+
+  // submits the batch being recorded, if any, without waiting for it; with semaphores a batch is submitted even when
+  // nothing was recorded, ordering work on another queue against it
+  void submit(VkSemaphore signalSemaphore = VK_NULL_HANDLE, VkSemaphore waitSemaphore = VK_NULL_HANDLE,
+              VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+  // waits until every submitted batch has completed
+  void finish();
+
+  uint32_t batchCount() const {
+    return _batchCount;
+  }
+
+  // times the CPU blocked on a batch fence, because the ring or the batch slots ran out or in finish()
+  uint32_t fenceWaitCount() const {
+    return _fenceWaitCount;
+  }
+
+  VkDeviceSize stagedBytes() const {
+    return _stagedBytes;
+  }
+
+ private:
+  struct Batch {
+    VkCommandBuffer            commandBuffer = VK_NULL_HANDLE;
+    VkFence                    fence         = VK_NULL_HANDLE;
+    uint64_t                   ringEnd       = 0;  // _head when the batch was submitted
+    std::vector<VkBuffer>      buffers;            // oversized staging, released with the batch
+    std::vector<GpuAllocation> allocations;
+  };
+
+  VkDevice      _device    = VK_NULL_HANDLE;
+  VkQueue       _queue     = VK_NULL_HANDLE;
+  GpuAllocator* _allocator = nullptr;
+  VkCommandPool _commandPool;
+
+  VkBuffer      _ring;
+  GpuAllocation _ringMemory;
+  VkDeviceSize  _ringSize = 0;
+  uint64_t      _head     = 0;  // both count bytes ever staged, the ring position is the count modulo _ringSize
+  uint64_t      _tail     = 0;  // start of the oldest staging still in use
+
+  Batch                _batches[BATCH_COUNT];
+  uint32_t             _current   = 0;
+  bool                 _recording = false;
+  std::deque<uint32_t> _submitted;  // batches in flight, oldest first
+
+  uint32_t     _batchCount     = 0;
+  uint32_t     _fenceWaitCount = 0;
+  VkDeviceSize _stagedBytes    = 0;
+
+  VkBuffer createStagingBuffer(VkDeviceSize size, GpuAllocation& allocation);
+  void     retire(bool wait);
+  void     release(Batch& batch);
+};
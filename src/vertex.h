@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+
+#include "./hash.h"
+
+struct Vertex {
+  glm::vec3 pos;
+  glm::vec3 color;
+  glm::vec2 texCoord;
+
+  // bitwise like std::hash<Vertex>, so -0.0f and 0.0f stay distinct vertices and a NaN matches itself
+  bool operator==(const Vertex& other) const {
+    return memcmp(this, &other, sizeof(Vertex)) == 0;
+  }
+
+  static VkVertexInputBindingDescription getBindingDescription() {
+    VkVertexInputBindingDescription bindingDescription = {};
+    bindingDescription.binding                         = 0;
+    bindingDescription.stride                          = sizeof(Vertex);
+    bindingDescription.inputRate                       = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    return bindingDescription;
+  }
+
+  static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions() {
+    std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions = {};
+
+    attributeDescriptions[0].binding  = 0;
+    attributeDescriptions[0].location = 0;
+    attributeDescriptions[0].format   = VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[0].offset   = offsetof(Vertex, pos);
+
+    attributeDescriptions[1].binding  = 0;
+    attributeDescriptions[1].location = 1;
+    attributeDescriptions[1].format   = VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[1].offset   = offsetof(Vertex, color);
+
+    attributeDescriptions[2].binding  = 0;
+    attributeDescriptions[2].location = 2;
+    attributeDescriptions[2].format   = VK_FORMAT_R32G32_SFLOAT;
+    attributeDescriptions[2].offset   = offsetof(Vertex, texCoord);
+
+    return attributeDescriptions;
+  }
+};
+
+/*
+Compact 12 byte layout used for the vertex buffer: positions are 16 bit UNORM within the mesh bounds and texture
+coordinates are half floats. The color is dropped, loadModel always writes white.
+*/
+struct PackedVertex {
+  uint16_t pos[4];  // w is padding, R16G16B16A16 is the smallest 16 bit position format every device supports
+  uint16_t texCoord[2];
+
+  static VkVertexInputBindingDescription getBindingDescription() {
+    VkVertexInputBindingDescription bindingDescription = {};
+    bindingDescription.binding                         = 0;
+    bindingDescription.stride                          = sizeof(PackedVertex);
+    bindingDescription.inputRate                       = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    return bindingDescription;
+  }
+
+  static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() {
+    std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions = {};
+
+    attributeDescriptions[0].binding  = 0;
+    attributeDescriptions[0].location = 0;
+    attributeDescriptions[0].format   = VK_FORMAT_R16G16B16A16_UNORM;
+    attributeDescriptions[0].offset   = offsetof(PackedVertex, pos);
+
+    attributeDescriptions[1].binding  = 0;
+    attributeDescriptions[1].location = 2;
+    attributeDescriptions[1].format   = VK_FORMAT_R16G16_SFLOAT;
+    attributeDescriptions[1].offset   = offsetof(PackedVertex, texCoord);
+
+    return attributeDescriptions;
+  }
+};
+
+// Maps the UNORM positions of PackedVertex back into model space: pos = offset + unorm * scale.
+struct VertexQuantization {
+  glm::vec3 offset = glm::vec3(0.0f);
+  glm::vec3 scale  = glm::vec3(1.0f);
+
+  // folded into the model matrix, so the vertex shader dequantizes without extra instructions
+  glm::mat4 dequantizeMatrix() const {
+    return glm::scale(glm::translate(glm::mat4(1.0f), offset), scale);
+  }
+};
+
+// hashed and compared as raw bytes, padding would make equal vertices differ
+static_assert(sizeof(Vertex) == 8 * sizeof(float), "Vertex must not contain padding");
+
+namespace std {
+template <>
+struct hash<Vertex> {
+  size_t operator()(Vertex const& vertex) const {
+    return static_cast<size_t>(hash64(&vertex, sizeof(Vertex)));
+  }
+};
+}  // namespace std
@@ -0,0 +1,264 @@
+#include "./vertexdedup.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+#include "./hash.h"
+#include "./parallel.h"
+
+namespace {
+
+const uint32_t EMPTY_SLOT = UINT32_MAX;
+
+Vertex objVertex(const tinyobj::attrib_t& attrib, const tinyobj::index_t& index) {
+  Vertex vertex = {};
+
+  vertex.pos = {
+      attrib.vertices[3 * index.vertex_index + 0],
+      attrib.vertices[3 * index.vertex_index + 1],
+      attrib.vertices[3 * index.vertex_index + 2]};
+
+  vertex.texCoord = {
+      attrib.texcoords[2 * index.texcoord_index + 0],
+      1.0f - attrib.texcoords[2 * index.texcoord_index + 1]};
+
+  vertex.color = {1.0f, 1.0f, 1.0f};
+
+  return vertex;
+}
+
+inline uint64_t hashVertex(const Vertex& vertex) {
+  return hash64(&vertex, sizeof(Vertex));
+}
+
+inline bool sameVertex(const Vertex& a, const Vertex& b) {
+  return memcmp(&a, &b, sizeof(Vertex)) == 0;
+}
+
+size_t nextPowerOfTwo(size_t value) {
+  size_t result = 1;
+  while (result < value) result <<= 1;
+  return result;
+}
+
+size_t countIndices(const std::vector<tinyobj::shape_t>& shapes) {
+  size_t count = 0;
+  for (const auto& shape : shapes) {
+    count += shape.mesh.indices.size();
+  }
+  return count;
+}
+
+/*
+Linear probing over a power of two slot array. Every slot keeps the vertex index and the upper hash bits, so a probe
+only touches the vertex array when the tags match.
+*/
+class VertexTable {
+ public:
+  explicit VertexTable(size_t maxVertices) {
+    // every index may introduce a new vertex, keep the load factor below 0.8 even then
+    _slots.assign(nextPowerOfTwo(maxVertices + maxVertices / 4 + 1), {EMPTY_SLOT, 0});
+    _mask = _slots.size() - 1;
+  }
+
+  uint32_t insert(const Vertex& vertex, std::vector<Vertex>& vertices) {
+    uint64_t hash = hashVertex(vertex);
+    uint32_t tag  = static_cast<uint32_t>(hash >> 32);
+
+    for (size_t slot = hash & _mask;; slot = (slot + 1) & _mask) {
+      Slot& entry = _slots[slot];
+      if (entry.index == EMPTY_SLOT) {
+        entry.index = static_cast<uint32_t>(vertices.size());
+        entry.tag   = tag;
+        vertices.push_back(vertex);
+        _size++;
+        return entry.index;
+      }
+      if (entry.tag == tag && sameVertex(vertices[entry.index], vertex)) {
+        return entry.index;
+      }
+    }
+  }
+
+  size_t capacity() const {
+    return _slots.size();
+  }
+
+  float loadFactor() const {
+    return static_cast<float>(_size) / static_cast<float>(_slots.size());
+  }
+
+ private:
+  struct Slot {
+    uint32_t index;
+    uint32_t tag;
+  };
+
+  std::vector<Slot> _slots;
+  size_t            _mask = 0;
+  size_t            _size = 0;
+};
+
+void deduplicateHashTable(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes,
+                          std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, DedupStats* stats) {
+  size_t      indexCount = countIndices(shapes);
+  VertexTable table(indexCount);
+
+  vertices.reserve(vertices.size() + indexCount / 4);
+  indices.reserve(indices.size() + indexCount);
+
+  for (const auto& shape : shapes) {
+    for (const auto& index : shape.mesh.indices) {
+      indices.push_back(table.insert(objVertex(attrib, index), vertices));
+    }
+  }
+
+  if (stats) {
+    stats->tableCapacity = table.capacity();
+    stats->loadFactor    = table.loadFactor();
+  }
+}
+
+/*
+1. expand and hash the vertex of every index
+2. scatter the index positions into partitions by their top hash bits, each partition holds disjoint vertices
+3. sort every partition by (hash, bytes, position) and point each position at the first one of its run
+4. number the first occurrences in index order, which reproduces the HashTable output exactly
+*/
+void deduplicateParallelSort(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes,
+                             std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+  std::vector<const tinyobj::index_t*> objIndices;
+  objIndices.reserve(countIndices(shapes));
+  for (const auto& shape : shapes) {
+    for (const auto& index : shape.mesh.indices) {
+      objIndices.push_back(&index);
+    }
+  }
+
+  size_t       count       = objIndices.size();
+  unsigned int threadCount = workerThreadCount();
+  size_t       rangeCount  = std::max<size_t>(1, std::min<size_t>(threadCount, count / 4096));
+  size_t       rangeSize   = (count + rangeCount - 1) / rangeCount;
+
+  int    partitionBits  = 0;
+  size_t partitionCount = 1;
+  while (partitionCount < threadCount * 4 && partitionCount < count / 1024) {
+    partitionCount <<= 1;
+    partitionBits++;
+  }
+
+  auto partitionOf = [&](uint64_t hash) {
+    return partitionBits > 0 ? static_cast<size_t>(hash >> (64 - partitionBits)) : 0;
+  };
+
+  std::vector<Vertex>   expanded(count);
+  std::vector<uint64_t> hashes(count);
+  std::vector<size_t>   histograms(rangeCount * partitionCount, 0);
+
+  parallelFor(rangeCount, [&](size_t r) {
+    size_t* histogram = &histograms[r * partitionCount];
+    for (size_t i = r * rangeSize; i < std::min(count, (r + 1) * rangeSize); i++) {
+      expanded[i] = objVertex(attrib, *objIndices[i]);
+      hashes[i]   = hashVertex(expanded[i]);
+      histogram[partitionOf(hashes[i])]++;
+    }
+  });
+
+  // partition-major prefix sum, positions stay ascending inside every partition
+  std::vector<size_t> partitionStart(partitionCount + 1, 0);
+  size_t              offset = 0;
+  for (size_t p = 0; p < partitionCount; p++) {
+    partitionStart[p] = offset;
+    for (size_t r = 0; r < rangeCount; r++) {
+      size_t& slot = histograms[r * partitionCount + p];
+      size_t  size = slot;
+      slot         = offset;
+      offset += size;
+    }
+  }
+  partitionStart[partitionCount] = offset;
+
+  std::vector<uint32_t> order(count);
+  parallelFor(rangeCount, [&](size_t r) {
+    size_t* cursor = &histograms[r * partitionCount];
+    for (size_t i = r * rangeSize; i < std::min(count, (r + 1) * rangeSize); i++) {
+      order[cursor[partitionOf(hashes[i])]++] = static_cast<uint32_t>(i);
+    }
+  });
+
+  std::vector<uint32_t> firstOccurrence(count);
+  parallelFor(partitionCount, [&](size_t p) {
+    auto begin = order.begin() + partitionStart[p];
+    auto end   = order.begin() + partitionStart[p + 1];
+
+    std::sort(begin, end, [&](uint32_t a, uint32_t b) {
+      if (hashes[a] != hashes[b]) return hashes[a] < hashes[b];
+      int cmp = memcmp(&expanded[a], &expanded[b], sizeof(Vertex));
+      return cmp != 0 ? cmp < 0 : a < b;
+    });
+
+    for (auto run = begin; run != end;) {
+      auto next = run + 1;
+      while (next != end && hashes[*next] == hashes[*run] && sameVertex(expanded[*next], expanded[*run])) {
+        next++;
+      }
+      for (auto it = run; it != next; it++) {
+        firstOccurrence[*it] = *run;
+      }
+      run = next;
+    }
+  });
+
+  // number the first occurrences per range, then offset every range by its predecessors
+  std::vector<uint32_t> vertexIds(count);
+  std::vector<size_t>   rangeVertices(rangeCount + 1, 0);
+  parallelFor(rangeCount, [&](size_t r) {
+    for (size_t i = r * rangeSize; i < std::min(count, (r + 1) * rangeSize); i++) {
+      if (firstOccurrence[i] == i) rangeVertices[r + 1]++;
+    }
+  });
+  std::partial_sum(rangeVertices.begin(), rangeVertices.end(), rangeVertices.begin());
+
+  size_t firstVertex = vertices.size();
+  size_t firstIndex  = indices.size();
+  vertices.resize(firstVertex + rangeVertices[rangeCount]);
+  indices.resize(firstIndex + count);
+
+  parallelFor(rangeCount, [&](size_t r) {
+    size_t next = firstVertex + rangeVertices[r];
+    for (size_t i = r * rangeSize; i < std::min(count, (r + 1) * rangeSize); i++) {
+      if (firstOccurrence[i] == i) {
+        vertexIds[i]   = static_cast<uint32_t>(next);
+        vertices[next] = expanded[i];
+        next++;
+      }
+    }
+  });
+
+  // first occurrences precede their duplicates, so all ids are known here
+  parallelFor(rangeCount, [&](size_t r) {
+    for (size_t i = r * rangeSize; i < std::min(count, (r + 1) * rangeSize); i++) {
+      indices[firstIndex + i] = vertexIds[firstOccurrence[i]];
+    }
+  });
+}
+
+}  // namespace
+
+void deduplicateVertices(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes,
+                         std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, DedupMode mode,
+                         DedupStats* stats) {
+  if (stats) {
+    *stats = {};
+  }
+
+  switch (mode) {
+    case DedupMode::HashTable:
+      deduplicateHashTable(attrib, shapes, vertices, indices, stats);
+      break;
+    case DedupMode::ParallelSort:
+      deduplicateParallelSort(attrib, shapes, vertices, indices);
+      break;
+  }
+}
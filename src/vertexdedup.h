@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "./tiny_obj_loader.h"
+#include "./vertex.h"
+
+enum class DedupMode {
+  // single threaded open addressing table, one probe sequence per index
+  HashTable,
+  // per-thread sort of hash partitions followed by a merge, output is identical to HashTable
+  ParallelSort,
+};
+
+struct DedupStats {
+  size_t tableCapacity = 0;  // slots of the open addressing table, 0 for ParallelSort
+  float  loadFactor    = 0.0f;
+};
+
+/*
+Expands the triangulated OBJ faces into vertices and merges identical ones, vertices are compared bitwise and keep
+the order of their first occurrence. Replaces the std::unordered_map<Vertex, uint32_t> loop loadModel used to run,
+the hash table is sized from the face count up front so it never rehashes.
+*/
+void deduplicateVertices(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes,
+                         std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+                         DedupMode mode = DedupMode::HashTable, DedupStats* stats = nullptr);
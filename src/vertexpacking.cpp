@@ -0,0 +1,172 @@
+#include "./vertexpacking.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "./parallel.h"
+
+namespace {
+
+const float  UNORM16_MAX   = 65535.0f;
+const size_t PACK_JOB_SIZE = 1 << 16;
+
+inline uint16_t quantizeUnorm16(float value) {
+  return static_cast<uint16_t>(std::clamp(value, 0.0f, 1.0f) * UNORM16_MAX + 0.5f);
+}
+
+inline glm::vec3 dequantize(const PackedVertex& vertex, const VertexQuantization& quantization) {
+  glm::vec3 unorm(vertex.pos[0] / UNORM16_MAX, vertex.pos[1] / UNORM16_MAX, vertex.pos[2] / UNORM16_MAX);
+  return quantization.offset + unorm * quantization.scale;
+}
+
+size_t jobCount(size_t vertexCount) {
+  return (vertexCount + PACK_JOB_SIZE - 1) / PACK_JOB_SIZE;
+}
+
+}  // namespace
+
+// round to nearest even, overflow saturates to infinity, NaN stays NaN
+uint16_t floatToHalf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+
+  uint32_t sign     = (bits >> 16) & 0x8000;
+  int32_t  exponent = static_cast<int32_t>((bits >> 23) & 0xff) - 127 + 15;
+  uint32_t mantissa = bits & 0x7fffff;
+
+  if (((bits >> 23) & 0xff) == 0xff) {
+    return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+  }
+  if (exponent >= 31) {
+    return static_cast<uint16_t>(sign | 0x7c00);
+  }
+  if (exponent <= 0) {
+    if (exponent < -10) {
+      return static_cast<uint16_t>(sign);
+    }
+    // denormal: shift in the implicit bit
+    mantissa |= 0x800000;
+    uint32_t shift   = static_cast<uint32_t>(14 - exponent);
+    uint32_t half    = mantissa >> shift;
+    uint32_t rest    = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+    if (rest > halfway || (rest == halfway && (half & 1))) half++;
+    return static_cast<uint16_t>(sign | half);
+  }
+
+  uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+  uint32_t rest = mantissa & 0x1fff;
+  if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++;  // may carry into the exponent, which is correct
+  return static_cast<uint16_t>(half);
+}
+
+float halfToFloat(uint16_t value) {
+  uint32_t sign     = static_cast<uint32_t>(value & 0x8000) << 16;
+  uint32_t exponent = (value >> 10) & 0x1f;
+  uint32_t mantissa = value & 0x3ff;
+  uint32_t bits;
+
+  if (exponent == 0x1f) {
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  } else if (exponent != 0) {
+    bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+  } else if (mantissa != 0) {
+    // denormal: normalize
+    exponent = 127 - 15 + 1;
+    while ((mantissa & 0x400) == 0) {
+      mantissa <<= 1;
+      exponent--;
+    }
+    bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+  } else {
+    bits = sign;
+  }
+
+  float result;
+  memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+VertexQuantization computeQuantization(const Vertex* vertices, size_t vertexCount) {
+  VertexQuantization quantization;
+  if (vertexCount == 0) return quantization;
+
+  std::vector<glm::vec3> minimums(jobCount(vertexCount)), maximums(jobCount(vertexCount));
+  parallelFor(minimums.size(), [&](size_t job) {
+    size_t    end     = std::min(vertexCount, (job + 1) * PACK_JOB_SIZE);
+    glm::vec3 minimum = vertices[job * PACK_JOB_SIZE].pos;
+    glm::vec3 maximum = minimum;
+    for (size_t i = job * PACK_JOB_SIZE; i < end; i++) {
+      minimum = glm::min(minimum, vertices[i].pos);
+      maximum = glm::max(maximum, vertices[i].pos);
+    }
+    minimums[job] = minimum;
+    maximums[job] = maximum;
+  });
+
+  glm::vec3 minimum = minimums[0], maximum = maximums[0];
+  for (size_t job = 1; job < minimums.size(); job++) {
+    minimum = glm::min(minimum, minimums[job]);
+    maximum = glm::max(maximum, maximums[job]);
+  }
+
+  quantization.offset = minimum;
+  quantization.scale  = maximum - minimum;
+  for (int axis = 0; axis < 3; axis++) {
+    // flat meshes still need a usable matrix
+    if (quantization.scale[axis] <= 0.0f) quantization.scale[axis] = 1.0f;
+  }
+  return quantization;
+}
+
+void packVertices(const Vertex* vertices, size_t vertexCount, const VertexQuantization& quantization,
+                  PackedVertex* packed) {
+  glm::vec3 inverseScale = 1.0f / quantization.scale;
+
+  parallelFor(jobCount(vertexCount), [&](size_t job) {
+    size_t end = std::min(vertexCount, (job + 1) * PACK_JOB_SIZE);
+    for (size_t i = job * PACK_JOB_SIZE; i < end; i++) {
+      glm::vec3    unorm = (vertices[i].pos - quantization.offset) * inverseScale;
+      PackedVertex vertex;
+      vertex.pos[0]      = quantizeUnorm16(unorm.x);
+      vertex.pos[1]      = quantizeUnorm16(unorm.y);
+      vertex.pos[2]      = quantizeUnorm16(unorm.z);
+      vertex.pos[3]      = 0;
+      vertex.texCoord[0] = floatToHalf(vertices[i].texCoord.x);
+      vertex.texCoord[1] = floatToHalf(vertices[i].texCoord.y);
+      packed[i]          = vertex;
+    }
+  });
+}
+
+QuantizationError measureQuantizationError(const Vertex* vertices, const PackedVertex* packed, size_t vertexCount,
+                                           const VertexQuantization& quantization) {
+  QuantizationError result;
+  if (vertexCount == 0) return result;
+
+  std::vector<QuantizationError> jobErrors(jobCount(vertexCount));
+  parallelFor(jobErrors.size(), [&](size_t job) {
+    QuantizationError& error = jobErrors[job];
+    size_t             end   = std::min(vertexCount, (job + 1) * PACK_JOB_SIZE);
+    for (size_t i = job * PACK_JOB_SIZE; i < end; i++) {
+      float positionError = glm::length(dequantize(packed[i], quantization) - vertices[i].pos);
+      float uError        = std::abs(halfToFloat(packed[i].texCoord[0]) - vertices[i].texCoord.x);
+      float vError        = std::abs(halfToFloat(packed[i].texCoord[1]) - vertices[i].texCoord.y);
+
+      error.maxPosition = std::max(error.maxPosition, positionError);
+      error.averagePosition += positionError;
+      error.maxTexCoord = std::max(error.maxTexCoord, std::max(uError, vError));
+    }
+  });
+
+  for (const auto& error : jobErrors) {
+    result.maxPosition = std::max(result.maxPosition, error.maxPosition);
+    result.averagePosition += error.averagePosition;
+    result.maxTexCoord = std::max(result.maxTexCoord, error.maxTexCoord);
+  }
+  result.averagePosition /= static_cast<float>(vertexCount);
+  result.maxRelative = result.maxPosition / glm::length(quantization.scale);
+  return result;
+}
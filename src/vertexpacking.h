@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+#include "./vertex.h"
+
+uint16_t floatToHalf(float value);
+float    halfToFloat(uint16_t value);
+
+// Bounding box of the positions, PackedVertex stores 16 bit fractions of it.
+VertexQuantization computeQuantization(const Vertex* vertices, size_t vertexCount);
+
+// Packs on all cores, packed may point straight into mapped staging memory.
+void packVertices(const Vertex* vertices, size_t vertexCount, const VertexQuantization& quantization,
+                  PackedVertex* packed);
+
+struct QuantizationError {
+  float maxPosition     = 0.0f;  // model units
+  float averagePosition = 0.0f;
+  float maxTexCoord     = 0.0f;
+  float maxRelative     = 0.0f;  // maxPosition relative to the bounding box diagonal
+};
+
+QuantizationError measureQuantizationError(const Vertex* vertices, const PackedVertex* packed, size_t vertexCount,
+                                           const VertexQuantization& quantization);